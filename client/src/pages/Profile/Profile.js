@@ -42,6 +42,28 @@ function Profile() {
     }
   }, [token, setUser]);
 
+  useEffect(() => {
+    // Balance changes (including ones made elsewhere, such as bids) are
+    // pushed over the server's WebSocket endpoint instead of polled.
+    if (!token) {
+      return undefined;
+    }
+    const pushUrl = process.env.REACT_APP_PUSH_URL || `ws://${window.location.hostname}:9002/ws`;
+    const socket = new WebSocket(`${pushUrl}?token=${encodeURIComponent(token)}`);
+    socket.onopen = () => {
+      socket.send(JSON.stringify({ action: 'subscribe', topic: 'balance' }));
+    };
+    socket.onmessage = (event) => {
+      const data = JSON.parse(event.data);
+      if (data.type === 'balance') {
+        setProfile((current) => ({ ...current, balance: data.balance }));
+        setUser((current) => ({ ...current, balance: data.balance }));
+        localStorage.setItem("balance", data.balance);
+      }
+    };
+    return () => socket.close();
+  }, [token, setUser]);
+
   const handleDeposit = async (e) => {
     e.preventDefault();
     setMsg({ text: '', type: '' });
@@ -57,17 +79,10 @@ function Profile() {
       const data = await response.json();
       if (response.ok) {
         setMsg({ text: data.message, type: 'success' });
-        // Refresh profile info.
-        const res = await fetch('/profile', {
-          method: 'GET',
-          headers: { "Authorization": `Bearer ${token}` }
-        });
-        const profileData = await res.json();
-        if (res.ok) {
-          setProfile({ username: profileData.username, balance: profileData.balance });
-          setUser({ token, username: profileData.username, balance: profileData.balance });
-          localStorage.setItem("balance", profileData.balance);
-        }
+        // The response carries the updated balance; no need to re-fetch /profile.
+        setProfile({ username: profile.username, balance: data.balance });
+        setUser({ token, username: profile.username, balance: data.balance });
+        localStorage.setItem("balance", data.balance);
         setDepositAmount('');
       } else {
         setMsg({ text: `Error: ${data.error}`, type: 'error' });
@@ -92,17 +107,10 @@ function Profile() {
       const data = await response.json();
       if (response.ok) {
         setMsg({ text: data.message, type: 'success' });
-        // Refresh profile info.
-        const res = await fetch('/profile', {
-          method: 'GET',
-          headers: { "Authorization": `Bearer ${token}` }
-        });
-        const profileData = await res.json();
-        if (res.ok) {
-          setProfile({ username: profileData.username, balance: profileData.balance });
-          setUser({ token, username: profileData.username, balance: profileData.balance });
-          localStorage.setItem("balance", profileData.balance);
-        }
+        // The response carries the updated balance; no need to re-fetch /profile.
+        setProfile({ username: profile.username, balance: data.balance });
+        setUser({ token, username: profile.username, balance: data.balance });
+        localStorage.setItem("balance", data.balance);
         setWithdrawAmount('');
       } else {
         setMsg({ text: `Error: ${data.error}`, type: 'error' });
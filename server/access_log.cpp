@@ -0,0 +1,305 @@
+// File: access_log.cpp
+// Implementation of the per-thread buffered, size-rotated access log.
+
+#include "access_log.hpp"
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace
+{
+// Ids are never reused, so a thread's cached ring can not be mistaken for
+// one belonging to a later log at the same address.
+std::atomic<std::uint64_t> next_log_id{0};
+
+struct cached_ring
+{
+    std::uint64_t log_id = 0;
+    void *ring = nullptr;
+};
+
+thread_local cached_ring local_cache;
+
+// Length of the well-formed UTF-8 sequence starting at p (at most avail
+// bytes), or 0 if the bytes there are not one.
+std::size_t utf8_sequence(const unsigned char *p, std::size_t avail)
+{
+    std::size_t n;
+    if (p[0] >= 0xc2 && p[0] <= 0xdf)
+        n = 2;
+    else if (p[0] >= 0xe0 && p[0] <= 0xef)
+        n = 3;
+    else if (p[0] >= 0xf0 && p[0] <= 0xf4)
+        n = 4;
+    else
+        return 0;
+    if (n > avail)
+        return 0;
+    for (std::size_t i = 1; i < n; ++i)
+        if ((p[i] & 0xc0) != 0x80)
+            return 0;
+    // Overlong forms, UTF-16 surrogates and code points above U+10FFFF.
+    if ((p[0] == 0xe0 && p[1] < 0xa0) || (p[0] == 0xed && p[1] > 0x9f) ||
+        (p[0] == 0xf0 && p[1] < 0x90) || (p[0] == 0xf4 && p[1] > 0x8f))
+        return 0;
+    return n;
+}
+
+// Bytes that are not valid UTF-8 are written as \u00XX, so every line is
+// valid JSON whatever the client sent.
+void append_escaped(std::string &out, const char *data, std::size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < len; ++i)
+    {
+        unsigned char c = p[i];
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += static_cast<char>(c);
+        }
+        else if (c < 0x20 || c >= 0x80)
+        {
+            std::size_t n = c >= 0x80 ? utf8_sequence(p + i, len - i) : 0;
+            if (n)
+            {
+                out.append(data + i, n);
+                i += n - 1;
+                continue;
+            }
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 15];
+        }
+        else
+            out += static_cast<char>(c);
+    }
+}
+}
+
+std::uint8_t access_entry::copy(char *field, std::size_t capacity, const char *data, std::size_t len)
+{
+    if (len > capacity)
+    {
+        // Cut before the first byte that does not fit if it continues a
+        // UTF-8 sequence, rather than splitting the character.
+        len = capacity;
+        while (len > 0 && (static_cast<unsigned char>(data[len]) & 0xc0) == 0x80)
+            --len;
+    }
+    std::memcpy(field, data, len);
+    return static_cast<std::uint8_t>(len);
+}
+
+access_log::access_log(access_log_options options)
+    : options_(std::move(options)),
+      id_(next_log_id.fetch_add(1, std::memory_order_relaxed) + 1)
+{
+    if (options_.ring_entries == 0)
+        options_.ring_entries = 1;
+    file_ = std::fopen(options_.path.c_str(), "a");
+    if (!file_)
+        throw std::runtime_error("Cannot open access log " + options_.path);
+    if (std::fseek(file_, 0, SEEK_END) == 0)
+    {
+        long size = std::ftell(file_);
+        file_bytes_ = size > 0 ? static_cast<std::uint64_t>(size) : 0;
+    }
+    writer_ = std::thread([this]
+                          { run(); });
+}
+
+access_log::~access_log()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+    drain();
+    if (file_)
+        std::fclose(file_);
+}
+
+void access_log::record(const access_entry &entry)
+{
+    ring *r = local_ring();
+    std::uint64_t head = r->head.load(std::memory_order_relaxed);
+    std::uint64_t used = head - r->tail.load(std::memory_order_acquire);
+    if (used >= r->slots.size())
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    r->slots[head % r->slots.size()] = entry;
+    r->head.store(head + 1, std::memory_order_release);
+
+    // Do not leave a busy thread's ring to fill up before the next tick.
+    if (used + 1 == r->slots.size() / 2)
+        wake_.notify_one();
+}
+
+access_log::stats access_log::snapshot() const
+{
+    stats st;
+    st.written = written_.load(std::memory_order_relaxed);
+    st.dropped = dropped_.load(std::memory_order_relaxed);
+    st.rotations = rotations_.load(std::memory_order_relaxed);
+    st.write_errors = write_errors_.load(std::memory_order_relaxed);
+    return st;
+}
+
+access_log::ring *access_log::local_ring()
+{
+    if (local_cache.log_id == id_)
+        return static_cast<ring *>(local_cache.ring);
+    ring *r = register_ring();
+    local_cache.log_id = id_;
+    local_cache.ring = r;
+    return r;
+}
+
+// Only called when the thread's cache holds another log's ring, which is
+// normally the thread's first record.
+access_log::ring *access_log::register_ring()
+{
+    std::thread::id self = std::this_thread::get_id();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto const &r : rings_)
+        if (r->owner == self)
+            return r.get();
+    rings_.push_back(std::make_unique<ring>(options_.ring_entries, self));
+    return rings_.back().get();
+}
+
+void access_log::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_)
+    {
+        wake_.wait_for(lock, options_.flush_interval);
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+}
+
+// Writer thread (or the destructor once it has stopped).
+void access_log::drain()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        draining_.clear();
+        for (auto const &r : rings_)
+            draining_.push_back(r.get());
+    }
+
+    text_.clear();
+    std::uint64_t lines = 0;
+    for (ring *r : draining_)
+    {
+        std::uint64_t tail = r->tail.load(std::memory_order_relaxed);
+        std::uint64_t head = r->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail, ++lines)
+            format(r->slots[tail % r->slots.size()]);
+        r->tail.store(tail, std::memory_order_release);
+    }
+    if (lines == 0)
+        return;
+
+    if (write_out())
+        written_.fetch_add(lines, std::memory_order_relaxed);
+}
+
+void access_log::format(const access_entry &e)
+{
+    std::int64_t second = e.time_us / 1000000;
+    if (second != stamp_second_)
+    {
+        stamp_second_ = second;
+        std::time_t t = static_cast<std::time_t>(second);
+        std::tm utc{};
+        gmtime_r(&t, &utc);
+        std::strftime(stamp_, sizeof stamp_, "%Y-%m-%dT%H:%M:%S", &utc);
+    }
+
+    char number[32];
+    text_ += "{\"time\":\"";
+    text_ += stamp_;
+    std::snprintf(number, sizeof number, ".%03dZ", static_cast<int>(e.time_us / 1000 % 1000));
+    text_ += number;
+    text_ += "\",\"method\":\"";
+    append_escaped(text_, e.method, e.method_len);
+    text_ += "\",\"target\":\"";
+    append_escaped(text_, e.target, e.target_len);
+    std::snprintf(number, sizeof number, "\",\"status\":%u", static_cast<unsigned>(e.status));
+    text_ += number;
+    std::snprintf(number, sizeof number, ",\"bytes\":%llu", static_cast<unsigned long long>(e.bytes));
+    text_ += number;
+    std::snprintf(number, sizeof number, ",\"latency_us\":%u", static_cast<unsigned>(e.latency_us));
+    text_ += number;
+    std::snprintf(number, sizeof number, ",\"db_us\":%u", static_cast<unsigned>(e.db_us));
+    text_ += number;
+    if (e.user_len)
+    {
+        text_ += ",\"user\":\"";
+        append_escaped(text_, e.user, e.user_len);
+        text_ += "\"}\n";
+    }
+    else
+        text_ += ",\"user\":null}\n";
+}
+
+// Returns false if the lines did not all reach the file.
+bool access_log::write_out()
+{
+    if (!file_)
+    {
+        // The last rotation could not reopen the file; try again.
+        file_ = std::fopen(options_.path.c_str(), "a");
+        if (!file_)
+        {
+            write_errors_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+    bool ok = std::fwrite(text_.data(), 1, text_.size(), file_) == text_.size() && std::fflush(file_) == 0;
+    if (ok)
+        file_bytes_ += text_.size();
+    else
+    {
+        // Some of it may have been written; count what the file now holds.
+        write_errors_.fetch_add(1, std::memory_order_relaxed);
+        std::clearerr(file_);
+        struct stat st;
+        if (::fstat(::fileno(file_), &st) == 0)
+            file_bytes_ = static_cast<std::uint64_t>(st.st_size);
+    }
+    if (file_bytes_ >= options_.max_file_bytes)
+        rotate();
+    return ok;
+}
+
+// path -> path.1 -> path.2 ... the oldest beyond max_files is overwritten.
+void access_log::rotate()
+{
+    std::fclose(file_);
+    file_ = nullptr;
+    const std::string &path = options_.path;
+    if (options_.max_files == 0)
+        std::remove(path.c_str());
+    else
+    {
+        for (std::size_t i = options_.max_files; i > 1; --i)
+            std::rename((path + "." + std::to_string(i - 1)).c_str(), (path + "." + std::to_string(i)).c_str());
+        std::rename(path.c_str(), (path + ".1").c_str());
+    }
+    rotations_.fetch_add(1, std::memory_order_relaxed);
+    file_bytes_ = 0;
+    file_ = std::fopen(path.c_str(), "a");
+    if (!file_)
+        write_errors_.fetch_add(1, std::memory_order_relaxed);
+}
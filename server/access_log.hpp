@@ -0,0 +1,133 @@
+// File: access_log.hpp
+// Structured per-request access log for the HTTP server. Request threads
+// copy a fixed-size record into their own lock-free ring (no lock, no
+// formatting, no allocation); one background thread drains the rings,
+// formats each record as a JSON line and appends it to a file that is
+// rotated by size (path, path.1, ... path.N). A record that finds its
+// thread's ring full is dropped and counted rather than waited for.
+//
+// One line per request:
+//   {"time":"2026-01-02T03:04:05.678Z","method":"GET","target":"/auctions",
+//    "status":200,"bytes":512,"latency_us":830,"db_us":410,"user":"alice"}
+// time is when the request had been read, latency_us runs from then until
+// the response was written, db_us is the time its handlers held (or waited
+// for) database connections and user is null for unauthenticated requests.
+// Targets and users longer than the record's fields are truncated on a
+// character boundary, and bytes that are not valid UTF-8 are written as
+// \u00XX escapes, so every line is valid JSON.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct access_log_options
+{
+    std::string path;                               // log file
+    std::uint64_t max_file_bytes = 64 * 1024 * 1024; // rotate once the file reaches this size
+    std::size_t max_files = 5;                      // rotated files kept (path.1 ... path.N)
+    std::size_t ring_entries = 4096;                // records buffered per request thread
+    std::chrono::milliseconds flush_interval{200};  // longest a record waits to be written
+};
+
+// One request, as handed to access_log::record.
+struct access_entry
+{
+    std::int64_t time_us = 0;     // wall clock, microseconds since the epoch
+    std::uint32_t latency_us = 0;
+    std::uint32_t db_us = 0;
+    std::uint64_t bytes = 0;      // response bytes written
+    std::uint16_t status = 0;
+    std::uint8_t method_len = 0;
+    std::uint8_t target_len = 0;
+    std::uint8_t user_len = 0;
+    char method[15];
+    char target[192];
+    char user[48];
+
+    void set_method(const char *data, std::size_t len) { method_len = copy(method, sizeof method, data, len); }
+    void set_target(const char *data, std::size_t len) { target_len = copy(target, sizeof target, data, len); }
+    void set_user(const char *data, std::size_t len) { user_len = copy(user, sizeof user, data, len); }
+
+private:
+    static std::uint8_t copy(char *field, std::size_t capacity, const char *data, std::size_t len);
+};
+
+class access_log
+{
+public:
+    struct stats
+    {
+        std::uint64_t written = 0;   // lines known to have reached the file
+        std::uint64_t dropped = 0;   // records lost to a full ring
+        std::uint64_t rotations = 0;
+        std::uint64_t write_errors = 0;
+    };
+
+    // Opens (appends to) options.path; throws std::runtime_error if it
+    // cannot be opened.
+    explicit access_log(access_log_options options);
+    // Writes out every record still buffered.
+    ~access_log();
+
+    access_log(const access_log &) = delete;
+    access_log &operator=(const access_log &) = delete;
+
+    // Any thread; never blocks. The first record from a thread allocates
+    // its ring.
+    void record(const access_entry &entry);
+
+    stats snapshot() const;
+
+private:
+    // Single-producer ring owned by one request thread; only the writer
+    // thread consumes.
+    struct ring
+    {
+        ring(std::size_t entries, std::thread::id thread) : slots(entries), owner(thread) {}
+        std::vector<access_entry> slots;
+        const std::thread::id owner;
+        alignas(64) std::atomic<std::uint64_t> head{0}; // next slot to fill
+        alignas(64) std::atomic<std::uint64_t> tail{0}; // next slot to write out
+    };
+
+    ring *local_ring();
+    ring *register_ring();
+    void run();
+    void drain();
+    void format(const access_entry &entry);
+    bool write_out();
+    void rotate();
+
+    access_log_options options_;
+    const std::uint64_t id_; // tells this log's rings apart in thread caches
+
+    std::mutex mutex_; // guards rings_ and stopping_
+    std::condition_variable wake_;
+    std::vector<std::unique_ptr<ring>> rings_;
+    bool stopping_ = false;
+
+    std::atomic<std::uint64_t> written_{0};
+    std::atomic<std::uint64_t> dropped_{0};
+    std::atomic<std::uint64_t> rotations_{0};
+    std::atomic<std::uint64_t> write_errors_{0};
+
+    // Writer thread only.
+    std::FILE *file_ = nullptr;
+    std::uint64_t file_bytes_ = 0;
+    std::vector<ring *> draining_;
+    std::string text_;
+    std::int64_t stamp_second_ = -1;
+    char stamp_[24] = {};
+
+    std::thread writer_;
+};
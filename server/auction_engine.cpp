@@ -0,0 +1,458 @@
+// File: auction_engine.cpp
+// Implementation of the sharded, single-writer auction engine.
+
+#include "auction_engine.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+std::int64_t now_ms()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+const char *auction_view::status(std::int64_t at_ms) const
+{
+    if (at_ms < starts_at_ms)
+        return "scheduled";
+    if (at_ms < ends_at_ms)
+        return "open";
+    return "closed";
+}
+
+namespace
+{
+// Everything a bid reads or writes, one cache line per auction. Seller
+// and leader are ids into the shard's name table, so rows hold no strings.
+struct hot_row
+{
+    money starting_price;
+    money min_increment;
+    money high_bid;
+    std::int64_t starts_at_ms = 0;
+    std::int64_t ends_at_ms = 0;
+    std::uint64_t leader_hold = 0;
+    std::uint32_t bid_count = 0;
+    std::uint32_t seller = 0;
+    std::uint32_t leader = 0;
+    bool closed = false;
+};
+static_assert(sizeof(hot_row) <= 64, "a hot row should fit one cache line");
+
+// Read only when a view is built.
+struct cold_row
+{
+    auction_id id = 0;
+    std::string title;
+    money reserve;
+};
+
+// One shard's auctions: hot rows in a dense array, cold fields in a
+// parallel one, and an index from auction id to row. Rows are never
+// removed. Seller and bidder names are interned per shard; name 0 is the
+// empty string, which rows use for "no leader". Open rows also wait in a
+// queue ordered by end time until they are closed.
+class auction_table
+{
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+    static constexpr std::uint32_t no_name = static_cast<std::uint32_t>(-1);
+
+    auction_table() { intern(std::string()); }
+
+    std::size_t find(auction_id id) const
+    {
+        auto it = rows_.find(id);
+        return it == rows_.end() ? npos : it->second;
+    }
+
+    // Insert the auction, or overwrite it if the id is already stored.
+    std::size_t put(const auction_view &v)
+    {
+        auto inserted = rows_.try_emplace(v.id, hot_.size());
+        std::size_t row = inserted.first->second;
+        if (inserted.second)
+        {
+            hot_.emplace_back();
+            cold_.emplace_back();
+            if (!v.settled)
+                closing_.emplace(v.ends_at_ms, row);
+        }
+        hot_row &h = hot_[row];
+        h.starting_price = v.starting_price;
+        h.min_increment = v.min_increment;
+        h.high_bid = v.high_bid;
+        h.starts_at_ms = v.starts_at_ms;
+        h.ends_at_ms = v.ends_at_ms;
+        h.leader_hold = v.leader_hold;
+        h.bid_count = v.bid_count;
+        h.seller = intern(v.seller);
+        h.leader = intern(v.leader);
+        h.closed = v.settled;
+        cold_row &c = cold_[row];
+        c.id = v.id;
+        c.title = v.title;
+        c.reserve = v.reserve;
+        return row;
+    }
+
+    hot_row &hot(std::size_t row) { return hot_[row]; }
+    std::size_t size() const { return hot_.size(); }
+
+    // Close every row that has ended by at_ms and is still open, calling
+    // closed(row) for each.
+    template <class F>
+    void close_ended(std::int64_t at_ms, F &&closed)
+    {
+        while (!closing_.empty() && closing_.top().first <= at_ms)
+        {
+            std::size_t row = closing_.top().second;
+            closing_.pop();
+            if (hot_[row].closed)
+                continue;
+            hot_[row].closed = true;
+            closed(row);
+        }
+    }
+
+    // The id name was interned under, or no_name if it never was.
+    std::uint32_t name_id(const std::string &name) const
+    {
+        auto it = name_ids_.find(name);
+        return it == name_ids_.end() ? no_name : it->second;
+    }
+
+    std::uint32_t intern(const std::string &name)
+    {
+        auto inserted = name_ids_.try_emplace(name, static_cast<std::uint32_t>(names_.size()));
+        if (inserted.second)
+            names_.push_back(name);
+        return inserted.first->second;
+    }
+
+    auction_view view(std::size_t row) const
+    {
+        const hot_row &h = hot_[row];
+        const cold_row &c = cold_[row];
+        auction_view v;
+        v.id = c.id;
+        v.title = c.title;
+        v.seller = names_[h.seller];
+        v.starting_price = h.starting_price;
+        v.reserve = c.reserve;
+        v.min_increment = h.min_increment;
+        v.starts_at_ms = h.starts_at_ms;
+        v.ends_at_ms = h.ends_at_ms;
+        v.high_bid = h.high_bid;
+        v.leader = names_[h.leader];
+        v.leader_hold = h.leader_hold;
+        v.bid_count = h.bid_count;
+        v.settled = h.closed;
+        return v;
+    }
+
+private:
+    std::unordered_map<auction_id, std::size_t> rows_;
+    std::vector<hot_row> hot_;
+    std::vector<cold_row> cold_;
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, std::uint32_t> name_ids_;
+    using deadline = std::pair<std::int64_t, std::size_t>; // ends_at_ms, row
+    std::priority_queue<deadline, std::vector<deadline>, std::greater<deadline>> closing_;
+};
+
+// A queued command: one allocation holding both the queue link and the
+// work to run against the shard's auctions.
+struct command : mpsc_node
+{
+    virtual ~command() = default;
+    virtual void run(auction_table &auctions) = 0;
+};
+
+template <class F>
+struct command_impl final : command
+{
+    explicit command_impl(F &&f) : fn(std::move(f)) {}
+    void run(auction_table &auctions) override { fn(auctions); }
+    F fn;
+};
+
+// Polls before parking: under load the inbox refills faster than a
+// condition variable round-trip.
+constexpr int spins_before_sleep = 2000;
+}
+
+struct auction_engine::shard
+{
+    mpsc_queue inbox;
+
+    // Parking: the owner sets sleeping before its final emptiness check;
+    // producers that see it set clear it under the mutex and notify.
+    alignas(64) std::atomic<bool> sleeping{false};
+    std::mutex park_mutex;
+    std::condition_variable park;
+    bool stopping = false;
+
+    std::atomic<std::uint64_t> processed{0};
+
+    // Touched only by the owning thread.
+    auction_table auctions;
+
+    std::thread thread;
+
+    void push(command *c)
+    {
+        inbox.push(c);
+        if (sleeping.load(std::memory_order_seq_cst))
+        {
+            std::lock_guard<std::mutex> lock(park_mutex);
+            sleeping.store(false, std::memory_order_relaxed);
+            park.notify_one();
+        }
+    }
+
+    void run()
+    {
+        int idle = 0;
+        for (;;)
+        {
+            if (mpsc_node *n = inbox.pop())
+            {
+                idle = 0;
+                auto *c = static_cast<command *>(n);
+                c->run(auctions);
+                delete c;
+                processed.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (++idle < spins_before_sleep)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(park_mutex);
+            sleeping.store(true, std::memory_order_seq_cst);
+            if (!inbox.empty())
+            {
+                sleeping.store(false, std::memory_order_relaxed);
+                continue;
+            }
+            if (stopping)
+                return;
+            park.wait(lock, [this]
+                      { return !sleeping.load(std::memory_order_relaxed) || stopping; });
+            sleeping.store(false, std::memory_order_relaxed);
+            idle = 0;
+        }
+    }
+};
+
+auction_engine::auction_engine(std::size_t shard_count)
+{
+    if (shard_count == 0)
+        shard_count = 1;
+    shards_.reserve(shard_count);
+    for (std::size_t i = 0; i < shard_count; ++i)
+        shards_.push_back(std::make_unique<shard>());
+    for (auto &s : shards_)
+        s->thread = std::thread([p = s.get()]
+                                { p->run(); });
+}
+
+auction_engine::~auction_engine()
+{
+    for (auto &s : shards_)
+    {
+        std::lock_guard<std::mutex> lock(s->park_mutex);
+        s->stopping = true;
+        s->sleeping.store(false, std::memory_order_relaxed);
+        s->park.notify_one();
+    }
+    for (auto &s : shards_)
+    {
+        s->thread.join();
+        // Drop commands that were never run.
+        while (mpsc_node *n = s->inbox.pop())
+            delete static_cast<command *>(n);
+    }
+}
+
+auction_engine::shard &auction_engine::shard_for(auction_id id)
+{
+    // Fibonacci hashing spreads consecutive ids evenly over shards.
+    std::uint64_t h = id * 0x9E3779B97F4A7C15ull;
+    return *shards_[(h >> 32) % shards_.size()];
+}
+
+template <class F>
+void auction_engine::submit(shard &s, F &&f)
+{
+    s.push(new command_impl<std::decay_t<F>>(std::forward<F>(f)));
+}
+
+auction_id auction_engine::create(const auction_spec &spec, view_handler done)
+{
+    auction_view view;
+    view.id = last_id_.fetch_add(1, std::memory_order_relaxed) + 1;
+    view.title = spec.title;
+    view.seller = spec.seller;
+    view.starting_price = spec.starting_price;
+    view.reserve = spec.reserve;
+    view.min_increment = spec.min_increment;
+    view.starts_at_ms = spec.starts_at_ms;
+    view.ends_at_ms = spec.ends_at_ms;
+
+    auction_id id = view.id;
+    submit(shard_for(id),
+           [view = std::move(view), done = std::move(done)](auction_table &auctions) mutable
+           {
+               auctions.put(view);
+               done(true, std::move(view));
+           });
+    return id;
+}
+
+void auction_engine::restore(const auction_view &view)
+{
+    if (view.id == 0)
+        return;
+    auction_id seen = last_id_.load(std::memory_order_relaxed);
+    while (seen < view.id && !last_id_.compare_exchange_weak(seen, view.id))
+    {
+    }
+    submit(shard_for(view.id),
+           [view](auction_table &auctions)
+           { auctions.put(view); });
+}
+
+void auction_engine::place_bid(auction_id id, std::string bidder, money amount, std::uint64_t hold,
+                               std::int64_t at_ms, bid_handler done)
+{
+    submit(shard_for(id),
+           [id, bidder = std::move(bidder), amount, hold, at_ms, done = std::move(done)](auction_table &auctions)
+           {
+               bid_outcome outcome;
+               std::size_t row = auctions.find(id);
+               if (row == auction_table::npos)
+                   return done(outcome, auction_view());
+
+               hot_row &a = auctions.hot(row);
+               if (auctions.name_id(bidder) == a.seller)
+                   outcome.status = bid_status::own_auction;
+               else if (a.closed || at_ms < a.starts_at_ms || at_ms >= a.ends_at_ms)
+                   outcome.status = bid_status::not_open;
+               else
+               {
+                   // No amount can beat a high bid whose next increment overflows.
+                   money minimum = a.starting_price;
+                   bool reachable = a.bid_count == 0 || money::add(a.high_bid, a.min_increment, minimum);
+                   if (!reachable)
+                       minimum = money::from_minor(std::numeric_limits<money::rep>::max());
+                   if (!reachable || amount < minimum)
+                   {
+                       outcome.status = bid_status::too_low;
+                       outcome.minimum_bid = minimum;
+                   }
+                   else
+                   {
+                       outcome.outbid_hold = a.leader_hold;
+                       a.high_bid = amount;
+                       a.leader = auctions.intern(bidder);
+                       a.leader_hold = hold;
+                       outcome.bid_count = ++a.bid_count;
+                       outcome.status = bid_status::accepted;
+                   }
+               }
+               if (outcome.status != bid_status::accepted)
+                   return done(outcome, auction_view());
+               done(outcome, auctions.view(row));
+           });
+}
+
+void auction_engine::get(auction_id id, view_handler done)
+{
+    submit(shard_for(id),
+           [id, done = std::move(done)](auction_table &auctions)
+           {
+               std::size_t row = auctions.find(id);
+               if (row == auction_table::npos)
+                   done(false, auction_view());
+               else
+                   done(true, auctions.view(row));
+           });
+}
+
+template <class Collect>
+void auction_engine::gather(Collect collect, list_handler done)
+{
+    // Every shard appends its views; the last one to finish completes.
+    struct state
+    {
+        std::mutex mutex;
+        std::vector<auction_view> views;
+        std::size_t remaining;
+        list_handler done;
+    };
+    auto g = std::make_shared<state>();
+    g->remaining = shards_.size();
+    g->done = std::move(done);
+
+    for (auto &s : shards_)
+    {
+        submit(*s,
+               [g, collect](auction_table &auctions)
+               {
+                   // Views are built outside the lock; only the moves into
+                   // the shared vector are serialized.
+                   std::vector<auction_view> views;
+                   collect(auctions, views);
+
+                   std::unique_lock<std::mutex> lock(g->mutex);
+                   g->views.insert(g->views.end(), std::make_move_iterator(views.begin()),
+                                   std::make_move_iterator(views.end()));
+                   if (--g->remaining != 0)
+                       return;
+                   lock.unlock();
+                   std::sort(g->views.begin(), g->views.end(),
+                             [](const auction_view &a, const auction_view &b)
+                             { return a.id < b.id; });
+                   g->done(std::move(g->views));
+               });
+    }
+}
+
+void auction_engine::list(list_handler done)
+{
+    gather([](auction_table &auctions, std::vector<auction_view> &views)
+           {
+               views.reserve(auctions.size());
+               for (std::size_t row = 0; row < auctions.size(); ++row)
+                   views.push_back(auctions.view(row));
+           },
+           std::move(done));
+}
+
+void auction_engine::close_ended(std::int64_t at_ms, list_handler done)
+{
+    gather([at_ms](auction_table &auctions, std::vector<auction_view> &views)
+           {
+               auctions.close_ended(at_ms, [&](std::size_t row)
+                                    { views.push_back(auctions.view(row)); });
+           },
+           std::move(done));
+}
+
+std::vector<std::uint64_t> auction_engine::processed() const
+{
+    std::vector<std::uint64_t> counts;
+    counts.reserve(shards_.size());
+    for (auto const &s : shards_)
+        counts.push_back(s->processed.load(std::memory_order_relaxed));
+    return counts;
+}
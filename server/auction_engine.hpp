@@ -0,0 +1,143 @@
+// File: auction_engine.hpp
+// In-memory auction state and bid acceptance. Auctions are hash-
+// partitioned across shards; each shard's auctions are owned by a single
+// thread that drains a lock-free MPSC inbox, so bid acceptance takes no
+// locks at all and bids on auctions in different shards never contend.
+// Callers submit a command with a completion handler; the handler runs on
+// the shard thread and should only hand the result back to the caller's
+// own executor (as session responders do). Persistence happens behind the
+// engine (see auction_store).
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "money.hpp"
+#include "mpsc_queue.hpp"
+
+using auction_id = std::uint64_t;
+
+// Milliseconds since the Unix epoch.
+std::int64_t now_ms();
+
+struct auction_spec
+{
+    std::string title;
+    std::string seller;
+    money starting_price;
+    money reserve;       // hidden; only whether it is met is published
+    money min_increment;
+    std::int64_t starts_at_ms = 0;
+    std::int64_t ends_at_ms = 0;
+};
+
+// Snapshot of one auction as reported to clients.
+struct auction_view
+{
+    auction_id id = 0;
+    std::string title;
+    std::string seller;
+    money starting_price;
+    money reserve;
+    money min_increment;
+    std::int64_t starts_at_ms = 0;
+    std::int64_t ends_at_ms = 0;
+    money high_bid;          // zero while bid_count == 0
+    std::string leader;      // highest bidder, empty while bid_count == 0
+    std::uint64_t leader_hold = 0; // balance hold backing the high bid, if any
+    std::uint32_t bid_count = 0;
+    bool settled = false;    // closed and handed out for settlement
+
+    bool reserve_met() const { return bid_count > 0 && high_bid >= reserve; }
+    // "scheduled", "open" or "closed" at the given time.
+    const char *status(std::int64_t at_ms) const;
+};
+
+enum class bid_status
+{
+    accepted,
+    not_found,
+    not_open,     // before start or after end
+    own_auction,  // sellers cannot bid on their own items
+    too_low       // below the starting price or high bid + increment
+};
+
+struct bid_outcome
+{
+    bid_status status = bid_status::not_found;
+    money minimum_bid;           // smallest acceptable amount when too_low
+    std::uint32_t bid_count = 0; // sequence number of the accepted bid
+    std::uint64_t outbid_hold = 0; // previous leader's hold, to be released
+};
+
+class auction_engine
+{
+public:
+    // Completion handlers; all run on a shard thread. Views are built for
+    // the handler, which may keep them.
+    using view_handler = std::function<void(bool found, auction_view)>;
+    using bid_handler = std::function<void(const bid_outcome &, auction_view)>;
+    using list_handler = std::function<void(std::vector<auction_view>)>;
+
+    explicit auction_engine(std::size_t shard_count);
+    ~auction_engine();
+
+    auction_engine(const auction_engine &) = delete;
+    auction_engine &operator=(const auction_engine &) = delete;
+
+    // Add a new auction and return its id. Ids are dense, starting after
+    // the highest id restored so far.
+    auction_id create(const auction_spec &spec, view_handler done);
+
+    // Reinstate an auction loaded from the database at startup.
+    void restore(const auction_view &view);
+
+    // hold is the bidder's balance hold for amount (0 if none); when the
+    // bid is accepted it replaces the previous leader's hold, which is
+    // returned in outcome.outbid_hold. The handler's view is filled in only
+    // for accepted bids.
+    void place_bid(auction_id id, std::string bidder, money amount, std::uint64_t hold,
+                   std::int64_t at_ms, bid_handler done);
+
+    void get(auction_id id, view_handler done);
+
+    // Gathers every shard's auctions, sorted by id.
+    void list(list_handler done);
+
+    // Closes the auctions that have ended by at_ms and gathers them, sorted
+    // by id, for settlement. Each auction is handed out once, and rejects
+    // bids from then on, even ones placed before the end that reach the
+    // shard later. Restored auctions that were settled are never handed
+    // out again.
+    void close_ended(std::int64_t at_ms, list_handler done);
+
+    std::size_t shard_count() const { return shards_.size(); }
+
+    // Commands each shard has executed so far.
+    std::vector<std::uint64_t> processed() const;
+
+private:
+    struct shard;
+
+    shard &shard_for(auction_id id);
+
+    // Queue f(state) on the shard owning id's partition.
+    template <class F>
+    void submit(shard &s, F &&f);
+
+    // Run collect(state, views) on every shard and pass the views they
+    // appended, sorted by id, to done.
+    template <class Collect>
+    void gather(Collect collect, list_handler done);
+
+    std::vector<std::unique_ptr<shard>> shards_;
+    std::atomic<auction_id> last_id_{0};
+};
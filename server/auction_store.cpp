@@ -0,0 +1,75 @@
+// File: auction_store.cpp
+// Loading and write-behind persistence of auctions and bids.
+
+#include "auction_store.hpp"
+
+#include "db_statements.hpp"
+
+namespace
+{
+money column_amount(pqxx::field const &field)
+{
+    money value;
+    if (!money::parse(field.view(), value))
+        throw std::runtime_error("Malformed amount in auctions table");
+    return value;
+}
+}
+
+auction_store::auction_store(db_pool &pool, write_behind &writer)
+    : pool_(pool), writer_(writer)
+{
+}
+
+void auction_store::load(auction_engine &engine)
+{
+    auto C = pool_.acquire();
+    pqxx::nontransaction N(*C);
+    for (auto const &row : N.exec_prepared(stmt::load_auctions))
+    {
+        auction_view view;
+        view.id = row["auction_id"].as<auction_id>();
+        view.title = row["title"].as<std::string>();
+        view.seller = row["seller"].as<std::string>();
+        view.starting_price = column_amount(row["starting_price"]);
+        view.reserve = column_amount(row["reserve"]);
+        view.min_increment = column_amount(row["min_increment"]);
+        view.starts_at_ms = row["starts_at_ms"].as<std::int64_t>();
+        view.ends_at_ms = row["ends_at_ms"].as<std::int64_t>();
+        view.high_bid = column_amount(row["high_bid"]);
+        view.leader = row["leader"].as<std::string>();
+        view.leader_hold = row["leader_hold"].as<std::uint64_t>();
+        view.bid_count = row["bid_count"].as<std::uint32_t>();
+        view.settled = row["settled"].as<bool>();
+        engine.restore(view);
+    }
+}
+
+void auction_store::record_auction(const auction_view &auction)
+{
+    writer_.enqueue(
+        [a = auction](pqxx::work &W)
+        {
+            W.exec_prepared(stmt::insert_auction, a.id, a.title, a.seller,
+                            money_text(a.starting_price).view(), money_text(a.reserve).view(),
+                            money_text(a.min_increment).view(), a.starts_at_ms, a.ends_at_ms);
+        });
+}
+
+void auction_store::record_bid(auction_id id, const std::string &bidder, money amount,
+                               std::uint32_t bid_count, std::uint64_t hold, std::int64_t at_ms)
+{
+    writer_.enqueue(
+        [id, bidder, amount, bid_count, hold, at_ms](pqxx::work &W)
+        {
+            money_text text(amount);
+            W.exec_prepared(stmt::insert_bid, id, bid_count, bidder, text.view(), at_ms);
+            W.exec_prepared(stmt::update_auction_high, id, text.view(), bidder, bid_count, hold);
+        });
+}
+
+void auction_store::record_settled(auction_id id)
+{
+    writer_.enqueue([id](pqxx::work &W)
+                    { W.exec_prepared(stmt::mark_settled, id); });
+}
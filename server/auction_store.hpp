@@ -0,0 +1,33 @@
+// File: auction_store.hpp
+// Persistence for the auction engine. New auctions and accepted bids are
+// handed to the shared write_behind writer, so handlers never wait for
+// the database. Bid rows are only applied to an auction's summary if they
+// are newer than what is stored, so writes may land in any order.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "auction_engine.hpp"
+#include "db_pool.hpp"
+#include "write_behind.hpp"
+
+class auction_store
+{
+public:
+    auction_store(db_pool &pool, write_behind &writer);
+
+    // Load every stored auction into the engine. Call once at startup,
+    // before serving requests.
+    void load(auction_engine &engine);
+
+    void record_auction(const auction_view &auction);
+    void record_bid(auction_id id, const std::string &bidder, money amount,
+                    std::uint32_t bid_count, std::uint64_t hold, std::int64_t at_ms);
+    // The auction has closed and its leader's hold was settled.
+    void record_settled(auction_id id);
+
+private:
+    db_pool &pool_;
+    write_behind &writer_;
+};
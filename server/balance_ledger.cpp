@@ -0,0 +1,329 @@
+// File: balance_ledger.cpp
+// Implementation of the in-memory balance hold ledger.
+
+#include "balance_ledger.hpp"
+
+#include <functional>
+#include <iostream>
+#include "auction_engine.hpp"
+#include "db_statements.hpp"
+
+namespace
+{
+money column_amount(pqxx::field const &field)
+{
+    money value;
+    if (!money::parse(field.view(), value))
+        throw std::runtime_error("Malformed amount in database");
+    return value;
+}
+}
+
+balance_ledger::balance_ledger(db_pool &pool, write_behind &writer)
+    : pool_(pool), writer_(writer),
+      accounts_(new account_shard[shard_count]),
+      holds_(new hold_shard[shard_count])
+{
+}
+
+void balance_ledger::on_change(change_handler handler)
+{
+    on_change_ = std::move(handler);
+}
+
+void balance_ledger::changed(const std::string &username, const account &a) const
+{
+    if (on_change_)
+        on_change_(username, a);
+}
+
+balance_ledger::account_shard &balance_ledger::shard_for(const std::string &username) const
+{
+    return accounts_[std::hash<std::string>{}(username) % shard_count];
+}
+
+balance_ledger::hold_shard &balance_ledger::shard_for(hold_id id) const
+{
+    return holds_[id % shard_count];
+}
+
+void balance_ledger::reconcile()
+{
+    auto C = pool_.acquire();
+    pqxx::nontransaction N(*C);
+
+    std::unordered_map<std::string, money> held_by_user;
+    // New ids continue after the highest one stored in either table, so
+    // they can not collide with a persisted hold after a restart.
+    hold_id last = N.exec_prepared(stmt::max_hold_id)[0][0].as<hold_id>();
+    for (auto const &row : N.exec_prepared(stmt::load_holds))
+    {
+        hold_id id = row["hold_id"].as<hold_id>();
+        hold_record h{row["username"].as<std::string>(), column_amount(row["amount"]),
+                      row["for_bid"].as<bool>() ? hold_kind::bid : hold_kind::request};
+        held_by_user[h.owner] += h.amount;
+        shard_for(id).holds.emplace(id, std::move(h));
+    }
+    last_hold_.store(last);
+
+    for (auto const &entry : held_by_user)
+    {
+        auto result = N.exec_prepared(stmt::user_balance, entry.first);
+        account a;
+        a.held = entry.second;
+        if (!result.empty())
+            a.balance = column_amount(result[0]["balance"]);
+        if (a.available() < money())
+        {
+            // Typically a balance changed outside the server. The account
+            // stays usable: new holds and withdrawals fail until deposits
+            // or releases bring it back above zero.
+            ++overcommitted_;
+            std::cerr << "ledger: " << entry.first << " holds " << a.held.to_string()
+                      << " against balance " << a.balance.to_string() << "\n";
+        }
+        shard_for(entry.first).accounts[entry.first] = a;
+    }
+}
+
+bool balance_ledger::ensure_loaded(const std::string &username)
+{
+    {
+        account_shard &s = shard_for(username);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.accounts.count(username))
+            return true;
+    }
+
+    money balance;
+    {
+        auto C = pool_.acquire();
+        pqxx::nontransaction N(*C);
+        auto result = N.exec_prepared(stmt::user_balance, username);
+        if (result.empty())
+            return false;
+        balance = column_amount(result[0]["balance"]);
+    }
+    loads_.fetch_add(1, std::memory_order_relaxed);
+
+    // Another request may have loaded it meanwhile; keep whichever came first.
+    account_shard &s = shard_for(username);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.accounts.emplace(username, account{balance, money(), money()});
+    return true;
+}
+
+hold_id balance_ledger::hold(const std::string &username, money amount, hold_kind kind, account &after)
+{
+    {
+        account_shard &s = shard_for(username);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.accounts.find(username);
+        if (it == s.accounts.end() || it->second.available() < amount)
+        {
+            rejected_holds_.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+        it->second.held += amount;
+        after = it->second;
+    }
+
+    hold_id id = last_hold_.fetch_add(1, std::memory_order_relaxed) + 1;
+    {
+        hold_shard &s = shard_for(id);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.holds.emplace(id, hold_record{username, amount, kind});
+    }
+
+    writer_.enqueue(
+        [id, username, amount, for_bid = kind == hold_kind::bid, at = now_ms()](pqxx::work &W)
+        { W.exec_prepared(stmt::insert_hold, id, username, money_text(amount).view(), at, for_bid); });
+    changed(username, after);
+    return id;
+}
+
+balance_ledger::release_result balance_ledger::release(hold_id id, const std::string &owner, account &after)
+{
+    return take_hold(id, &owner, after);
+}
+
+void balance_ledger::release(hold_id id)
+{
+    account ignored;
+    take_hold(id, nullptr, ignored);
+}
+
+// Remove a hold and return its funds. With an owner, only that owner's
+// request holds qualify.
+balance_ledger::release_result balance_ledger::take_hold(hold_id id, const std::string *owner, account &after)
+{
+    hold_record h;
+    {
+        hold_shard &s = shard_for(id);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.holds.find(id);
+        if (it == s.holds.end() || (owner && it->second.owner != *owner))
+            return release_result::not_found;
+        if (owner && it->second.kind == hold_kind::bid)
+            return release_result::bid_backed;
+        h = std::move(it->second);
+        s.holds.erase(it);
+    }
+
+    {
+        account_shard &s = shard_for(h.owner);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        account &a = s.accounts[h.owner];
+        a.held -= h.amount;
+        after = a;
+    }
+
+    writer_.enqueue([id](pqxx::work &W)
+                    { W.exec_prepared(stmt::delete_hold, id); });
+    changed(h.owner, after);
+    return release_result::released;
+}
+
+bool balance_ledger::capture(hold_id id, const std::string &payee)
+{
+    hold_record h;
+    {
+        hold_shard &s = shard_for(id);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.holds.find(id);
+        if (it == s.holds.end())
+            return false;
+        h = std::move(it->second);
+        s.holds.erase(it);
+    }
+
+    account payer;
+    {
+        account_shard &s = shard_for(h.owner);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        account &a = s.accounts[h.owner];
+        a.held -= h.amount;
+        a.balance -= h.amount;
+        payer = a;
+    }
+    account paid;
+    bool payee_loaded = false;
+    {
+        account_shard &s = shard_for(payee);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.accounts.find(payee);
+        if (it != s.accounts.end())
+        {
+            it->second.balance += h.amount;
+            paid = it->second;
+            payee_loaded = true;
+        }
+    }
+
+    writer_.enqueue(
+        [id, owner = h.owner, payee, amount = h.amount](pqxx::work &W)
+        {
+            money_text text(amount);
+            W.exec_prepared(stmt::debit, text.view(), owner);
+            W.exec_prepared(stmt::deposit, text.view(), payee);
+            W.exec_prepared(stmt::delete_hold, id);
+        });
+    changed(h.owner, payer);
+    if (payee_loaded)
+        changed(payee, paid);
+    return true;
+}
+
+balance_ledger::withdrawal balance_ledger::reserve_withdrawal(const std::string &username, money amount)
+{
+    account after;
+    {
+        account_shard &s = shard_for(username);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.accounts.find(username);
+        if (it == s.accounts.end() || it->second.available() < amount)
+            return withdrawal::insufficient;
+        it->second.withdrawing += amount;
+        after = it->second;
+    }
+    changed(username, after);
+    return withdrawal::reserved;
+}
+
+void balance_ledger::settle_withdrawal(const std::string &username, money amount)
+{
+    account after;
+    {
+        account_shard &s = shard_for(username);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.accounts.find(username);
+        if (it == s.accounts.end())
+            return;
+        it->second.withdrawing -= amount;
+        it->second.balance -= amount;
+        after = it->second;
+    }
+    changed(username, after);
+}
+
+void balance_ledger::refund(const std::string &username, money amount)
+{
+    account after;
+    {
+        account_shard &s = shard_for(username);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.accounts.find(username);
+        if (it == s.accounts.end())
+            return;
+        it->second.withdrawing -= amount;
+        after = it->second;
+    }
+    changed(username, after);
+}
+
+void balance_ledger::credit(const std::string &username, money amount)
+{
+    account after;
+    {
+        account_shard &s = shard_for(username);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.accounts.find(username);
+        if (it == s.accounts.end())
+            return;
+        it->second.balance += amount;
+        after = it->second;
+    }
+    changed(username, after);
+}
+
+bool balance_ledger::lookup(const std::string &username, account &out) const
+{
+    account_shard &s = shard_for(username);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.accounts.find(username);
+    if (it == s.accounts.end())
+        return false;
+    out = it->second;
+    return true;
+}
+
+balance_ledger::stats balance_ledger::snapshot() const
+{
+    stats st;
+    for (std::size_t i = 0; i < shard_count; ++i)
+    {
+        std::lock_guard<std::mutex> lock(accounts_[i].mutex);
+        st.accounts += accounts_[i].accounts.size();
+        for (auto const &entry : accounts_[i].accounts)
+            st.held += entry.second.held;
+    }
+    for (std::size_t i = 0; i < shard_count; ++i)
+    {
+        std::lock_guard<std::mutex> lock(holds_[i].mutex);
+        st.holds += holds_[i].holds.size();
+    }
+    st.loads = loads_.load(std::memory_order_relaxed);
+    st.rejected_holds = rejected_holds_.load(std::memory_order_relaxed);
+    st.overcommitted = overcommitted_;
+    return st;
+}
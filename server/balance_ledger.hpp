@@ -0,0 +1,157 @@
+// File: balance_ledger.hpp
+// In-memory per-user balance ledger splitting each loaded user's balance
+// into available and held funds. Holds reserve funds for spend-style
+// operations (bids, explicit /hold requests) in microseconds under a
+// per-shard mutex instead of a database round-trip per check. An account
+// is loaded from users.balance on first use and afterwards only changed
+// by the deltas the server applies itself, so database reads that arrive
+// out of order can never roll it back. Holds are written behind to the
+// balance_holds table and reconciled against users at startup.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "db_pool.hpp"
+#include "money.hpp"
+#include "write_behind.hpp"
+
+using hold_id = std::uint64_t;
+
+enum class hold_kind
+{
+    request, // taken by /hold; the owner may release it
+    bid      // backs a leading bid; freed only when outbid or rejected
+};
+
+class balance_ledger
+{
+public:
+    struct account
+    {
+        money balance;     // users.balance when loaded, plus the changes applied since
+        money held;
+        money withdrawing; // reserved by withdrawals whose UPDATE has not finished
+        money available() const { return balance - held - withdrawing; }
+    };
+
+    enum class release_result
+    {
+        released,
+        not_found, // no such hold, or it belongs to someone else
+        bid_backed // the caller may not release a bid's hold
+    };
+
+    enum class withdrawal
+    {
+        reserved,    // funds taken from available; settle or refund later
+        insufficient // not loaded, or would dip into held funds
+    };
+
+    struct stats
+    {
+        std::size_t accounts = 0;
+        std::size_t holds = 0;
+        money held;
+        std::uint64_t loads = 0;
+        std::uint64_t rejected_holds = 0;
+        std::size_t overcommitted = 0; // accounts found holding more than their balance at startup
+    };
+
+    // Called after an account's balance or held funds change, outside the
+    // ledger's locks, from whichever thread made the change.
+    using change_handler = std::function<void(const std::string &username, const account &)>;
+
+    balance_ledger(db_pool &pool, write_behind &writer);
+
+    // Install the change handler. Call before serving requests.
+    void on_change(change_handler handler);
+
+    // Startup: load persisted holds and their owners' balances, and report
+    // accounts whose holds exceed their balance. Call before serving.
+    void reconcile();
+
+    // Load the user's balance if not yet in memory (one query, first use
+    // only). Returns false if the user does not exist. May throw
+    // db_pool_timeout.
+    bool ensure_loaded(const std::string &username);
+
+    // Move amount from available to held. Returns the new hold's id, or 0
+    // if the account is not loaded or has too little available.
+    hold_id hold(const std::string &username, money amount, hold_kind kind, account &after);
+
+    // Release on the owner's request: the hold must belong to owner and
+    // must not back a bid.
+    release_result release(hold_id id, const std::string &owner, account &after);
+    // Release any hold, e.g. a bid's once it is outbid or rejected.
+    void release(hold_id id);
+
+    // Spend a hold, e.g. a winning bid's: the held amount leaves its owner's
+    // balance and is credited to payee, who must be loaded (see credit).
+    // The database changes are written behind in one transaction. Returns
+    // false if there is no such hold, e.g. it was already captured.
+    bool capture(hold_id id, const std::string &payee);
+
+    // Take amount from available ahead of a withdrawal; the account must
+    // have been loaded with ensure_loaded. After the database update call
+    // settle_withdrawal, which debits the balance, or refund exactly once
+    // if it failed. The reservation is kept apart from the balance, so
+    // other changes meanwhile cannot undo it or be undone by the refund.
+    withdrawal reserve_withdrawal(const std::string &username, money amount);
+    void settle_withdrawal(const std::string &username, money amount);
+    void refund(const std::string &username, money amount);
+
+    // Add a deposit to a loaded account. Load the account before changing
+    // the database, so a first load running concurrently cannot read the
+    // old balance and store it after the credit.
+    void credit(const std::string &username, money amount);
+
+    bool lookup(const std::string &username, account &out) const;
+
+    stats snapshot() const;
+
+private:
+    static constexpr std::size_t shard_count = 16;
+
+    struct hold_record
+    {
+        std::string owner;
+        money amount;
+        hold_kind kind = hold_kind::request;
+    };
+
+    struct alignas(64) account_shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, account> accounts;
+    };
+
+    struct alignas(64) hold_shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<hold_id, hold_record> holds;
+    };
+
+    account_shard &shard_for(const std::string &username) const;
+    hold_shard &shard_for(hold_id id) const;
+    void changed(const std::string &username, const account &a) const;
+    release_result take_hold(hold_id id, const std::string *owner, account &after);
+
+    db_pool &pool_;
+    write_behind &writer_;
+    change_handler on_change_;
+
+    std::unique_ptr<account_shard[]> accounts_;
+    std::unique_ptr<hold_shard[]> holds_;
+
+    std::atomic<hold_id> last_hold_{0};
+    std::atomic<std::uint64_t> loads_{0};
+    std::atomic<std::uint64_t> rejected_holds_{0};
+    std::size_t overcommitted_ = 0;
+};
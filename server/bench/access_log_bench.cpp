@@ -0,0 +1,80 @@
+// File: bench/access_log_bench.cpp
+// Measures what the access log adds to a request: the time for a request
+// thread to fill an access_entry and record() it, with several threads
+// logging at once while the writer formats and writes the file. Also
+// reports records dropped because a ring filled faster than the writer
+// drained it.
+//
+// Usage: access_log_bench [threads] [records_per_thread] [path]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../access_log.hpp"
+
+int main(int argc, char **argv)
+{
+    int threads = argc > 1 ? std::atoi(argv[1]) : 4;
+    int records = argc > 2 ? std::atoi(argv[2]) : 1000000;
+    std::string path = argc > 3 ? argv[3] : "access_log_bench.log";
+
+    std::vector<double> ns_per_record(threads);
+    access_log::stats st;
+    double total_seconds = 0;
+    {
+        access_log_options options;
+        options.path = path;
+        access_log log(options);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t)
+            workers.emplace_back([&, t]
+                                 {
+                                     const char target[] = "/auctions/42/bids";
+                                     const char user[] = "bidder17";
+                                     auto begin = std::chrono::steady_clock::now();
+                                     for (int i = 0; i < records; ++i)
+                                     {
+                                         using namespace std::chrono;
+                                         access_entry entry;
+                                         entry.time_us = duration_cast<microseconds>(
+                                                             system_clock::now().time_since_epoch())
+                                                             .count();
+                                         entry.latency_us = 850;
+                                         entry.db_us = 410;
+                                         entry.bytes = 512;
+                                         entry.status = 200;
+                                         entry.set_method("POST", 4);
+                                         entry.set_target(target, sizeof target - 1);
+                                         entry.set_user(user, sizeof user - 1);
+                                         log.record(entry);
+                                     }
+                                     ns_per_record[t] = std::chrono::duration<double, std::nano>(
+                                                            std::chrono::steady_clock::now() - begin)
+                                                            .count() /
+                                                        records;
+                                 });
+        for (auto &w : workers)
+            w.join();
+        total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        st = log.snapshot();
+    }
+    std::remove(path.c_str());
+
+    double worst = 0;
+    for (double ns : ns_per_record)
+        worst = ns > worst ? ns : worst;
+    std::uint64_t total = static_cast<std::uint64_t>(threads) * records;
+    std::cout << threads << " threads x " << records << " records\n"
+              << "record(): " << worst << " ns (slowest thread), "
+              << total / total_seconds << " records/s\n"
+              << "dropped while running: " << st.dropped << " ("
+              << 100.0 * st.dropped / total << "%)\n";
+    return 0;
+}
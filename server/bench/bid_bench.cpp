@@ -0,0 +1,107 @@
+// File: bench/bid_bench.cpp
+// Measures auction_engine bid throughput (bids/sec) as the shard count
+// grows. Producer threads stand in for the network threads: each submits
+// bids on random auctions with rising amounts and counts completions.
+//
+// Usage: bid_bench [producers] [bids_per_producer] [auctions] [max_shards]
+// Shard counts double from 1 up to max_shards (default: hardware cores).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../auction_engine.hpp"
+
+namespace
+{
+struct result
+{
+    double seconds = 0;
+    std::uint64_t accepted = 0;
+};
+
+result run(std::size_t shards, int producers, int bids_per_producer, int auction_count)
+{
+    auction_engine engine(shards);
+
+    std::atomic<int> created{0};
+    std::int64_t now = now_ms();
+    for (int i = 0; i < auction_count; ++i)
+    {
+        auction_spec spec;
+        spec.title = "item";
+        spec.seller = "seller";
+        spec.starting_price = money::from_minor(100);
+        spec.min_increment = money::from_minor(1);
+        spec.starts_at_ms = now - 1000;
+        spec.ends_at_ms = now + 3600 * 1000;
+        engine.create(spec, [&created](bool, const auction_view &)
+                      { created.fetch_add(1, std::memory_order_relaxed); });
+    }
+    while (created.load() < auction_count)
+        std::this_thread::yield();
+
+    std::atomic<std::uint64_t> done{0};
+    std::atomic<std::uint64_t> accepted{0};
+    std::uint64_t total = static_cast<std::uint64_t>(producers) * bids_per_producer;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back(
+            [&, p]
+            {
+                std::mt19937_64 rng(static_cast<std::uint64_t>(p) + 1);
+                std::uniform_int_distribution<auction_id> pick(1, static_cast<auction_id>(auction_count));
+                std::string bidder = "bidder" + std::to_string(p);
+                for (int i = 0; i < bids_per_producer; ++i)
+                {
+                    money amount = money::from_minor(100 + static_cast<money::rep>(i) * producers + p);
+                    engine.place_bid(pick(rng), bidder, amount, 0, now,
+                                     [&](const bid_outcome &o, const auction_view &)
+                                     {
+                                         if (o.status == bid_status::accepted)
+                                             accepted.fetch_add(1, std::memory_order_relaxed);
+                                         done.fetch_add(1, std::memory_order_relaxed);
+                                     });
+                }
+            });
+    }
+    for (auto &t : threads)
+        t.join();
+    while (done.load(std::memory_order_relaxed) < total)
+        std::this_thread::yield();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    result r;
+    r.seconds = std::chrono::duration<double>(elapsed).count();
+    r.accepted = accepted.load();
+    return r;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    int producers = argc > 1 ? std::atoi(argv[1]) : 4;
+    int bids = argc > 2 ? std::atoi(argv[2]) : 250000;
+    int auction_count = argc > 3 ? std::atoi(argv[3]) : 4096;
+    unsigned cores = std::thread::hardware_concurrency();
+    std::size_t max_shards = argc > 4 ? static_cast<std::size_t>(std::atoi(argv[4])) : std::max(1u, cores);
+
+    std::cout << producers << " producers x " << bids << " bids over "
+              << auction_count << " auctions\n";
+    std::cout << "shards\tbids/sec\taccepted\n";
+    for (std::size_t shards = 1; shards <= max_shards; shards *= 2)
+    {
+        result r = run(shards, producers, bids, auction_count);
+        double total = static_cast<double>(producers) * bids;
+        std::cout << shards << "\t" << static_cast<std::uint64_t>(total / r.seconds)
+                  << "\t" << r.accepted << "\n";
+    }
+}
@@ -0,0 +1,212 @@
+// File: bench/broadcast_bench.cpp
+// Measures WebSocket fan-out cost per recipient with websocketpp over the
+// iostream transport (no sockets; written bytes are counted and dropped).
+// Three ways to push one update to every watcher of a topic:
+//   per_recipient: build the JSON and send it to each connection, as the
+//                  websocketpp broadcast examples do
+//   shared_text:   build the JSON once, send(payload) to each connection
+//                  (each still copies, validates and frames it)
+//   prepared:      prepare_broadcast once, send(msg) to each connection
+// and then the cost of a burst of every update to each connection, sent
+// one write per message or corked into one gathered write per connection
+// (transport writes per message are reported alongside).
+//
+// Usage: broadcast_bench [connections] [updates]
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <websocketpp/config/core.hpp>
+#include <websocketpp/server.hpp>
+
+// Every replaceable allocation function is defined so that each new pairs
+// with its own delete. The heap is only touched through the two out-of-line
+// helpers, so the compiler never sees an inlined free() of a pointer it
+// matched to operator new.
+namespace
+{
+std::atomic<std::uint64_t> allocations{0};
+
+__attribute__((noinline)) void *counted_alloc(std::size_t size, std::size_t align = 0) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (align <= alignof(std::max_align_t))
+        return std::malloc(size ? size : 1);
+    // aligned_alloc wants the size to be a multiple of the alignment.
+    return std::aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+__attribute__((noinline)) void counted_free(void *p) noexcept { std::free(p); }
+
+void *checked_alloc(std::size_t size, std::size_t align = 0)
+{
+    if (void *p = counted_alloc(size, align))
+        return p;
+    throw std::bad_alloc();
+}
+}
+
+void *operator new(std::size_t size) { return checked_alloc(size); }
+void *operator new[](std::size_t size) { return checked_alloc(size); }
+void *operator new(std::size_t size, std::align_val_t a) { return checked_alloc(size, static_cast<std::size_t>(a)); }
+void *operator new[](std::size_t size, std::align_val_t a) { return checked_alloc(size, static_cast<std::size_t>(a)); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept { return counted_alloc(size); }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { return counted_alloc(size); }
+void *operator new(std::size_t size, std::align_val_t a, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size, static_cast<std::size_t>(a));
+}
+void *operator new[](std::size_t size, std::align_val_t a, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size, static_cast<std::size_t>(a));
+}
+
+void operator delete(void *p) noexcept { counted_free(p); }
+void operator delete[](void *p) noexcept { counted_free(p); }
+void operator delete(void *p, std::size_t) noexcept { counted_free(p); }
+void operator delete[](void *p, std::size_t) noexcept { counted_free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { counted_free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { counted_free(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { counted_free(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { counted_free(p); }
+
+namespace
+{
+using server = websocketpp::server<websocketpp::config::core>;
+using json = nlohmann::json;
+
+const std::string handshake =
+    "GET /ws HTTP/1.1\r\nHost: bench\r\nConnection: Upgrade\r\nUpgrade: websocket\r\n"
+    "Sec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+
+json update(int i)
+{
+    json auction;
+    auction["id"] = 42;
+    auction["title"] = "Vintage mechanical keyboard";
+    auction["high_bid"] = std::to_string(100 + i) + ".00";
+    auction["leader"] = "bidder" + std::to_string(i % 97);
+    auction["bid_count"] = i + 1;
+    auction["status"] = "open";
+    json message;
+    message["type"] = "auction";
+    message["topic"] = "auction:42";
+    message["auction"] = auction;
+    return message;
+}
+
+void report(const char *name, std::chrono::steady_clock::duration elapsed,
+            std::uint64_t allocs, std::uint64_t bytes, std::uint64_t sends)
+{
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    std::cout << name << ": " << ns / sends << " ns/recipient, "
+              << static_cast<double>(allocs) / sends << " allocations/recipient, "
+              << bytes / sends << " bytes/recipient\n";
+}
+}
+
+int main(int argc, char **argv)
+{
+    int connection_count = argc > 1 ? std::atoi(argv[1]) : 10000;
+    int updates = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+
+    std::uint64_t bytes = 0;
+    std::vector<server::connection_ptr> connections;
+    connections.reserve(connection_count);
+    for (int i = 0; i < connection_count; ++i)
+    {
+        server::connection_ptr con = s.get_connection();
+        con->set_write_handler([&bytes](websocketpp::connection_hdl, char const *, std::size_t len)
+                               {
+                                   bytes += len;
+                                   return websocketpp::lib::error_code();
+                               });
+        con->start();
+        con->read_all(handshake.data(), handshake.size());
+        connections.push_back(con);
+    }
+
+    std::uint64_t sends = static_cast<std::uint64_t>(connection_count) * updates;
+    std::cout << connection_count << " connections, " << updates << " updates\n";
+
+    auto measure = [&](const char *name, const std::function<void(int)> &push)
+    {
+        bytes = 0;
+        std::uint64_t before = allocations.load();
+        auto start = std::chrono::steady_clock::now();
+        for (int u = 0; u < updates; ++u)
+            push(u);
+        report(name, std::chrono::steady_clock::now() - start, allocations.load() - before, bytes, sends);
+    };
+
+    measure("per_recipient", [&](int u)
+            {
+                for (auto &con : connections)
+                    con->send(update(u).dump(), websocketpp::frame::opcode::text);
+            });
+    measure("shared_text", [&](int u)
+            {
+                std::string text = update(u).dump();
+                for (auto &con : connections)
+                    con->send(text, websocketpp::frame::opcode::text);
+            });
+    measure("prepared", [&](int u)
+            {
+                server::message_ptr msg = s.prepare_broadcast(update(u).dump(), websocketpp::frame::opcode::text);
+                for (auto &con : connections)
+                    con->send(msg);
+            });
+
+    std::vector<server::message_ptr> burst;
+    for (int u = 0; u < updates; ++u)
+        burst.push_back(s.prepare_broadcast(update(u).dump(), websocketpp::frame::opcode::text));
+
+    auto total_writes = [&]
+    {
+        websocketpp::write_stats total;
+        for (auto &con : connections)
+            total += con->get_write_stats();
+        return total;
+    };
+
+    auto measure_burst = [&](const char *name, bool cork)
+    {
+        bytes = 0;
+        websocketpp::write_stats before_writes = total_writes();
+        std::uint64_t before = allocations.load();
+        auto start = std::chrono::steady_clock::now();
+        for (auto &con : connections)
+        {
+            if (cork)
+                con->cork();
+            for (auto &msg : burst)
+                con->send(msg);
+            if (cork)
+                con->uncork();
+        }
+        report(name, std::chrono::steady_clock::now() - start, allocations.load() - before, bytes, sends);
+        websocketpp::write_stats after_writes = total_writes();
+        std::cout << "  " << static_cast<double>(after_writes.transport_writes - before_writes.transport_writes) /
+                                 (after_writes.messages_written - before_writes.messages_written)
+                  << " writes/message\n";
+    };
+
+    measure_burst("burst", false);
+    measure_burst("burst_corked", true);
+    return 0;
+}
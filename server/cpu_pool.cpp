@@ -0,0 +1,103 @@
+// File: cpu_pool.cpp
+// Implementation of the bounded CPU worker pool.
+
+#include "cpu_pool.hpp"
+
+#include <exception>
+#include <iostream>
+
+cpu_pool::cpu_pool(std::size_t threads, std::size_t max_queue)
+    : max_queue_(max_queue ? max_queue : 1)
+{
+    if (threads == 0)
+        threads = 1;
+    threads_.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i)
+        threads_.emplace_back([this]
+                              { worker(); });
+}
+
+cpu_pool::~cpu_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+    for (auto &t : threads_)
+        t.join();
+}
+
+bool cpu_pool::try_submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || queue_.size() >= max_queue_)
+        {
+            ++rejected_;
+            return false;
+        }
+        queue_.push_back({std::move(job), clock::now()});
+    }
+    ready_.notify_one();
+    return true;
+}
+
+void cpu_pool::worker()
+{
+    for (;;)
+    {
+        task t;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [this]
+                        { return stopping_ || !queue_.empty(); });
+            if (queue_.empty())
+                return;
+            t = std::move(queue_.front());
+            queue_.pop_front();
+        }
+
+        auto const started = clock::now();
+        try
+        {
+            t.job();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "cpu_pool job: " << e.what() << "\n";
+        }
+        auto const finished = clock::now();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto waited = started - t.queued_at;
+        auto ran = finished - started;
+        ++completed_;
+        total_queue_ += waited;
+        total_run_ += ran;
+        if (waited > max_queue_wait_)
+            max_queue_wait_ = waited;
+        if (ran > max_run_)
+            max_run_ = ran;
+    }
+}
+
+cpu_pool::stats cpu_pool::snapshot() const
+{
+    using ms = std::chrono::duration<double, std::milli>;
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats s;
+    s.threads = threads_.size();
+    s.queued = queue_.size();
+    s.max_queue = max_queue_;
+    s.completed = completed_;
+    s.rejected = rejected_;
+    if (completed_ > 0)
+    {
+        s.avg_queue_ms = ms(total_queue_).count() / static_cast<double>(completed_);
+        s.avg_run_ms = ms(total_run_).count() / static_cast<double>(completed_);
+    }
+    s.max_queue_ms = ms(max_queue_wait_).count();
+    s.max_run_ms = ms(max_run_).count();
+    return s;
+}
@@ -0,0 +1,71 @@
+// File: cpu_pool.hpp
+// Small fixed-size thread pool for CPU-heavy work (password hashing) that
+// must not run on the network threads. The queue is bounded: when it is
+// full, try_submit refuses the job so the caller can shed load (503)
+// instead of letting latency grow without limit.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class cpu_pool
+{
+    using clock = std::chrono::steady_clock;
+
+public:
+    struct stats
+    {
+        std::size_t threads = 0;
+        std::size_t queued = 0;
+        std::size_t max_queue = 0;
+        std::uint64_t completed = 0;
+        std::uint64_t rejected = 0;
+        double avg_queue_ms = 0;  // time from submit to start
+        double max_queue_ms = 0;
+        double avg_run_ms = 0;    // time spent running the job
+        double max_run_ms = 0;
+    };
+
+    cpu_pool(std::size_t threads, std::size_t max_queue);
+    ~cpu_pool();
+
+    cpu_pool(const cpu_pool &) = delete;
+    cpu_pool &operator=(const cpu_pool &) = delete;
+
+    // Queue a job; returns false without queueing if the queue is full.
+    bool try_submit(std::function<void()> job);
+
+    stats snapshot() const;
+
+private:
+    struct task
+    {
+        std::function<void()> job;
+        clock::time_point queued_at;
+    };
+
+    void worker();
+
+    std::size_t max_queue_;
+    std::vector<std::thread> threads_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<task> queue_;
+    bool stopping_ = false;
+
+    std::uint64_t completed_ = 0;
+    std::uint64_t rejected_ = 0;
+    clock::duration total_queue_{0};
+    clock::duration max_queue_wait_{0};
+    clock::duration total_run_{0};
+    clock::duration max_run_{0};
+};
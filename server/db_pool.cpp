@@ -0,0 +1,203 @@
+// File: db_pool.cpp
+// Implementation of the bounded PostgreSQL connection pool.
+
+#include "db_pool.hpp"
+
+db_pool::db_pool(db_pool_options options)
+    : options_(std::move(options))
+{
+    if (options_.max_size == 0)
+        options_.max_size = 1;
+    if (options_.min_size > options_.max_size)
+        options_.min_size = options_.max_size;
+    idle_.reserve(options_.max_size);
+}
+
+namespace
+{
+thread_local std::chrono::nanoseconds thread_time{0};
+}
+
+db_pool::lease::~lease()
+{
+    if (pool_)
+    {
+        pool_->release(std::move(conn_));
+        thread_time += clock::now() - start_;
+    }
+}
+
+std::chrono::nanoseconds db_pool::take_thread_time()
+{
+    std::chrono::nanoseconds taken = thread_time;
+    thread_time = std::chrono::nanoseconds{0};
+    return taken;
+}
+
+std::unique_ptr<pqxx::connection> db_pool::open_connection()
+{
+    auto conn = std::make_unique<pqxx::connection>(options_.conninfo);
+    if (!conn->is_open())
+        throw pqxx::broken_connection("Database connection failed");
+    if (options_.on_connect)
+        options_.on_connect(*conn);
+    return conn;
+}
+
+void db_pool::warm_up()
+{
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (open_ >= options_.min_size)
+                return;
+            ++open_;
+        }
+
+        std::unique_ptr<pqxx::connection> conn;
+        try
+        {
+            conn = open_connection();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --open_;
+            throw;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.push_back({std::move(conn), clock::now()});
+        available_.notify_one();
+    }
+}
+
+// A connection is usable if it is still open and, when it has sat idle
+// long enough for a server or load balancer to have dropped it, still
+// answers a trivial query.
+bool db_pool::healthy(idle_entry &entry)
+{
+    if (!entry.conn->is_open())
+        return false;
+    if (clock::now() - entry.since < options_.idle_check)
+        return true;
+    try
+    {
+        pqxx::nontransaction N(*entry.conn);
+        N.exec("SELECT 1");
+        return true;
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+}
+
+db_pool::lease db_pool::acquire()
+{
+    auto const start = clock::now();
+    auto const deadline = start + options_.checkout_timeout;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        if (!idle_.empty())
+        {
+            idle_entry entry = std::move(idle_.back());
+            idle_.pop_back();
+            ++in_use_;
+            record_wait_locked(start);
+            lock.unlock();
+
+            if (healthy(entry))
+                return lease(this, std::move(entry.conn), start);
+
+            entry.conn.reset();
+            lock.lock();
+            --in_use_;
+            drop_locked();
+            continue;
+        }
+
+        if (open_ < options_.max_size)
+        {
+            ++open_;
+            ++in_use_;
+            record_wait_locked(start);
+            lock.unlock();
+            try
+            {
+                return lease(this, open_connection(), start);
+            }
+            catch (...)
+            {
+                lock.lock();
+                --in_use_;
+                --open_;
+                available_.notify_one();
+                thread_time += clock::now() - start;
+                throw;
+            }
+        }
+
+        if (available_.wait_until(lock, deadline) == std::cv_status::timeout &&
+            idle_.empty() && open_ >= options_.max_size)
+        {
+            ++timeouts_;
+            thread_time += clock::now() - start;
+            throw db_pool_timeout();
+        }
+    }
+}
+
+void db_pool::release(std::unique_ptr<pqxx::connection> conn)
+{
+    // Connections that broke while leased (pqxx closes them on
+    // broken_connection) are evicted rather than handed out again.
+    bool usable = conn && conn->is_open();
+    if (!usable)
+        conn.reset();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    --in_use_;
+    if (usable)
+        idle_.push_back({std::move(conn), clock::now()});
+    else
+        drop_locked();
+    available_.notify_one();
+}
+
+void db_pool::drop_locked()
+{
+    --open_;
+    ++evictions_;
+    available_.notify_one();
+}
+
+void db_pool::record_wait_locked(clock::time_point start)
+{
+    auto waited = clock::now() - start;
+    ++checkouts_;
+    total_wait_ += waited;
+    if (waited > max_wait_)
+        max_wait_ = waited;
+}
+
+db_pool::stats db_pool::snapshot() const
+{
+    using ms = std::chrono::duration<double, std::milli>;
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats s;
+    s.open = open_;
+    s.idle = idle_.size();
+    s.in_use = in_use_;
+    s.max_size = options_.max_size;
+    s.checkouts = checkouts_;
+    s.timeouts = timeouts_;
+    s.evictions = evictions_;
+    if (checkouts_ > 0)
+        s.avg_wait_ms = ms(total_wait_).count() / static_cast<double>(checkouts_);
+    s.max_wait_ms = ms(max_wait_).count();
+    return s;
+}
@@ -0,0 +1,131 @@
+// File: db_pool.hpp
+// Bounded pool of libpqxx connections shared by all request handlers.
+// Connections are opened up front (warm_up), handed out LIFO so the most
+// recently used ones stay hot, health-checked on checkout when they have
+// been idle for a while, and dropped instead of returned once broken.
+// A checkout that cannot be satisfied within the timeout throws
+// db_pool_timeout so handlers can answer 503 instead of queueing forever.
+// Each thread adds the time its leases were held, from the start of
+// acquire() to their release, to a thread-local total that request
+// logging reads with take_thread_time().
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <pqxx/pqxx>
+
+struct db_pool_options
+{
+    std::string conninfo;
+    std::size_t min_size = 2;                            // opened by warm_up()
+    std::size_t max_size = 16;                           // hard cap on open connections
+    std::chrono::milliseconds checkout_timeout{2000};    // give up (503) after this wait
+    std::chrono::seconds idle_check{30};                 // ping connections idle longer than this
+    std::function<void(pqxx::connection &)> on_connect;  // per-connection setup, e.g. prepared statements
+};
+
+// Thrown by db_pool::acquire when no connection became available in time.
+class db_pool_timeout : public std::runtime_error
+{
+public:
+    db_pool_timeout() : std::runtime_error("Timed out waiting for a database connection") {}
+};
+
+class db_pool
+{
+    using clock = std::chrono::steady_clock;
+
+    struct idle_entry
+    {
+        std::unique_ptr<pqxx::connection> conn;
+        clock::time_point since;
+    };
+
+public:
+    // A checked-out connection; returned to the pool when destroyed.
+    class lease
+    {
+    public:
+        lease(lease &&other) noexcept
+            : pool_(other.pool_), conn_(std::move(other.conn_)), start_(other.start_)
+        {
+            other.pool_ = nullptr;
+        }
+        lease(const lease &) = delete;
+        lease &operator=(const lease &) = delete;
+        lease &operator=(lease &&) = delete;
+        ~lease();
+
+        pqxx::connection &operator*() const { return *conn_; }
+        pqxx::connection *operator->() const { return conn_.get(); }
+
+    private:
+        friend class db_pool;
+        lease(db_pool *pool, std::unique_ptr<pqxx::connection> conn, clock::time_point start)
+            : pool_(pool), conn_(std::move(conn)), start_(start)
+        {
+        }
+
+        db_pool *pool_;
+        std::unique_ptr<pqxx::connection> conn_;
+        clock::time_point start_; // when acquire() was called
+    };
+
+    struct stats
+    {
+        std::size_t open = 0;    // connections currently open (idle + in use)
+        std::size_t idle = 0;
+        std::size_t in_use = 0;
+        std::size_t max_size = 0;
+        std::uint64_t checkouts = 0;
+        std::uint64_t timeouts = 0;
+        std::uint64_t evictions = 0;
+        double avg_wait_ms = 0;
+        double max_wait_ms = 0;
+    };
+
+    explicit db_pool(db_pool_options options);
+
+    // Open connections until min_size are available. Throws if the
+    // database cannot be reached.
+    void warm_up();
+
+    // Check out a connection, waiting up to checkout_timeout.
+    lease acquire();
+
+    stats snapshot() const;
+
+    // Time the calling thread has spent in acquire() or holding leases
+    // since its previous call.
+    static std::chrono::nanoseconds take_thread_time();
+
+private:
+    std::unique_ptr<pqxx::connection> open_connection();
+    bool healthy(idle_entry &entry);
+    void release(std::unique_ptr<pqxx::connection> conn);
+    void drop_locked();
+    void record_wait_locked(clock::time_point start);
+
+    db_pool_options options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable available_;
+    std::vector<idle_entry> idle_;
+    std::size_t open_ = 0;   // includes connections being opened
+    std::size_t in_use_ = 0;
+
+    std::uint64_t checkouts_ = 0;
+    std::uint64_t timeouts_ = 0;
+    std::uint64_t evictions_ = 0;
+    clock::duration total_wait_{0};
+    clock::duration max_wait_{0};
+};
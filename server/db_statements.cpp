@@ -0,0 +1,44 @@
+// File: db_statements.cpp
+// Creates the server-owned tables once at startup and registers the
+// statements declared in db_statements.hpp on each pooled connection.
+
+#include "db_statements.hpp"
+
+void create_tables(pqxx::connection &conn)
+{
+    pqxx::nontransaction N(conn);
+    N.exec("CREATE TABLE IF NOT EXISTS auctions ("
+           "  auction_id BIGINT PRIMARY KEY,"
+           "  title TEXT NOT NULL,"
+           "  seller TEXT NOT NULL,"
+           "  starting_price NUMERIC(18,2) NOT NULL,"
+           "  reserve NUMERIC(18,2) NOT NULL,"
+           "  min_increment NUMERIC(18,2) NOT NULL,"
+           "  starts_at_ms BIGINT NOT NULL,"
+           "  ends_at_ms BIGINT NOT NULL,"
+           "  high_bid NUMERIC(18,2) NOT NULL DEFAULT 0,"
+           "  leader TEXT NOT NULL DEFAULT '',"
+           "  bid_count INTEGER NOT NULL DEFAULT 0)");
+    N.exec("CREATE TABLE IF NOT EXISTS bids ("
+           "  auction_id BIGINT NOT NULL,"
+           "  bid_count INTEGER NOT NULL,"
+           "  bidder TEXT NOT NULL,"
+           "  amount NUMERIC(18,2) NOT NULL,"
+           "  placed_at_ms BIGINT NOT NULL,"
+           "  PRIMARY KEY (auction_id, bid_count))");
+    N.exec("ALTER TABLE auctions ADD COLUMN IF NOT EXISTS leader_hold BIGINT NOT NULL DEFAULT 0");
+    N.exec("CREATE TABLE IF NOT EXISTS balance_holds ("
+           "  hold_id BIGINT PRIMARY KEY,"
+           "  username TEXT NOT NULL,"
+           "  amount NUMERIC(18,2) NOT NULL,"
+           "  created_at_ms BIGINT NOT NULL)");
+    N.exec("ALTER TABLE balance_holds ADD COLUMN IF NOT EXISTS for_bid BOOLEAN NOT NULL DEFAULT FALSE");
+    N.exec("ALTER TABLE auctions ADD COLUMN IF NOT EXISTS settled BOOLEAN NOT NULL DEFAULT FALSE");
+}
+
+void prepare_statements(pqxx::connection &conn)
+{
+#define AUCTION_PREPARE_STATEMENT(name, sql) conn.prepare(#name, sql);
+    AUCTION_STATEMENTS(AUCTION_PREPARE_STATEMENT)
+#undef AUCTION_PREPARE_STATEMENT
+}
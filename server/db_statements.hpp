@@ -0,0 +1,63 @@
+// File: db_statements.hpp
+// Every SQL statement the handlers run, declared once here and prepared on
+// each pooled connection when it is opened, so the database parses and
+// plans them once per connection instead of once per request.
+//
+// To add a statement, add one X(name, sql) line to AUCTION_STATEMENTS and
+// run it with W.exec_prepared(stmt::name, args...). Tables the server
+// owns are created in db_statements.cpp.
+
+#pragma once
+
+#include <pqxx/pqxx>
+
+#define AUCTION_STATEMENTS(X)                                                   \
+    X(find_user_id, "SELECT user_id FROM users WHERE username = $1")            \
+    X(insert_user, "INSERT INTO users (username, password) VALUES ($1, $2)")    \
+    X(user_login, "SELECT password, balance FROM users WHERE username = $1")    \
+    X(update_password, "UPDATE users SET password = $1 WHERE username = $2")    \
+    X(user_balance, "SELECT balance FROM users WHERE username = $1")            \
+    X(deposit, "UPDATE users SET balance = balance + $1 "                       \
+               "WHERE username = $2 RETURNING balance")                         \
+    X(withdraw, "UPDATE users SET balance = balance - $1 "                      \
+                "WHERE username = $2 AND balance >= $1 RETURNING balance")       \
+    X(debit, "UPDATE users SET balance = balance - $1 WHERE username = $2")     \
+    X(load_auctions, "SELECT * FROM auctions")                                  \
+    X(insert_auction, "INSERT INTO auctions (auction_id, title, seller, "       \
+                      "starting_price, reserve, min_increment, starts_at_ms, "  \
+                      "ends_at_ms) VALUES ($1, $2, $3, $4, $5, $6, $7, $8) "    \
+                      "ON CONFLICT (auction_id) DO NOTHING")                    \
+    X(insert_bid, "INSERT INTO bids (auction_id, bid_count, bidder, amount, "   \
+                  "placed_at_ms) VALUES ($1, $2, $3, $4, $5) "                  \
+                  "ON CONFLICT (auction_id, bid_count) DO NOTHING")             \
+    X(update_auction_high, "UPDATE auctions SET high_bid = $2, leader = $3, "   \
+                           "bid_count = $4, leader_hold = $5 "                  \
+                           "WHERE auction_id = $1 AND bid_count < $4")          \
+    X(mark_settled, "UPDATE auctions SET settled = TRUE WHERE auction_id = $1") \
+    X(load_holds, "SELECT hold_id, username, amount, for_bid OR hold_id IN "    \
+                  "(SELECT leader_hold FROM auctions) AS for_bid "              \
+                  "FROM balance_holds")                                         \
+    X(insert_hold, "INSERT INTO balance_holds (hold_id, username, amount, "     \
+                   "created_at_ms, for_bid) VALUES ($1, $2, $3, $4, $5) "       \
+                   "ON CONFLICT (hold_id) DO NOTHING")                          \
+    X(delete_hold, "DELETE FROM balance_holds WHERE hold_id = $1")              \
+    X(max_hold_id, "SELECT GREATEST((SELECT COALESCE(MAX(hold_id), 0) "         \
+                   "FROM balance_holds), (SELECT COALESCE(MAX(leader_hold), "   \
+                   "0) FROM auctions))")
+
+// Statement names, for use with exec_prepared.
+namespace stmt
+{
+#define AUCTION_STATEMENT_NAME(name, sql) constexpr const char *name = #name;
+    AUCTION_STATEMENTS(AUCTION_STATEMENT_NAME)
+#undef AUCTION_STATEMENT_NAME
+}
+
+// Create the tables this server owns (auctions, bids, balance_holds) if
+// they are missing. Run once at startup, before the pool opens any
+// connection. The users table is managed outside the server.
+void create_tables(pqxx::connection &conn);
+
+// Prepare all statements on a freshly opened connection. The tables must
+// already exist; see create_tables.
+void prepare_statements(pqxx::connection &conn);
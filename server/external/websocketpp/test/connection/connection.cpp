@@ -531,3 +531,221 @@ BOOST_AUTO_TEST_CASE( server_handshake_timeout_race2 ) {
 }
 
 
+
+BOOST_AUTO_TEST_CASE( conflate_queued_messages ) {
+    debug_server s;
+
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: AAAAAAAAAAAAAAAAAAAAAA==\r\n\r\n";
+
+    debug_server::connection_ptr con = s.get_connection();
+    con->start();
+    con->read_all(input.data(), input.size());
+    con->fullfil_write();
+
+    // The first message is in flight; the rest queue behind it.
+    BOOST_CHECK(!con->send("start"));
+    BOOST_CHECK(!con->send("a1",websocketpp::frame::opcode::text,"a"));
+    BOOST_CHECK(!con->send("b1",websocketpp::frame::opcode::text,"b"));
+    BOOST_CHECK(!con->send("a22",websocketpp::frame::opcode::text,"a"));
+    BOOST_CHECK(!con->send("c"));
+
+    BOOST_CHECK_EQUAL(con->get_conflated_count(), 1);
+    BOOST_CHECK_EQUAL(con->get_buffered_amount(), 6);
+
+    // Once the queue is handed to the transport nothing is left to replace.
+    con->fullfil_write();
+    BOOST_CHECK_EQUAL(con->get_buffered_amount(), 0);
+
+    BOOST_CHECK(!con->send("a3",websocketpp::frame::opcode::text,"a"));
+    BOOST_CHECK(!con->send("a4",websocketpp::frame::opcode::text,"a"));
+    BOOST_CHECK_EQUAL(con->get_conflated_count(), 2);
+    BOOST_CHECK_EQUAL(con->get_buffered_amount(), 2);
+}
+
+BOOST_AUTO_TEST_CASE( conflated_message_keeps_its_place ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+
+    server::connection_ptr con = s.get_connection();
+    std::string output;
+    bool queued = false;
+
+    // Send more while "start" is being written, as a slow reader would
+    // make them wait.
+    con->set_write_handler([&](websocketpp::connection_hdl, char const * buf,
+        size_t len)
+    {
+        output.append(buf,len);
+        if (!queued && output.find("start") != std::string::npos) {
+            queued = true;
+            con->send("a1",websocketpp::frame::opcode::text,"a");
+            con->send("b1",websocketpp::frame::opcode::text,"b");
+            con->send("a2",websocketpp::frame::opcode::text,"a");
+            con->send("c");
+        }
+        return websocketpp::lib::error_code();
+    });
+    con->start();
+    con->read_all(input.data(), input.size());
+    output.clear();
+
+    BOOST_CHECK(!con->send("start"));
+    BOOST_CHECK_EQUAL(output, "\x81\x05start\x81\x02" "a2\x81\x02" "b1\x81\x01" "c");
+}
+
+BOOST_AUTO_TEST_CASE( max_buffered_amount_closes_slow_reader ) {
+    debug_server s;
+    s.set_max_buffered_amount(8);
+
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: AAAAAAAAAAAAAAAAAAAAAA==\r\n\r\n";
+
+    debug_server::connection_ptr con = s.get_connection();
+    BOOST_CHECK_EQUAL(con->get_max_buffered_amount(), 8);
+    con->start();
+    con->read_all(input.data(), input.size());
+    con->fullfil_write();
+
+    BOOST_CHECK(!con->send("start"));
+    BOOST_CHECK(!con->send("abc"));
+    BOOST_CHECK_EQUAL(con->send("defghi"),
+        make_error_code(websocketpp::error::send_queue_full));
+
+    // The backlog is dropped; only the close frame (code and reason) waits.
+    BOOST_CHECK_EQUAL(con->get_buffered_amount(),
+        2 + std::string("Send queue limit exceeded").size());
+    BOOST_CHECK_EQUAL(con->get_state(), websocketpp::session::state::closing);
+    BOOST_CHECK_EQUAL(con->get_local_close_code(),
+        websocketpp::close::status::try_again_later);
+    BOOST_CHECK_EQUAL(con->send("more"),
+        make_error_code(websocketpp::error::invalid_state));
+}
+
+BOOST_AUTO_TEST_CASE( max_buffered_amount_allows_one_large_message ) {
+    debug_server s;
+    s.set_max_buffered_amount(4);
+
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: AAAAAAAAAAAAAAAAAAAAAA==\r\n\r\n";
+
+    debug_server::connection_ptr con = s.get_connection();
+    con->start();
+    con->read_all(input.data(), input.size());
+    con->fullfil_write();
+
+    // Nothing queued: a message over the limit still goes out.
+    BOOST_CHECK(!con->send("oversized"));
+    BOOST_CHECK_EQUAL(con->get_state(), websocketpp::session::state::open);
+
+    // Queued behind a write in flight, it is accepted alone too...
+    BOOST_CHECK(!con->send("also oversized"));
+    BOOST_CHECK_EQUAL(con->get_state(), websocketpp::session::state::open);
+
+    // ...but not with another message already waiting.
+    BOOST_CHECK_EQUAL(con->send("x"),
+        make_error_code(websocketpp::error::send_queue_full));
+    BOOST_CHECK_EQUAL(con->get_state(), websocketpp::session::state::closing);
+}
+
+BOOST_AUTO_TEST_CASE( write_batch_message_limit ) {
+    debug_server s;
+    s.set_max_write_batch_messages(2);
+
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: AAAAAAAAAAAAAAAAAAAAAA==\r\n\r\n";
+
+    debug_server::connection_ptr con = s.get_connection();
+    BOOST_CHECK_EQUAL(con->get_max_write_batch_messages(), 2);
+    con->start();
+    con->read_all(input.data(), input.size());
+    con->fullfil_write();
+
+    BOOST_CHECK(!con->send("start"));
+    BOOST_CHECK(!con->send("a"));
+    BOOST_CHECK(!con->send("b"));
+    BOOST_CHECK(!con->send("c"));
+    BOOST_CHECK(!con->send("d"));
+    BOOST_CHECK(!con->send("e"));
+    BOOST_CHECK_EQUAL(con->get_write_stats().transport_writes, 1);
+
+    con->fullfil_write();
+    BOOST_CHECK_EQUAL(con->get_write_stats().messages_written, 3);
+    con->fullfil_write();
+    con->fullfil_write();
+
+    websocketpp::write_stats stats = con->get_write_stats();
+    BOOST_CHECK_EQUAL(stats.transport_writes, 4);
+    BOOST_CHECK_EQUAL(stats.messages_written, 6);
+    BOOST_CHECK_EQUAL(stats.bytes_written, 2 * 6 + 10);
+    BOOST_CHECK_EQUAL(con->get_buffered_amount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( write_batch_byte_limit ) {
+    debug_server s;
+    s.set_max_write_batch_bytes(8);
+
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: AAAAAAAAAAAAAAAAAAAAAA==\r\n\r\n";
+
+    debug_server::connection_ptr con = s.get_connection();
+    con->start();
+    con->read_all(input.data(), input.size());
+    con->fullfil_write();
+
+    // Frames of two byte payloads are four bytes on the wire.
+    BOOST_CHECK(!con->send("start"));
+    BOOST_CHECK(!con->send("ab"));
+    BOOST_CHECK(!con->send("cd"));
+    BOOST_CHECK(!con->send("ef"));
+    BOOST_CHECK(!con->send("longer than the limit"));
+
+    con->fullfil_write();
+    BOOST_CHECK_EQUAL(con->get_write_stats().messages_written, 3);
+    con->fullfil_write();
+    BOOST_CHECK_EQUAL(con->get_write_stats().messages_written, 4);
+
+    // Oversized messages are written on their own.
+    con->fullfil_write();
+    BOOST_CHECK_EQUAL(con->get_write_stats().messages_written, 5);
+    BOOST_CHECK_EQUAL(con->get_write_stats().transport_writes, 4);
+}
+
+BOOST_AUTO_TEST_CASE( cork_coalesces_sends ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+
+    server::connection_ptr con = s.get_connection();
+    std::string output;
+    con->set_write_handler([&](websocketpp::connection_hdl, char const * buf,
+        size_t len)
+    {
+        output.append(buf,len);
+        return websocketpp::lib::error_code();
+    });
+    con->start();
+    con->read_all(input.data(), input.size());
+    output.clear();
+
+    con->cork();
+    BOOST_CHECK(con->is_corked());
+    BOOST_CHECK(!con->send("a"));
+    BOOST_CHECK(!con->send("b"));
+    BOOST_CHECK(!con->send("c"));
+    BOOST_CHECK_EQUAL(output, "");
+    BOOST_CHECK_EQUAL(con->get_write_stats().transport_writes, 0);
+
+    con->uncork();
+    BOOST_CHECK(!con->is_corked());
+    BOOST_CHECK_EQUAL(output, "\x81\x01" "a\x81\x01" "b\x81\x01" "c");
+
+    websocketpp::write_stats stats = con->get_write_stats();
+    BOOST_CHECK_EQUAL(stats.transport_writes, 1);
+    BOOST_CHECK_EQUAL(stats.messages_written, 3);
+    BOOST_CHECK_CLOSE(stats.writes_per_message(), 1.0 / 3.0, 0.001);
+
+    // Uncorked sends are written as they are made.
+    BOOST_CHECK(!con->send("d"));
+    BOOST_CHECK_EQUAL(con->get_write_stats().transport_writes, 2);
+}
@@ -729,10 +729,226 @@ BOOST_AUTO_TEST_CASE( compress_empty ) {
     BOOST_CHECK_EQUAL( compress_in, decompress_out );
 }
 
-/// @todo: more compression tests
-/**
- * - compress at different compression levels
- */
+// Local policy
+BOOST_AUTO_TEST_CASE( set_options_invalid ) {
+    ext_vars v;
+    websocketpp::extensions::permessage_deflate::options opts;
+
+    opts.server_max_window_bits = 7;
+    BOOST_CHECK_EQUAL( v.exts.set_options(opts), pmde::make_error_code(pmde::invalid_max_window_bits) );
+
+    opts = websocketpp::extensions::permessage_deflate::options();
+    opts.client_max_window_bits = 16;
+    BOOST_CHECK_EQUAL( v.exts.set_options(opts), pmde::make_error_code(pmde::invalid_max_window_bits) );
+
+    opts = websocketpp::extensions::permessage_deflate::options();
+    opts.compression_level = 10;
+    BOOST_CHECK_EQUAL( v.exts.set_options(opts), pmde::make_error_code(pmde::invalid_options) );
+
+    opts = websocketpp::extensions::permessage_deflate::options();
+    opts.memory_level = 0;
+    BOOST_CHECK_EQUAL( v.exts.set_options(opts), pmde::make_error_code(pmde::invalid_options) );
+}
+
+BOOST_AUTO_TEST_CASE( set_options_negotiation ) {
+    ext_vars v;
+    websocketpp::extensions::permessage_deflate::options opts;
+
+    opts.server_no_context_takeover = true;
+    opts.server_max_window_bits = 8;
+    opts.client_max_window_bits = 10;
+    opts.client_max_window_bits_mode = pmd_mode::largest;
+    BOOST_CHECK_EQUAL( v.exts.set_options(opts), websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( v.exts.get_options().server_max_window_bits, 9 );
+
+    v.attr["client_max_window_bits"].clear();
+
+    v.esp = v.exts.negotiate(v.attr);
+    BOOST_CHECK( v.exts.is_enabled() );
+    BOOST_CHECK_EQUAL( v.esp.first, websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( v.esp.second, "permessage-deflate; server_no_context_takeover; server_max_window_bits=9; client_max_window_bits=10");
+}
+
+// The server may only limit the client's window if the client offered
+// client_max_window_bits
+BOOST_AUTO_TEST_CASE( client_max_window_bits_not_offered ) {
+    ext_vars v;
+
+    v.ec = v.exts.set_client_max_window_bits(10,pmd_mode::accept);
+    BOOST_CHECK_EQUAL( v.ec, websocketpp::lib::error_code() );
+
+    v.esp = v.exts.negotiate(v.attr);
+    BOOST_CHECK_EQUAL( v.esp.first, websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( v.esp.second, "permessage-deflate");
+
+    // data compressed with the default window must still inflate
+    std::string compress_in;
+    for (int i = 0; i < 2000; i++) {
+        compress_in += char('a' + (i * 7) % 26);
+    }
+    compress_in += compress_in;
+
+    std::string compress_out;
+    std::string decompress_out;
+
+    BOOST_CHECK_EQUAL( v.extc.init(false), websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( v.exts.init(true), websocketpp::lib::error_code() );
+
+    v.ec = v.extc.compress(compress_in,compress_out);
+    BOOST_CHECK_EQUAL( v.ec, websocketpp::lib::error_code() );
+
+    v.ec = v.exts.decompress(reinterpret_cast<const uint8_t *>(compress_out.data()),compress_out.size(),decompress_out);
+    BOOST_CHECK_EQUAL( v.ec, websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( compress_in, decompress_out );
+}
+
+// A failed offer must not leak settings into the next one
+BOOST_AUTO_TEST_CASE( negotiate_resets_between_offers ) {
+    ext_vars v;
+
+    v.attr["server_no_context_takeover"].clear();
+    v.attr["foo"] = "bar";
+
+    v.esp = v.exts.negotiate(v.attr);
+    BOOST_CHECK_EQUAL( v.esp.first, pmde::make_error_code(pmde::invalid_attributes) );
+
+    v.attr.clear();
+
+    v.esp = v.exts.negotiate(v.attr);
+    BOOST_CHECK_EQUAL( v.esp.first, websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( v.esp.second, "permessage-deflate");
+}
+
+BOOST_AUTO_TEST_CASE( compression_threshold ) {
+    ext_vars v;
+    websocketpp::extensions::permessage_deflate::options opts;
+
+    BOOST_CHECK( v.exts.should_compress(0) );
+
+    opts.compression_threshold = 100;
+    BOOST_CHECK_EQUAL( v.exts.set_options(opts), websocketpp::lib::error_code() );
+
+    BOOST_CHECK( !v.exts.should_compress(0) );
+    BOOST_CHECK( !v.exts.should_compress(99) );
+    BOOST_CHECK( v.exts.should_compress(100) );
+    BOOST_CHECK_EQUAL( v.exts.get_stats().messages_skipped, 2 );
+
+    disabled_type d;
+    BOOST_CHECK( !d.should_compress(100) );
+}
+
+BOOST_AUTO_TEST_CASE( compression_stats ) {
+    ext_vars v;
+
+    std::string compress_in(4000,'x');
+    std::string compress_out;
+    std::string decompress_out;
+
+    BOOST_CHECK_EQUAL( v.exts.get_stats().compression_ratio(), 1.0 );
+
+    v.ec = v.exts.init(true);
+    BOOST_CHECK_EQUAL( v.ec, websocketpp::lib::error_code() );
+
+    for (int i = 0; i < 3; i++) {
+        v.ec = v.exts.compress(compress_in,compress_out);
+        BOOST_CHECK_EQUAL( v.ec, websocketpp::lib::error_code() );
+    }
+
+    v.ec = v.exts.decompress(reinterpret_cast<const uint8_t *>(compress_out.data()),compress_out.size(),decompress_out);
+    BOOST_CHECK_EQUAL( v.ec, websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( decompress_out.size(), 3 * compress_in.size() );
+
+    websocketpp::extensions::permessage_deflate::stats s = v.exts.get_stats();
+    BOOST_CHECK_EQUAL( s.messages_compressed, 3 );
+    BOOST_CHECK_EQUAL( s.compress_bytes_in, 3 * compress_in.size() );
+    BOOST_CHECK_EQUAL( s.compress_bytes_out, compress_out.size() );
+    BOOST_CHECK_LT( s.compression_ratio(), 0.1 );
+    BOOST_CHECK_EQUAL( s.decompress_bytes_in, compress_out.size() );
+    BOOST_CHECK_EQUAL( s.decompress_bytes_out, decompress_out.size() );
+
+    websocketpp::extensions::permessage_deflate::stats total;
+    total += s;
+    total += s;
+    BOOST_CHECK_EQUAL( total.messages_compressed, 6 );
+    BOOST_CHECK_EQUAL( total.compress_ns, 2 * s.compress_ns );
+}
+
+BOOST_AUTO_TEST_CASE( compress_levels ) {
+    std::string compress_in;
+    for (int i = 0; i < 50000; i++) {
+        compress_in += char('a' + (i * i) % 26);
+    }
+
+    for (int level = -1; level <= 9; level++) {
+        for (int bits = 9; bits <= 15; bits += 3) {
+            ext_vars v;
+            websocketpp::extensions::permessage_deflate::options opts;
+
+            opts.compression_level = level;
+            opts.memory_level = 1 + (level + 1) % 9;
+            opts.server_max_window_bits = uint8_t(bits);
+            opts.server_max_window_bits_mode = pmd_mode::decline;
+            BOOST_CHECK_EQUAL( v.exts.set_options(opts), websocketpp::lib::error_code() );
+
+            v.exts.negotiate(v.attr);
+            BOOST_CHECK_EQUAL( v.exts.init(true), websocketpp::lib::error_code() );
+            BOOST_CHECK_EQUAL( v.extc.init(false), websocketpp::lib::error_code() );
+
+            std::string compress_out;
+            std::string decompress_out;
+
+            v.ec = v.exts.compress(compress_in,compress_out);
+            BOOST_CHECK_EQUAL( v.ec, websocketpp::lib::error_code() );
+
+            v.ec = v.extc.decompress(reinterpret_cast<const uint8_t *>(compress_out.data()),compress_out.size(),decompress_out);
+            BOOST_CHECK_EQUAL( v.ec, websocketpp::lib::error_code() );
+            BOOST_CHECK( compress_in == decompress_out );
+        }
+    }
+}
+
+// Connections without context takeover may share one compression stream.
+// Interleaving them must not let one connection's data leak into another's.
+BOOST_AUTO_TEST_CASE( compress_interleaved_no_context_takeover ) {
+    ext_vars v1;
+    ext_vars v2;
+
+    v1.exts.enable_server_no_context_takeover();
+    v2.exts.enable_server_no_context_takeover();
+    BOOST_CHECK_EQUAL( v1.exts.init(true), websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( v2.exts.init(true), websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( v1.extc.init(false), websocketpp::lib::error_code() );
+    BOOST_CHECK_EQUAL( v2.extc.init(false), websocketpp::lib::error_code() );
+
+    std::string a = "{\"topic\":\"item:1\",\"price\":\"10.00\",\"bidder\":\"alice\"}";
+    std::string b = "{\"topic\":\"item:2\",\"price\":\"99.50\",\"bidder\":\"bob\"}";
+
+    std::string out1;
+    std::string out2;
+
+    for (int i = 0; i < 3; i++) {
+        std::string c1;
+        std::string c2;
+        std::string d1;
+        std::string d2;
+
+        BOOST_CHECK_EQUAL( v1.exts.compress(a,c1), websocketpp::lib::error_code() );
+        BOOST_CHECK_EQUAL( v2.exts.compress(b,c2), websocketpp::lib::error_code() );
+
+        // Every message compresses the same as the first one
+        if (i == 0) {
+            out1 = c1;
+            out2 = c2;
+        }
+        BOOST_CHECK_EQUAL( c1, out1 );
+        BOOST_CHECK_EQUAL( c2, out2 );
+
+        BOOST_CHECK_EQUAL( v1.extc.decompress(reinterpret_cast<const uint8_t *>(c1.data()),c1.size(),d1), websocketpp::lib::error_code() );
+        BOOST_CHECK_EQUAL( v2.extc.decompress(reinterpret_cast<const uint8_t *>(c2.data()),c2.size(),d2), websocketpp::lib::error_code() );
+        BOOST_CHECK_EQUAL( d1, a );
+        BOOST_CHECK_EQUAL( d2, b );
+    }
+}
 
 // Decompression
 BOOST_AUTO_TEST_CASE( decompress_data ) {
@@ -934,6 +934,84 @@ BOOST_AUTO_TEST_CASE( header_aggregation ) {
     BOOST_CHECK_EQUAL( r.get_header("Foo"), "bar, bat" );
 }
 
+BOOST_AUTO_TEST_CASE( header_lookup_case_insensitive ) {
+    websocketpp::http::parser::request r;
+
+    std::string raw = "GET / HTTP/1.1\r\nhost: www.example.com\r\nSEC-WEBSOCKET-KEY: dGhlIHNhbXBsZSBub25jZQ==\r\nfoo: bar\r\nFOO: bat\r\n\r\n";
+
+    size_t pos = r.consume(raw.c_str(),raw.size());
+
+    BOOST_CHECK_EQUAL( pos, raw.size() );
+    BOOST_CHECK( r.ready() == true );
+    BOOST_CHECK_EQUAL( r.get_header("Host"), "www.example.com" );
+    BOOST_CHECK_EQUAL( r.get_header("Sec-WebSocket-Key"), "dGhlIHNhbXBsZSBub25jZQ==" );
+    BOOST_CHECK_EQUAL( r.get_header("Foo"), "bar, bat" );
+    BOOST_CHECK_EQUAL( r.get_header("Missing"), "" );
+    BOOST_CHECK_EQUAL( r.get_headers().size(), 3 );
+
+    // parsed headers can be modified like headers set by the application
+    r.replace_header("HOST","example.org");
+    r.append_header("foo","baz");
+    r.remove_header("sec-websocket-key");
+
+    BOOST_CHECK_EQUAL( r.get_header("host"), "example.org" );
+    BOOST_CHECK_EQUAL( r.get_header("foo"), "bar, bat, baz" );
+    BOOST_CHECK_EQUAL( r.get_header("Sec-WebSocket-Key"), "" );
+    BOOST_CHECK_EQUAL( r.get_headers().size(), 2 );
+    BOOST_CHECK_EQUAL( r.raw(), "GET / HTTP/1.1\r\nfoo: bar, bat, baz\r\nhost: example.org\r\n\r\n" );
+}
+
+BOOST_AUTO_TEST_CASE( byte_at_a_time ) {
+    websocketpp::http::parser::request r;
+
+    std::string raw = "GET /chat HTTP/1.1\r\nHost: server.example.com\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\nextra";
+
+    size_t pos = 0;
+    for (size_t i = 0; i < raw.size() && !r.ready(); ++i) {
+        pos += r.consume(raw.data()+i,1);
+    }
+
+    BOOST_CHECK_EQUAL( pos, raw.size() - 5 );
+    BOOST_CHECK( r.ready() == true );
+    BOOST_CHECK_EQUAL( r.get_uri(), "/chat" );
+    BOOST_CHECK_EQUAL( r.get_header("Host"), "server.example.com" );
+    BOOST_CHECK_EQUAL( r.get_header("Connection"), "Upgrade" );
+    BOOST_CHECK_EQUAL( r.get_header("Sec-WebSocket-Version"), "13" );
+}
+
+BOOST_AUTO_TEST_CASE( copied_request ) {
+    websocketpp::http::parser::request r;
+
+    std::string raw = "GET / HTTP/1.1\r\nHost: www.example.com\r\nUpgrade: websocket\r\n\r\n";
+
+    r.consume(raw.c_str(),raw.size());
+
+    websocketpp::http::parser::request copy(r);
+    r = websocketpp::http::parser::request();
+
+    BOOST_CHECK( copy.ready() == true );
+    BOOST_CHECK_EQUAL( copy.get_header("Host"), "www.example.com" );
+    BOOST_CHECK_EQUAL( copy.get_header("Upgrade"), "websocket" );
+}
+
+BOOST_AUTO_TEST_CASE( bad_header_line ) {
+    websocketpp::http::parser::request r;
+
+    std::string raw = "GET / HTTP/1.1\r\nHost: www.example.com\r\nno separator\r\n\r\n";
+
+    bool exception = false;
+
+    try {
+        r.consume(raw.c_str(),raw.size());
+    } catch (websocketpp::http::exception const & e) {
+        exception = true;
+        BOOST_CHECK_EQUAL( e.m_error_code, websocketpp::http::status_code::bad_request );
+    }
+
+    BOOST_CHECK( exception == true );
+    BOOST_CHECK( r.ready() == false );
+}
+
 BOOST_AUTO_TEST_CASE( wikipedia_example_response ) {
     websocketpp::http::parser::response r;
 
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2014, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE async_log
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <websocketpp/logger/async.hpp>
+#include <websocketpp/concurrency/basic.hpp>
+
+typedef websocketpp::log::async<websocketpp::concurrency::basic,
+    websocketpp::log::alevel> access_log;
+
+namespace {
+
+size_t count_lines(std::string const & text) {
+    size_t lines = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\n') {
+            lines++;
+        }
+    }
+    return lines;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( writes_reach_stream ) {
+    std::stringstream out;
+    {
+        access_log logger(0xffffffff,&out);
+        logger.set_channels(websocketpp::log::alevel::connect);
+
+        logger.write(websocketpp::log::alevel::connect,"connected");
+        logger.write(websocketpp::log::alevel::devel,std::string("devel"));
+        logger.flush();
+    }
+
+    std::string text = out.str();
+    BOOST_CHECK( text.find("[connect] connected\n") != std::string::npos );
+    BOOST_CHECK( text.find("devel") == std::string::npos );
+    BOOST_CHECK_EQUAL( text[0], '[' );
+}
+
+BOOST_AUTO_TEST_CASE( destructor_flushes ) {
+    std::stringstream out;
+    {
+        access_log logger(0xffffffff,&out);
+        logger.set_flush_interval(60000);
+        logger.set_channels(websocketpp::log::alevel::all);
+        logger.write(websocketpp::log::alevel::devel,"devel");
+    }
+    BOOST_CHECK_EQUAL( count_lines(out.str()), 1 );
+}
+
+BOOST_AUTO_TEST_CASE( access_clear ) {
+    std::stringstream out;
+    {
+        access_log logger(0xffffffff,&out);
+        logger.set_channels(0xffffffff);
+        logger.clear_channels(0xffffffff);
+        logger.write(websocketpp::log::alevel::devel,"devel");
+    }
+    BOOST_CHECK( out.str().empty() );
+}
+
+BOOST_AUTO_TEST_CASE( static_channels ) {
+    typedef websocketpp::log::async<websocketpp::concurrency::basic,
+        websocketpp::log::elevel,websocketpp::log::elevel::fatal> fatal_log;
+
+    std::stringstream out;
+    {
+        fatal_log logger(0xffffffff,&out);
+        logger.set_channels(websocketpp::log::elevel::all);
+
+        BOOST_CHECK( logger.static_test(websocketpp::log::elevel::fatal) );
+        BOOST_CHECK( !logger.static_test(websocketpp::log::elevel::rerror) );
+        BOOST_CHECK( !logger.dynamic_test(websocketpp::log::elevel::rerror) );
+
+        logger.write(websocketpp::log::elevel::rerror,"error");
+        logger.write(websocketpp::log::elevel::fatal,"fatal");
+    }
+    BOOST_CHECK_EQUAL( count_lines(out.str()), 1 );
+    BOOST_CHECK( out.str().find("fatal") != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( runtime_static_channels ) {
+    std::stringstream out;
+    access_log logger(websocketpp::log::alevel::connect,&out);
+    logger.set_channels(websocketpp::log::alevel::all);
+
+    BOOST_CHECK( logger.static_test(websocketpp::log::alevel::connect) );
+    BOOST_CHECK( !logger.static_test(websocketpp::log::alevel::devel) );
+    BOOST_CHECK( !logger.dynamic_test(websocketpp::log::alevel::devel) );
+}
+
+BOOST_AUTO_TEST_CASE( oversized_message_dropped ) {
+    std::stringstream out;
+    {
+        access_log logger(0xffffffff,&out);
+        logger.set_ring_size(256);
+        logger.set_channels(websocketpp::log::alevel::all);
+
+        logger.write(websocketpp::log::alevel::devel,std::string(1000,'x'));
+        logger.write(websocketpp::log::alevel::devel,"fits");
+        BOOST_CHECK_EQUAL( logger.get_dropped(), 1 );
+    }
+    BOOST_CHECK_EQUAL( count_lines(out.str()), 1 );
+}
+
+BOOST_AUTO_TEST_CASE( full_ring_counts_drops ) {
+    std::stringstream out;
+    uint64_t dropped;
+    {
+        access_log logger(0xffffffff,&out);
+        logger.set_ring_size(1024);
+        logger.set_channels(websocketpp::log::alevel::all);
+
+        // Much more than fits in the ring: every message is either written
+        // or counted as dropped.
+        std::string msg(100,'m');
+        for (int i = 0; i < 10000; i++) {
+            logger.write(websocketpp::log::alevel::devel,msg);
+        }
+        logger.flush();
+        dropped = logger.get_dropped();
+    }
+    BOOST_CHECK( dropped > 0 );
+    BOOST_CHECK_EQUAL( count_lines(out.str()) + dropped, 10000 );
+}
+
+BOOST_AUTO_TEST_CASE( threads_keep_their_order ) {
+    int const thread_count = 4;
+    int const messages = 2000;
+
+    std::stringstream out;
+    uint64_t dropped;
+    {
+        access_log logger(0xffffffff,&out);
+        logger.set_ring_size(1024 * 1024);
+        logger.set_channels(websocketpp::log::alevel::all);
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < thread_count; t++) {
+            threads.push_back(std::thread([&logger,t,messages] {
+                for (int i = 0; i < messages; i++) {
+                    std::stringstream s;
+                    s << "t" << t << " " << i;
+                    logger.write(websocketpp::log::alevel::app,s.str());
+                }
+            }));
+        }
+        for (int t = 0; t < thread_count; t++) {
+            threads[t].join();
+        }
+        dropped = logger.get_dropped();
+    }
+    BOOST_CHECK_EQUAL( dropped, 0 );
+
+    std::vector<int> next(thread_count,0);
+    std::string line;
+    bool ordered = true;
+    size_t lines = 0;
+    while (std::getline(out,line)) {
+        size_t pos = line.find("] t");
+        BOOST_REQUIRE( pos != std::string::npos );
+        std::istringstream fields(line.substr(pos + 3));
+        int t, i;
+        fields >> t >> i;
+        if (next[t] != i) {
+            ordered = false;
+        }
+        next[t] = i + 1;
+        lines++;
+    }
+    BOOST_CHECK( ordered );
+    BOOST_CHECK_EQUAL( lines, size_t(thread_count * messages) );
+}
+
+BOOST_AUTO_TEST_CASE( copy_constructor ) {
+    std::stringstream out;
+    {
+        access_log logger1(0xffffffff,&out);
+        access_log logger2(logger1);
+
+        logger2.set_channels(0xffffffff);
+        logger2.write(websocketpp::log::alevel::devel,"devel");
+    }
+    BOOST_CHECK( out.str().size() > 0 );
+}
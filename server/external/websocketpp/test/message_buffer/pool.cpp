@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2011, Peter Thorson. All rights reserved.
+ * Copyright (c) 2014, Peter Thorson. All rights reserved.
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions are met:
@@ -24,133 +24,297 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
  */
+
 //#define BOOST_TEST_DYN_LINK
-#define BOOST_TEST_MODULE hybi_00_processor
+#define BOOST_TEST_MODULE message_buffer_pool
 #include <boost/test/unit_test.hpp>
 
-#include <iostream>
+#include <cstdlib>
+#include <new>
 #include <string>
 
-#include <websocketpp/processors/hybi00.hpp>
-#include <websocketpp/http/request.hpp>
-#include <websocketpp/http/response.hpp>
+#include <websocketpp/message_buffer/message.hpp>
+#include <websocketpp/message_buffer/pool.hpp>
+
+// Count every heap allocation made by the test program. Every replaceable
+// allocation and deallocation function is defined, so each new is paired
+// with a matching delete. The heap is touched only through the two helpers
+// below, kept out of line so the compiler does not pair an inlined free()
+// with the operator new it was matched to.
+static size_t allocation_count = 0;
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void * counted_alloc(std::size_t size) throw() {
+    ++allocation_count;
+    return std::malloc(size ? size : 1);
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void counted_free(void * p) throw() {
+    std::free(p);
+}
+
+void * operator new(std::size_t size) {
+    void * p = counted_alloc(size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void * operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void * operator new(std::size_t size, std::nothrow_t const &) throw() {
+    return counted_alloc(size);
+}
+
+void * operator new[](std::size_t size, std::nothrow_t const &) throw() {
+    return counted_alloc(size);
+}
+
+void operator delete(void * p) throw() {
+    counted_free(p);
+}
 
+void operator delete[](void * p) throw() {
+    counted_free(p);
+}
 
-BOOST_AUTO_TEST_CASE( exact_match ) {
-    websocketpp::http::parser::request r;
-    websocketpp::http::parser::response response;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
+void operator delete(void * p, std::nothrow_t const &) throw() {
+    counted_free(p);
+}
 
-    std::string handshake = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nOrigin: http://example.com\r\nSec-WebSocket-Key1: 3e6b263  4 17 80\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
+void operator delete[](void * p, std::nothrow_t const &) throw() {
+    counted_free(p);
+}
 
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","WjN}|M(6");
+void operator delete(void * p, std::size_t) throw() {
+    counted_free(p);
+}
 
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(p.validate_handshake(r));
+void operator delete[](void * p, std::size_t) throw() {
+    counted_free(p);
+}
 
-    websocketpp::uri_ptr u;
-    bool exception;
+#ifdef __cpp_aligned_new
+#include <cstdint>
 
-    try {
-        u = p.get_uri(r);
-    } catch (const websocketpp::uri_exception& e) {
-        exception = true;
+// Over-aligned forms: the block returned by malloc() is stored just before
+// the aligned address handed out.
+static void * counted_aligned_alloc(std::size_t size, std::align_val_t align) throw() {
+    std::size_t const a = static_cast<std::size_t>(align);
+    void * raw = counted_alloc(size + a + sizeof(void *));
+    if (!raw) {
+        return NULL;
     }
+    std::uintptr_t p = reinterpret_cast<std::uintptr_t>(raw) + sizeof(void *);
+    p = (p + a - 1) & ~static_cast<std::uintptr_t>(a - 1);
+    reinterpret_cast<void **>(p)[-1] = raw;
+    return reinterpret_cast<void *>(p);
+}
 
-    BOOST_CHECK(exception == false);
-    BOOST_CHECK(u->get_secure() == false);
-    BOOST_CHECK(u->get_host() == "www.example.com");
-    BOOST_CHECK(u->get_resource() == "/");
-    BOOST_CHECK(u->get_port() == websocketpp::URI_DEFAULT_PORT);
+static void counted_aligned_free(void * p) throw() {
+    if (p) {
+        counted_free(static_cast<void **>(p)[-1]);
+    }
+}
 
-    p.process_handshake(r,response);
+void * operator new(std::size_t size, std::align_val_t align) {
+    void * p = counted_aligned_alloc(size, align);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void * operator new[](std::size_t size, std::align_val_t align) {
+    return operator new(size, align);
+}
+
+void * operator new(std::size_t size, std::align_val_t align,
+    std::nothrow_t const &) noexcept
+{
+    return counted_aligned_alloc(size, align);
+}
+
+void * operator new[](std::size_t size, std::align_val_t align,
+    std::nothrow_t const &) noexcept
+{
+    return counted_aligned_alloc(size, align);
+}
 
-    BOOST_CHECK(response.get_header("Connection") == "Upgrade");
-    BOOST_CHECK(response.get_header("Upgrade") == "websocket");
-    BOOST_CHECK(response.get_header("Sec-WebSocket-Origin") == "http://example.com");
+void operator delete(void * p, std::align_val_t) noexcept {
+    counted_aligned_free(p);
+}
 
-    BOOST_CHECK(response.get_header("Sec-WebSocket-Location") == "ws://www.example.com/");
-    BOOST_CHECK(response.get_header("Sec-WebSocket-Key3") == "n`9eBk9z$R8pOtVb");
+void operator delete[](void * p, std::align_val_t) noexcept {
+    counted_aligned_free(p);
 }
 
-BOOST_AUTO_TEST_CASE( non_get_method ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
+void operator delete(void * p, std::align_val_t, std::nothrow_t const &) noexcept {
+    counted_aligned_free(p);
+}
 
-    std::string handshake = "POST / HTTP/1.1\r\nHost: www.example.com\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key1: 3e6b263  4 17 80\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
+void operator delete[](void * p, std::align_val_t, std::nothrow_t const &) noexcept {
+    counted_aligned_free(p);
+}
 
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
+void operator delete(void * p, std::size_t, std::align_val_t) noexcept {
+    counted_aligned_free(p);
+}
 
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake(r));
+void operator delete[](void * p, std::size_t, std::align_val_t) noexcept {
+    counted_aligned_free(p);
 }
+#endif
 
-BOOST_AUTO_TEST_CASE( old_http_version ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
+typedef websocketpp::message_buffer::message<
+    websocketpp::message_buffer::pool::con_msg_manager> message_type;
+typedef websocketpp::message_buffer::pool::con_msg_manager<message_type>
+    con_msg_man_type;
 
-    std::string handshake = "GET / HTTP/1.0\r\nHost: www.example.com\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key1: 3e6b263  4 17 80\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
+BOOST_AUTO_TEST_CASE( get_message_size_class ) {
+    con_msg_man_type::ptr manager(new con_msg_man_type());
 
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
+    message_type::ptr msg = manager->get_message(websocketpp::frame::opcode::TEXT,100);
+    BOOST_CHECK(msg);
+    BOOST_CHECK(msg->get_opcode() == websocketpp::frame::opcode::TEXT);
+    BOOST_CHECK(msg->get_payload().capacity() >= 128);
 
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake(r));
+    message_type::ptr big = manager->get_message(websocketpp::frame::opcode::BINARY,3000);
+    BOOST_CHECK(big->get_payload().capacity() >= 8192);
+    BOOST_CHECK_EQUAL(manager->get_allocated_count(), 2);
 }
 
-BOOST_AUTO_TEST_CASE( missing_handshake_key1 ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
+BOOST_AUTO_TEST_CASE( recycle_and_reuse ) {
+    con_msg_man_type::ptr manager(new con_msg_man_type());
+
+    message_type::ptr msg = manager->get_message(websocketpp::frame::opcode::TEXT,100);
+    message_type * raw = msg.get();
+    msg->set_payload("payload");
+    msg->set_header("header");
+    msg->set_prepared(true);
+    msg->set_fin(false);
+    msg->set_terminal(true);
+    msg->set_compressed(true);
+    msg.reset();
+
+    BOOST_CHECK(manager->get_pooled_bytes() >= 128);
+
+    msg = manager->get_message(websocketpp::frame::opcode::BINARY,50);
+    BOOST_CHECK(msg.get() == raw);
+    BOOST_CHECK_EQUAL(manager->get_allocated_count(), 1);
+    BOOST_CHECK_EQUAL(manager->get_reused_count(), 1);
+    BOOST_CHECK_EQUAL(manager->get_pooled_bytes(), 0);
+
+    BOOST_CHECK(msg->get_opcode() == websocketpp::frame::opcode::BINARY);
+    BOOST_CHECK(msg->get_payload().empty());
+    BOOST_CHECK(msg->get_header().empty());
+    BOOST_CHECK(!msg->get_prepared());
+    BOOST_CHECK(msg->get_fin());
+    BOOST_CHECK(!msg->get_terminal());
+    BOOST_CHECK(!msg->get_compressed());
+}
 
-    std::string handshake = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key1: 3e6b263  4 17 80\r\n\r\n";
+BOOST_AUTO_TEST_CASE( small_request_uses_next_class ) {
+    con_msg_man_type::ptr manager(new con_msg_man_type());
 
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
+    message_type * raw = manager->get_message(websocketpp::frame::opcode::TEXT,500).get();
 
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake(r));
+    // A 512 byte message can serve a 100 byte request
+    message_type::ptr msg = manager->get_message(websocketpp::frame::opcode::TEXT,100);
+    BOOST_CHECK(msg.get() == raw);
+
+    // but a 32 KiB one is not handed out for it
+    message_type * large = manager->get_message(websocketpp::frame::opcode::TEXT,20000).get();
+    message_type::ptr other = manager->get_message(websocketpp::frame::opcode::TEXT,100);
+    BOOST_CHECK(other.get() != large);
+    BOOST_CHECK(other->get_payload().capacity() < 20000);
+    BOOST_CHECK_EQUAL(manager->get_allocated_count(), 3);
 }
 
-BOOST_AUTO_TEST_CASE( missing_handshake_key2 ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
+BOOST_AUTO_TEST_CASE( get_empty_message_reuses_smallest ) {
+    con_msg_man_type::ptr manager(new con_msg_man_type());
+
+    message_type * small = manager->get_message(websocketpp::frame::opcode::TEXT,10).get();
+    manager->get_message(websocketpp::frame::opcode::TEXT,5000);
+
+    message_type::ptr msg = manager->get_message();
+    BOOST_CHECK(msg.get() == small);
+    BOOST_CHECK_EQUAL(manager->get_allocated_count(), 2);
+}
 
-    std::string handshake = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
+BOOST_AUTO_TEST_CASE( oversize_not_pooled ) {
+    con_msg_man_type::ptr manager(new con_msg_man_type());
+    manager->set_max_pooled_bytes(1024*1024);
 
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
+    manager->get_message(websocketpp::frame::opcode::BINARY,512*1024);
+    BOOST_CHECK_EQUAL(manager->get_pooled_bytes(), 0);
 
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake(r));
+    manager->get_message(websocketpp::frame::opcode::BINARY,128*1024);
+    BOOST_CHECK_EQUAL(manager->get_pooled_bytes(), 128*1024);
 }
 
-BOOST_AUTO_TEST_CASE( bad_host ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
-    websocketpp::uri_ptr u;
-    bool exception = false;
+BOOST_AUTO_TEST_CASE( pooled_bytes_limit ) {
+    con_msg_man_type::ptr manager(new con_msg_man_type());
+    manager->set_max_pooled_bytes(1000);
+
+    message_type::ptr a = manager->get_message(websocketpp::frame::opcode::TEXT,512);
+    message_type::ptr b = manager->get_message(websocketpp::frame::opcode::TEXT,512);
+    a.reset();
+    b.reset();
+    BOOST_CHECK_EQUAL(manager->get_pooled_bytes(), 512);
 
-    std::string handshake = "GET / HTTP/1.1\r\nHost: www.example.com:70000\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
+    manager->set_max_pooled_bytes(0);
+    manager->get_message(websocketpp::frame::opcode::TEXT,512);
+    BOOST_CHECK_EQUAL(manager->get_pooled_bytes(), 0);
+}
 
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
+BOOST_AUTO_TEST_CASE( message_outlives_manager_reference ) {
+    con_msg_man_type::ptr manager(new con_msg_man_type());
+    con_msg_man_type::weak_ptr weak = manager;
 
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake(r));
+    message_type::ptr msg = manager->get_message(websocketpp::frame::opcode::TEXT,100);
+    manager.reset();
+
+    // Outstanding messages keep their manager alive
+    BOOST_CHECK(!weak.expired());
+    msg->set_payload("still usable");
+    BOOST_CHECK_EQUAL(msg->get_payload(), "still usable");
+
+    msg.reset();
+    BOOST_CHECK(weak.expired());
+}
+
+BOOST_AUTO_TEST_CASE( steady_state_allocates_nothing ) {
+    con_msg_man_type::ptr manager(new con_msg_man_type());
+    std::string const payload(300,'x');
+
+    // The pattern of a received message followed by a sent one: a sized
+    // inbound message, and an outbound message from get_message()
+    // holding a copy of the payload.
+    for (int i = 0; i < 4; ++i) {
+        message_type::ptr in = manager->get_message(websocketpp::frame::opcode::TEXT,payload.size());
+        in->append_payload(payload);
+        message_type::ptr out = manager->get_message();
+        out->set_payload(in->get_payload());
+    }
 
-    try {
-        u = p.get_uri(r);
-    } catch (const websocketpp::uri_exception& e) {
-        exception = true;
+    size_t before = allocation_count;
+    for (int i = 0; i < 1000; ++i) {
+        message_type::ptr in = manager->get_message(websocketpp::frame::opcode::TEXT,payload.size());
+        in->append_payload(payload);
+        message_type::ptr out = manager->get_message();
+        out->set_payload(in->get_payload());
     }
+    size_t allocations = allocation_count - before;
 
-    BOOST_CHECK(exception == true);
+    BOOST_CHECK_EQUAL(allocations, 0);
+    BOOST_CHECK(manager->get_allocated_count() <= 2);
 }
@@ -691,3 +691,78 @@ BOOST_AUTO_TEST_CASE( extension_negotiation_permessage_deflate ) {
     BOOST_CHECK_EQUAL( neg_results.second, "permessage-deflate" );
 }
 
+
+BOOST_AUTO_TEST_CASE( extension_negotiation_permessage_deflate_options ) {
+    processor_setup_ext env(true);
+
+    websocketpp::extensions::permessage_deflate::options opts;
+    opts.server_no_context_takeover = true;
+    opts.server_max_window_bits = 10;
+    opts.client_max_window_bits = 11;
+    opts.client_max_window_bits_mode =
+        websocketpp::extensions::permessage_deflate::mode::largest;
+    env.p.set_permessage_deflate_options(opts);
+
+    env.req.replace_header("Sec-WebSocket-Extensions",
+        "permessage-deflate; client_max_window_bits");
+
+    std::pair<websocketpp::lib::error_code,std::string> neg_results;
+    neg_results = env.p.negotiate_extensions(env.req);
+
+    BOOST_CHECK( !neg_results.first );
+    BOOST_CHECK_EQUAL( neg_results.second, "permessage-deflate; "
+        "server_no_context_takeover; server_max_window_bits=10; "
+        "client_max_window_bits=11" );
+}
+
+BOOST_AUTO_TEST_CASE( extension_negotiation_permessage_deflate_bad_options ) {
+    processor_setup_ext env(true);
+
+    websocketpp::extensions::permessage_deflate::options opts;
+    opts.memory_level = 0;
+    env.p.set_permessage_deflate_options(opts);
+
+    env.req.replace_header("Sec-WebSocket-Extensions","permessage-deflate");
+
+    std::pair<websocketpp::lib::error_code,std::string> neg_results;
+    neg_results = env.p.negotiate_extensions(env.req);
+
+    BOOST_CHECK( neg_results.first );
+    BOOST_CHECK_EQUAL( neg_results.second, "" );
+}
+
+BOOST_AUTO_TEST_CASE( prepare_data_frame_compression_threshold ) {
+    processor_setup_ext env(true);
+
+    websocketpp::extensions::permessage_deflate::options opts;
+    opts.compression_threshold = 64;
+    env.p.set_permessage_deflate_options(opts);
+
+    env.req.replace_header("Sec-WebSocket-Extensions","permessage-deflate");
+    BOOST_CHECK( !env.p.negotiate_extensions(env.req).first );
+
+    message_ptr in = env.msg_manager->get_message();
+    message_ptr out = env.msg_manager->get_message();
+    in->set_opcode(websocketpp::frame::opcode::TEXT);
+    in->set_compressed(true);
+
+    // below the threshold: sent as is with RSV1 clear
+    in->set_payload(std::string(63,'a'));
+    BOOST_CHECK( !env.p.prepare_data_frame(in,out) );
+    BOOST_CHECK_EQUAL( out->get_header()[0], char(0x81) );
+    BOOST_CHECK_EQUAL( out->get_payload(), in->get_payload() );
+
+    // at the threshold: compressed with RSV1 set
+    out = env.msg_manager->get_message();
+    in->set_payload(std::string(64,'a'));
+    BOOST_CHECK( !env.p.prepare_data_frame(in,out) );
+    BOOST_CHECK_EQUAL( out->get_header()[0], char(0xC1) );
+    BOOST_CHECK_LT( out->get_payload().size(), 64 );
+
+    websocketpp::extensions::permessage_deflate::stats s =
+        env.p.get_permessage_deflate_stats();
+    BOOST_CHECK_EQUAL( s.messages_skipped, 1 );
+    BOOST_CHECK_EQUAL( s.messages_compressed, 1 );
+    BOOST_CHECK_EQUAL( s.compress_bytes_in, 64 );
+    BOOST_CHECK_EQUAL( s.compress_bytes_out, out->get_payload().size() + 4 );
+}
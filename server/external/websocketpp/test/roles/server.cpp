@@ -236,6 +236,59 @@ BOOST_AUTO_TEST_CASE( accept_subprotocol_two ) {
     BOOST_CHECK_EQUAL(open, "bar");
 }
 
+BOOST_AUTO_TEST_CASE( prepare_broadcast_frame ) {
+    server s;
+    websocketpp::lib::error_code ec;
+
+    message_ptr msg = s.prepare_broadcast("foo",websocketpp::frame::opcode::text,ec);
+    BOOST_CHECK(!ec);
+    BOOST_REQUIRE(msg);
+    BOOST_CHECK(msg->get_prepared());
+    BOOST_CHECK_EQUAL(msg->get_header(), "\x81\x03");
+    BOOST_CHECK_EQUAL(msg->get_payload(), "foo");
+
+    std::string big(300,'x');
+    msg = s.prepare_broadcast(big,websocketpp::frame::opcode::binary,ec);
+    BOOST_CHECK(!ec);
+    BOOST_REQUIRE(msg);
+    BOOST_CHECK_EQUAL(msg->get_header(), std::string("\x82\x7E\x01\x2C",4));
+
+    msg = s.prepare_broadcast("\xFF",websocketpp::frame::opcode::text,ec);
+    BOOST_CHECK_EQUAL(ec, websocketpp::processor::error::invalid_payload);
+    BOOST_CHECK(!msg);
+
+    msg = s.prepare_broadcast("foo",websocketpp::frame::opcode::ping,ec);
+    BOOST_CHECK_EQUAL(ec, websocketpp::processor::error::invalid_opcode);
+    BOOST_CHECK(!msg);
+}
+
+BOOST_AUTO_TEST_CASE( broadcast_to_many_connections ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+    std::string handshake = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\nServer: test\r\nUpgrade: websocket\r\n\r\n";
+
+    server s;
+    s.set_user_agent("test");
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+
+    std::stringstream output[3];
+    server::connection_ptr con[3];
+    for (int i = 0; i < 3; ++i) {
+        con[i] = s.get_connection();
+        con[i]->register_ostream(&output[i]);
+        con[i]->start();
+        std::stringstream channel;
+        channel << input;
+        channel >> *con[i];
+    }
+
+    message_ptr msg = s.prepare_broadcast("update",websocketpp::frame::opcode::text);
+    for (int i = 0; i < 3; ++i) {
+        BOOST_CHECK(!con[i]->send(msg));
+        BOOST_CHECK_EQUAL(output[i].str(), handshake + "\x81\x06update");
+    }
+}
+
 /*BOOST_AUTO_TEST_CASE( user_reject_origin ) {
     std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example2.com\r\n\r\n";
     std::string output = "HTTP/1.1 403 Forbidden\r\nServer: test\r\n\r\n";
@@ -388,6 +388,73 @@ BOOST_AUTO_TEST_CASE( async_write_vector_2_vector_write_handler ) {
     BOOST_CHECK_EQUAL( output, "foobar" );
 }
 
+void deferred_write_handler(std::string & o, websocketpp::connection_hdl, std::vector<websocketpp::transport::buffer> const & bufs) {
+    for (size_t i = 0; i < bufs.size(); i++) {
+        o += std::string(bufs[i].buf, bufs[i].len);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( async_write_async_handler ) {
+    std::string output;
+
+    stub_con::ptr con(new stub_con(true,alogger,elogger));
+    con->set_async_write_handler(websocketpp::lib::bind(
+        &deferred_write_handler,
+        websocketpp::lib::ref(output),
+        websocketpp::lib::placeholders::_1,
+        websocketpp::lib::placeholders::_2
+    ));
+
+    con->write("foo");
+
+    // The write is not complete until the application says so
+    BOOST_CHECK_EQUAL( output, "foo" );
+    BOOST_CHECK_EQUAL( con->ec, make_error_code(websocketpp::error::test) );
+
+    con->complete_write(websocketpp::lib::error_code());
+    BOOST_CHECK( !con->ec );
+}
+
+BOOST_AUTO_TEST_CASE( async_write_vector_async_handler ) {
+    std::string output;
+
+    stub_con::ptr con(new stub_con(true,alogger,elogger));
+    con->set_write_handler(websocketpp::lib::bind(
+        &write_handler,
+        websocketpp::lib::ref(output),
+        websocketpp::lib::placeholders::_1,
+        websocketpp::lib::placeholders::_2,
+        websocketpp::lib::placeholders::_3
+    ));
+    con->set_async_write_handler(websocketpp::lib::bind(
+        &deferred_write_handler,
+        websocketpp::lib::ref(output),
+        websocketpp::lib::placeholders::_1,
+        websocketpp::lib::placeholders::_2
+    ));
+
+    std::vector<websocketpp::transport::buffer> bufs;
+
+    std::string foo = "foo";
+    std::string bar = "bar";
+
+    bufs.push_back(websocketpp::transport::buffer(foo.data(),foo.size()));
+    bufs.push_back(websocketpp::transport::buffer(bar.data(),bar.size()));
+
+    con->write(bufs);
+
+    BOOST_CHECK_EQUAL( output, "foobar" );
+    BOOST_CHECK_EQUAL( con->ec, make_error_code(websocketpp::error::test) );
+
+    con->complete_write(make_error_code(websocketpp::transport::error::eof));
+    BOOST_CHECK_EQUAL( con->ec, make_error_code(websocketpp::transport::error::eof) );
+
+    // A second completion without an outstanding write is ignored
+    con->ec = make_error_code(websocketpp::error::test);
+    con->complete_write(websocketpp::lib::error_code());
+    BOOST_CHECK_EQUAL( con->ec, make_error_code(websocketpp::error::test) );
+}
+
 BOOST_AUTO_TEST_CASE( async_read_at_least_too_much ) {
     stub_con::ptr con(new stub_con(true,alogger,elogger));
 
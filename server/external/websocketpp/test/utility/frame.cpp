@@ -536,3 +536,67 @@ BOOST_AUTO_TEST_CASE( continuous_word_mask2 ) {
     frame::word_mask_circ(buffer,12,pkey);
     BOOST_CHECK( std::equal(buffer,buffer+12,unmasked) );
 }
+
+typedef size_t (*mask_kernel)(uint8_t *, uint8_t *, size_t, size_t);
+
+// Compare a masking kernel against byte_mask over a range of lengths, buffer
+// alignments and split points, both copying and in place.
+void check_mask_kernel(mask_kernel kernel) {
+    frame::masking_key_type key;
+    key.c[0] = 0xEE;
+    key.c[1] = 0x70;
+    key.c[2] = 0xFB;
+    key.c[3] = 0xD5;
+
+    uint8_t input[512+3];
+    uint8_t output[512+3];
+    uint8_t expected[512];
+
+    for (size_t i = 0; i < sizeof(input); ++i) {
+        input[i] = static_cast<uint8_t>(i * 7 + 3);
+    }
+
+    for (size_t align = 0; align < 3; ++align) {
+        for (size_t length = 0; length <= 512; ++length) {
+            byte_mask(input+align,input+align+length,expected,key);
+
+            // One call
+            std::fill_n(output,sizeof(output),0x00);
+            size_t pkey = frame::prepare_masking_key(key);
+            size_t next = kernel(input+align,output+align,length,pkey);
+            BOOST_CHECK( std::equal(output+align,output+align+length,expected) );
+            BOOST_CHECK_EQUAL( next, frame::circshift_prepared_key(pkey,length%sizeof(size_t)) );
+
+            // Two calls split off the word and block boundaries, in place
+            std::copy(input+align,input+align+length,output+align);
+            size_t split = length / 3;
+            pkey = kernel(output+align,output+align,split,frame::prepare_masking_key(key));
+            kernel(output+align+split,output+align+split,length-split,pkey);
+            BOOST_CHECK( std::equal(output+align,output+align+length,expected) );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( mask_kernel_scalar ) {
+    check_mask_kernel(&frame::word_mask_circ_scalar);
+}
+
+#ifdef _WEBSOCKETPP_SSE2_MASKING_
+BOOST_AUTO_TEST_CASE( mask_kernel_sse2 ) {
+    check_mask_kernel(&frame::word_mask_circ_sse2);
+}
+#endif
+
+#ifdef _WEBSOCKETPP_AVX2_MASKING_
+BOOST_AUTO_TEST_CASE( mask_kernel_avx2 ) {
+    if (frame::get_mask_isa() != frame::mask_isa::avx2) {
+        BOOST_TEST_MESSAGE( "CPU does not support AVX2, skipping" );
+        return;
+    }
+    check_mask_kernel(&frame::word_mask_circ_avx2);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE( mask_kernel_dispatch ) {
+    check_mask_kernel(static_cast<mask_kernel>(&frame::word_mask_circ));
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2011, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+// Masking throughput for each kernel across payload sizes. Not part of the
+// test suite; build with optimization, e.g.
+//   g++ -std=c++11 -O2 -I../.. frame_perf.cpp -o frame_perf
+
+#include <websocketpp/frame.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace websocketpp;
+
+typedef size_t (*mask_kernel)(uint8_t *, uint8_t *, size_t, size_t);
+
+size_t byte_kernel(uint8_t * input, uint8_t * output, size_t length,
+    size_t prepared_key)
+{
+    return frame::byte_mask_circ(input,output,length,prepared_key);
+}
+
+// Unmask in place, as the hybi13 processor does, and report GB/s
+double run(mask_kernel kernel, uint8_t * buffer, size_t length) {
+    size_t const total = 256 * 1024 * 1024;
+    size_t iterations = total / length;
+    size_t pkey = 0x12345678;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        pkey = kernel(buffer,buffer,length,pkey);
+    }
+    std::chrono::nanoseconds taken = std::chrono::steady_clock::now()-start;
+
+    // keep the result observable
+    if (buffer[length/2] == 0 && pkey == 0) {
+        std::printf(" ");
+    }
+    return double(iterations * length) / double(taken.count());
+}
+
+int main() {
+    size_t const sizes[] = {16, 64, 128, 256, 512, 1024, 4096, 65536, 1048576};
+
+    struct named_kernel {
+        char const * name;
+        mask_kernel kernel;
+    };
+    std::vector<named_kernel> kernels;
+    named_kernel byte_k = {"byte_mask_circ", &byte_kernel};
+    named_kernel scalar_k = {"scalar", &frame::word_mask_circ_scalar};
+    kernels.push_back(byte_k);
+    kernels.push_back(scalar_k);
+#ifdef _WEBSOCKETPP_SSE2_MASKING_
+    named_kernel sse2_k = {"sse2", &frame::word_mask_circ_sse2};
+    kernels.push_back(sse2_k);
+#endif
+#ifdef _WEBSOCKETPP_AVX2_MASKING_
+    if (frame::get_mask_isa() == frame::mask_isa::avx2) {
+        named_kernel avx2_k = {"avx2", &frame::word_mask_circ_avx2};
+        kernels.push_back(avx2_k);
+    }
+#endif
+    named_kernel dispatch_k = {"word_mask_circ",
+        static_cast<mask_kernel>(&frame::word_mask_circ)};
+    kernels.push_back(dispatch_k);
+
+    std::vector<uint8_t> buffer(sizes[sizeof(sizes)/sizeof(sizes[0])-1]+1);
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        buffer[i] = static_cast<uint8_t>(i);
+    }
+
+    std::printf("%-16s","GB/s");
+    for (size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s) {
+        std::printf("%10lu",static_cast<unsigned long>(sizes[s]));
+    }
+    std::printf("\n");
+
+    for (size_t k = 0; k < kernels.size(); ++k) {
+        std::printf("%-16s",kernels[k].name);
+        for (size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s) {
+            // odd offset: payloads rarely start on an aligned address
+            std::printf("%10.2f",run(kernels[k].kernel,&buffer[1],sizes[s]));
+        }
+        std::printf("\n");
+    }
+
+    return 0;
+}
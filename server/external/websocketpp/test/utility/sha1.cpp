@@ -78,4 +78,39 @@ BOOST_AUTO_TEST_CASE( sha1_test_c ) {
     BOOST_CHECK_EQUAL_COLLECTIONS(hash, hash+20, reference, reference+20);
 }
 
+BOOST_AUTO_TEST_CASE( sha1_isa_match ) {
+    // every padding case (0-130 bytes) and a few multi block inputs hash the
+    // same with the portable code and the code calc picks for this CPU
+    std::string input;
+    for (int i = 0; i < 1000; i++) {
+        input += static_cast<char>(i * 131 + 7);
+    }
+
+    for (size_t len = 0; len < input.size(); len += (len < 130 ? 1 : 97)) {
+        unsigned char scalar[20];
+        unsigned char best[20];
+
+        websocketpp::sha1::calc(input.data(),len,scalar,
+            websocketpp::sha1::isa::scalar);
+        websocketpp::sha1::calc(input.data(),len,best,
+            websocketpp::sha1::get_isa());
+
+        BOOST_CHECK_EQUAL_COLLECTIONS(scalar, scalar+20, best, best+20);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( sha1_isa_reference ) {
+    unsigned char hash[20];
+    unsigned char reference[20] = {0xa9, 0x99, 0x3e, 0x36, 0x47,
+                                   0x06, 0x81, 0x6a, 0xba, 0x3e,
+                                   0x25, 0x71, 0x78, 0x50, 0xc2,
+                                   0x6c, 0x9c, 0xd0, 0xd8, 0x9d};
+
+    // requesting the SHA extensions falls back to portable code on CPUs
+    // without them
+    websocketpp::sha1::calc("abc",3,hash,websocketpp::sha1::isa::sha);
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(hash, hash+20, reference, reference+20);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
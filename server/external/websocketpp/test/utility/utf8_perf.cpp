@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2011, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+// UTF-8 validation throughput on JSON text frames. Not part of the test
+// suite; build with optimization, e.g.
+//   g++ -std=c++11 -O2 -I../.. utf8_perf.cpp -o utf8_perf
+
+#include <websocketpp/utf8_validator.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace websocketpp;
+
+typedef bool (*validate_fn)(uint8_t const *, size_t);
+
+// The byte by byte state machine, as every text frame used before
+bool dfa(uint8_t const * data, size_t length) {
+    utf8_validator::validator v;
+    return v.decode(data,data+length) && v.complete();
+}
+
+bool streaming(uint8_t const * data, size_t length) {
+    utf8_validator::validator v;
+    return v.decode_bytes(data,length) && v.complete();
+}
+
+// A push update like the ones the auction server sends
+std::string update(size_t i, bool non_ascii) {
+    char buf[512];
+    std::snprintf(buf,sizeof(buf),
+        "{\"auction\":{\"bid_count\":%lu,\"ends_at\":1792194230943,"
+        "\"high_bid\":\"%lu.00\",\"id\":%lu,\"leader\":\"%s\","
+        "\"min_increment\":\"1.00\",\"reserve_met\":true,\"seller\":\"alice\","
+        "\"starting_price\":\"1.00\",\"starts_at\":1792194170943,"
+        "\"status\":\"open\",\"title\":\"%s\"},\"topic\":\"auction:%lu\","
+        "\"type\":\"auction\"}",
+        static_cast<unsigned long>(i), static_cast<unsigned long>(i+5),
+        static_cast<unsigned long>(i%100),
+        non_ascii ? "Jos\xC3\xA9" : "bob",
+        non_ascii ? "Caf\xC3\xA9 poster \xE2\x82\xAC\xF0\x9F\x8E\xA8" : "Cafe poster",
+        static_cast<unsigned long>(i%100));
+    return buf;
+}
+
+// A JSON array of updates at least size bytes long
+std::string payload(size_t size, bool non_ascii) {
+    std::string s = "[";
+    for (size_t i = 0; s.size() < size; ++i) {
+        if (i) {
+            s += ",";
+        }
+        s += update(i,non_ascii);
+    }
+    return s + "]";
+}
+
+double run(validate_fn fn, std::string const & s) {
+    size_t const total = 256 * 1024 * 1024;
+    size_t iterations = total / s.size() + 1;
+    uint8_t const * data = reinterpret_cast<uint8_t const *>(s.data());
+    size_t valid = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        valid += fn(data,s.size());
+    }
+    std::chrono::nanoseconds taken = std::chrono::steady_clock::now()-start;
+
+    if (valid != iterations) {
+        std::printf("validation failed\n");
+    }
+    return double(iterations * s.size()) / double(taken.count());
+}
+
+int main() {
+    struct named {
+        char const * name;
+        validate_fn fn;
+    };
+    std::vector<named> fns;
+    named dfa_n = {"dfa", &dfa};
+    fns.push_back(dfa_n);
+#ifdef _WEBSOCKETPP_SIMD_UTF8_
+    if (lib::cpu::has_ssse3()) {
+        named n = {"ssse3", &utf8_validator::validate_ssse3};
+        fns.push_back(n);
+    }
+    if (lib::cpu::has_avx2()) {
+        named n = {"avx2", &utf8_validator::validate_avx2};
+        fns.push_back(n);
+    }
+#endif
+    named streaming_n = {"decode_bytes", &streaming};
+    fns.push_back(streaming_n);
+
+    struct input {
+        char const * name;
+        std::string data;
+    };
+    std::vector<input> inputs;
+    input one = {"1 update", update(7,false)};
+    input one_u = {"1 update, UTF-8", update(7,true)};
+    input small = {"4 KiB", payload(4096,false)};
+    input small_u = {"4 KiB, UTF-8", payload(4096,true)};
+    input large = {"256 KiB", payload(256*1024,false)};
+    input large_u = {"256 KiB, UTF-8", payload(256*1024,true)};
+    inputs.push_back(one);
+    inputs.push_back(one_u);
+    inputs.push_back(small);
+    inputs.push_back(small_u);
+    inputs.push_back(large);
+    inputs.push_back(large_u);
+
+    std::printf("%-18s","GB/s");
+    for (size_t f = 0; f < fns.size(); ++f) {
+        std::printf("%14s",fns[f].name);
+    }
+    std::printf("\n");
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        std::printf("%-18s",inputs[i].name);
+        for (size_t f = 0; f < fns.size(); ++f) {
+            std::printf("%14.2f",run(fns[f].fn,inputs[i].data));
+        }
+        std::printf("\n");
+    }
+
+    return 0;
+}
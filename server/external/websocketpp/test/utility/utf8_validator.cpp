@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2014, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE utf8_validator
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <websocketpp/utf8_validator.hpp>
+
+using namespace websocketpp;
+
+// Reference result: the byte by byte state machine over a non-contiguous
+// iterator type
+bool dfa_validate(std::string const & s) {
+    std::vector<char> v(s.begin(),s.end());
+    utf8_validator::validator val;
+    return val.decode(v.begin(),v.end()) && val.complete();
+}
+
+typedef bool (*whole_validator)(uint8_t const *, size_t);
+
+bool streaming_validate(uint8_t const * data, size_t length) {
+    utf8_validator::validator val;
+    return val.decode_bytes(data,length) && val.complete();
+}
+
+// Split the input at every position into two decode_bytes calls
+bool split_validate(std::string const & s, size_t split) {
+    uint8_t const * data = reinterpret_cast<uint8_t const *>(s.data());
+    utf8_validator::validator val;
+    return val.decode_bytes(data,split) &&
+           val.decode_bytes(data+split,s.size()-split) && val.complete();
+}
+
+std::vector<whole_validator> validators() {
+    std::vector<whole_validator> v;
+    v.push_back(&streaming_validate);
+#ifdef _WEBSOCKETPP_SIMD_UTF8_
+    if (lib::cpu::has_ssse3()) {
+        v.push_back(&utf8_validator::validate_ssse3);
+    }
+    if (lib::cpu::has_avx2()) {
+        v.push_back(&utf8_validator::validate_avx2);
+    }
+#endif
+    return v;
+}
+
+// Every validator must agree with the state machine on s, wherever s sits
+// inside a longer ASCII buffer
+void check_embedded(std::string const & s) {
+    std::vector<whole_validator> v = validators();
+    for (size_t pad = 0; pad < 70; ++pad) {
+        std::string input = std::string(pad,'a') + s + std::string(70-pad,'b');
+        bool expected = dfa_validate(input);
+        for (size_t i = 0; i < v.size(); ++i) {
+            BOOST_CHECK_EQUAL( v[i](reinterpret_cast<uint8_t const *>(
+                input.data()),input.size()), expected );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( valid_sequences ) {
+    char const * valid[] = {
+        "",
+        "Hello World",
+        "\xC2\xA9",                 // U+00A9
+        "\xDF\xBF",                 // U+07FF
+        "\xE0\xA0\x80",             // U+0800
+        "\xE2\x82\xAC",             // U+20AC
+        "\xED\x9F\xBF",             // U+D7FF, below the surrogates
+        "\xEE\x80\x80",             // U+E000, above the surrogates
+        "\xEF\xBF\xBF",             // U+FFFF
+        "\xF0\x90\x80\x80",         // U+10000
+        "\xF4\x8F\xBF\xBF",         // U+10FFFF
+        "\xCE\xBA\xE1\xBD\xB9\xCF\x83\xCE\xBC\xCE\xB5"
+    };
+    for (size_t i = 0; i < sizeof(valid)/sizeof(valid[0]); ++i) {
+        BOOST_CHECK( utf8_validator::validate(valid[i]) );
+        check_embedded(valid[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( invalid_sequences ) {
+    char const * invalid[] = {
+        "\x80",                     // lone continuation
+        "\xBF",
+        "\xC2",                     // truncated
+        "\xE2\x82",
+        "\xF0\x90\x80",
+        "\xC2\x41",                 // lead followed by ASCII
+        "\xE2\x41\x82",
+        "\xC2\xC2\xA9",             // lead followed by lead
+        "\xC0\x80",                 // overlong
+        "\xC1\xBF",
+        "\xE0\x80\x80",
+        "\xE0\x9F\xBF",
+        "\xF0\x80\x80\x80",
+        "\xF0\x8F\xBF\xBF",
+        "\xED\xA0\x80",             // surrogates
+        "\xED\xBF\xBF",
+        "\xF4\x90\x80\x80",         // above U+10FFFF
+        "\xF5\x80\x80\x80",
+        "\xF8\x88\x80\x80\x80",
+        "\xFF",
+        "\xC2\xA9\x80",             // extra continuation
+        "\xE2\x82\xAC\xAC",
+        "\xF0\x90\x80\x80\x80"
+    };
+    for (size_t i = 0; i < sizeof(invalid)/sizeof(invalid[0]); ++i) {
+        BOOST_CHECK( !utf8_validator::validate(invalid[i]) );
+        check_embedded(invalid[i]);
+    }
+}
+
+// Random mixes of valid code points and arbitrary bytes
+BOOST_AUTO_TEST_CASE( random_inputs ) {
+    char const * pieces[] = {
+        "{\"type\":\"auction\",\"high_bid\":\"5.00\"}", "\xC3\xA9",
+        "\xE2\x82\xAC", "\xF0\x9F\x98\x80", " ", "\"", "\xED\x9F\xBF"
+    };
+    std::vector<whole_validator> v = validators();
+    std::srand(1);
+
+    for (int round = 0; round < 2000; ++round) {
+        std::string input;
+        size_t count = std::rand() % 40;
+        for (size_t i = 0; i < count; ++i) {
+            input += pieces[std::rand() % (sizeof(pieces)/sizeof(pieces[0]))];
+        }
+        // corrupt some of the inputs
+        if (round % 2 && !input.empty()) {
+            input[std::rand() % input.size()] = static_cast<char>(std::rand());
+        }
+
+        bool expected = dfa_validate(input);
+        BOOST_CHECK_EQUAL( utf8_validator::validate(input), expected );
+        for (size_t i = 0; i < v.size(); ++i) {
+            BOOST_CHECK_EQUAL( v[i](reinterpret_cast<uint8_t const *>(
+                input.data()),input.size()), expected );
+        }
+        size_t split = input.empty() ? 0 : std::rand() % input.size();
+        BOOST_CHECK_EQUAL( split_validate(input,split), expected );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( split_sequences ) {
+    std::string input = std::string(40,'a') + "\xF0\x9F\x98\x80" +
+        std::string(40,'b') + "\xE2\x82\xAC" + std::string(40,'c');
+
+    for (size_t split = 0; split <= input.size(); ++split) {
+        BOOST_CHECK( split_validate(input,split) );
+    }
+
+    input[42] = 'x';
+    for (size_t split = 0; split <= input.size(); ++split) {
+        BOOST_CHECK( !split_validate(input,split) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( reject_is_sticky ) {
+    utf8_validator::validator val;
+    std::string bad = std::string(64,'a') + "\xC0\x80";
+    std::string good(64,'a');
+
+    BOOST_CHECK( !val.decode(bad.begin(),bad.end()) );
+    BOOST_CHECK( !val.decode(good.begin(),good.end()) );
+    BOOST_CHECK( !val.complete() );
+
+    val.reset();
+    BOOST_CHECK( val.decode(good.begin(),good.end()) );
+    BOOST_CHECK( val.complete() );
+}
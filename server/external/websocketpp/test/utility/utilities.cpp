@@ -32,6 +32,7 @@
 #include <string>
 
 #include <websocketpp/utilities.hpp>
+#include <websocketpp/base64/base64.hpp>
 
 BOOST_AUTO_TEST_SUITE ( utility )
 
@@ -70,4 +71,24 @@ BOOST_AUTO_TEST_CASE( string_replace_all ) {
     BOOST_CHECK_EQUAL(string_replace_all(source,"\"","\\\""),dest);
 }
 
+BOOST_AUTO_TEST_CASE( base64_rfc4648_vectors ) {
+    char const * const input[] = {"", "f", "fo", "foo", "foob", "fooba",
+        "foobar"};
+    char const * const output[] = {"", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==",
+        "Zm9vYmE=", "Zm9vYmFy"};
+
+    for (size_t i = 0; i < 7; ++i) {
+        std::string in(input[i]);
+        char buf[8];
+
+        size_t len = websocketpp::base64_encode(
+            reinterpret_cast<unsigned char const *>(in.data()),in.size(),buf);
+
+        BOOST_CHECK_EQUAL( len, websocketpp::base64_encoded_size(in.size()) );
+        BOOST_CHECK_EQUAL( std::string(buf,len), output[i] );
+        BOOST_CHECK_EQUAL( websocketpp::base64_encode(in), output[i] );
+        BOOST_CHECK_EQUAL( websocketpp::base64_decode(output[i]), in );
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -36,6 +36,7 @@
 #ifndef _BASE64_HPP_
 #define _BASE64_HPP_
 
+#include <cstddef>
 #include <string>
 
 namespace websocketpp {
@@ -57,55 +58,64 @@ static inline bool is_base64(unsigned char c) {
            (c >= 97 && c <= 122)); // a-z
 }
 
-/// Encode a char buffer into a base64 string
+/// Length of the base64 encoding of len bytes
+/**
+ * @param len The length of the input in bytes
+ * @return The number of characters base64_encode produces for len bytes
+ */
+inline size_t base64_encoded_size(size_t len) {
+    return (len + 2) / 3 * 4;
+}
+
+/// Encode a char buffer into a caller supplied buffer
 /**
+ * Does not allocate. The output is not null terminated.
+ *
  * @param input The input data
  * @param len The length of input in bytes
- * @return A base64 encoded string representing input
+ * @param output Buffer of at least base64_encoded_size(len) characters
+ * @return The number of characters written to output
  */
-inline std::string base64_encode(unsigned char const * input, size_t len) {
-    std::string ret;
-    int i = 0;
-    int j = 0;
-    unsigned char char_array_3[3];
-    unsigned char char_array_4[4];
-
-    while (len--) {
-        char_array_3[i++] = *(input++);
-        if (i == 3) {
-            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) +
-                              ((char_array_3[1] & 0xf0) >> 4);
-            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) +
-                              ((char_array_3[2] & 0xc0) >> 6);
-            char_array_4[3] = char_array_3[2] & 0x3f;
-
-            for(i = 0; (i <4) ; i++) {
-                ret += base64_chars[char_array_4[i]];
-            }
-            i = 0;
-        }
+inline size_t base64_encode(unsigned char const * input, size_t len,
+    char * output)
+{
+    static char const chars[] =
+             "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+             "abcdefghijklmnopqrstuvwxyz"
+             "0123456789+/";
+
+    char * out = output;
+
+    for (; len >= 3; len -= 3, input += 3) {
+        *out++ = chars[input[0] >> 2];
+        *out++ = chars[((input[0] & 0x03) << 4) | (input[1] >> 4)];
+        *out++ = chars[((input[1] & 0x0f) << 2) | (input[2] >> 6)];
+        *out++ = chars[input[2] & 0x3f];
     }
 
-    if (i) {
-        for(j = i; j < 3; j++) {
-            char_array_3[j] = '\0';
-        }
+    if (len > 0) {
+        unsigned char const second = (len > 1) ? input[1] : 0;
 
-        char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-        char_array_4[1] = ((char_array_3[0] & 0x03) << 4) +
-                          ((char_array_3[1] & 0xf0) >> 4);
-        char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) +
-                          ((char_array_3[2] & 0xc0) >> 6);
-        char_array_4[3] = char_array_3[2] & 0x3f;
+        *out++ = chars[input[0] >> 2];
+        *out++ = chars[((input[0] & 0x03) << 4) | (second >> 4)];
+        *out++ = (len > 1) ? chars[(second & 0x0f) << 2] : '=';
+        *out++ = '=';
+    }
 
-        for (j = 0; (j < i + 1); j++) {
-            ret += base64_chars[char_array_4[j]];
-        }
+    return static_cast<size_t>(out - output);
+}
 
-        while((i++ < 3)) {
-            ret += '=';
-        }
+/// Encode a char buffer into a base64 string
+/**
+ * @param input The input data
+ * @param len The length of input in bytes
+ * @return A base64 encoded string representing input
+ */
+inline std::string base64_encode(unsigned char const * input, size_t len) {
+    std::string ret(base64_encoded_size(len),'\0');
+
+    if (!ret.empty()) {
+        base64_encode(input,len,&ret[0]);
     }
 
     return ret;
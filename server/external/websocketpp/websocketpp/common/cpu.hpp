@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2014, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_COMMON_CPU_HPP
+#define WEBSOCKETPP_COMMON_CPU_HPP
+
+// x86 SIMD support for the vectorized code paths (frame masking, UTF-8
+// validation, SHA-1). SSE2 is part of the x86-64 baseline and is used whenever the
+// compiler targets it. Code for later extensions is compiled per function with
+// the _WEBSOCKETPP_TARGET_*_ attributes and must only be called after checking
+// the matching lib::cpu::has_* function at run time.
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define _WEBSOCKETPP_SSE2_
+    #include <emmintrin.h>
+
+    #if defined(_MSC_VER)
+        #define _WEBSOCKETPP_TARGET_SIMD_
+        #define _WEBSOCKETPP_TARGET_SSSE3_
+        #define _WEBSOCKETPP_TARGET_AVX2_
+        #define _WEBSOCKETPP_TARGET_SHA_
+        #include <intrin.h>
+        #include <immintrin.h>
+    #elif defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || \
+        (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+        #define _WEBSOCKETPP_TARGET_SIMD_
+        #define _WEBSOCKETPP_TARGET_SSSE3_ __attribute__((target("ssse3")))
+        #define _WEBSOCKETPP_TARGET_AVX2_ __attribute__((target("avx2")))
+        #define _WEBSOCKETPP_TARGET_SHA_ \
+            __attribute__((target("sha,sse4.1,ssse3")))
+        #include <cpuid.h>
+        #include <immintrin.h>
+    #endif
+#endif
+
+namespace websocketpp {
+namespace lib {
+namespace cpu {
+
+/// Instruction set extensions detected at run time
+struct features {
+    bool ssse3;
+    bool avx2;
+    /// SHA extensions together with the SSE4.1 and SSSE3 they are used with
+    bool sha;
+};
+
+/// Query the CPU (and, for AVX2, the OS) for supported extensions
+inline features detect_features() {
+    features f;
+    f.ssse3 = false;
+    f.avx2 = false;
+    f.sha = false;
+#if defined(_WEBSOCKETPP_TARGET_SIMD_) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    if (max_leaf >= 1) {
+        __cpuid(info, 1);
+        f.ssse3 = (info[2] & (1 << 9)) != 0;
+        // OSXSAVE and AVX, then check the OS saves the YMM state
+        bool avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+                   (_xgetbv(0) & 0x6) == 0x6;
+        bool sse41 = (info[2] & (1 << 19)) != 0;
+        if (max_leaf >= 7) {
+            __cpuidex(info, 7, 0);
+            f.avx2 = avx && (info[1] & (1 << 5)) != 0;
+            f.sha = f.ssse3 && sse41 && (info[1] & (1 << 29)) != 0;
+        }
+    }
+#elif defined(_WEBSOCKETPP_TARGET_SIMD_)
+    __builtin_cpu_init();
+    f.ssse3 = __builtin_cpu_supports("ssse3") != 0;
+    f.avx2 = __builtin_cpu_supports("avx2") != 0;
+    // older compilers do not know "sha" in __builtin_cpu_supports
+    if (__get_cpuid_max(0, 0) >= 7) {
+        unsigned int eax, ebx, ecx, edx;
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        f.sha = f.ssse3 && __builtin_cpu_supports("sse4.1") &&
+            (ebx & (1u << 29)) != 0;
+    }
+#endif
+    return f;
+}
+
+/// Get the extensions supported by this CPU
+/**
+ * Detected on first use and cached.
+ */
+inline features const & get_features() {
+    static features const f = detect_features();
+    return f;
+}
+
+/// Whether SSSE3 code may be called on this CPU
+inline bool has_ssse3() {
+    return get_features().ssse3;
+}
+
+/// Whether AVX2 code may be called on this CPU
+inline bool has_avx2() {
+    return get_features().avx2;
+}
+
+/// Whether SHA extension code may be called on this CPU
+inline bool has_sha() {
+    return get_features().sha;
+}
+
+} // namespace cpu
+} // namespace lib
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_COMMON_CPU_HPP
@@ -40,8 +40,10 @@
 #include <websocketpp/common/connection_hdl.hpp>
 #include <websocketpp/common/cpp11.hpp>
 #include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/stdint.hpp>
 
-#include <queue>
+#include <deque>
+#include <map>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -173,6 +175,43 @@ typedef lib::function<void(lib::error_code const & ec)> write_frame_handler;
     static std::vector<int> const versions_supported(helper,helper+4);
 #endif
 
+/// Running totals of the transport writes made by one connection
+/**
+ * Each transport write carries every message that was queued when it started,
+ * up to the connection's batch limits, as one gathered write. The ratio of
+ * writes to messages shows how well bursts of small messages are coalesced;
+ * for socket based transports each write is normally a single writev call.
+ */
+struct write_stats {
+    write_stats()
+      : transport_writes(0)
+      , messages_written(0)
+      , bytes_written(0) {}
+
+    /// Transport writes started
+    uint64_t transport_writes;
+    /// Messages (frames) handed to the transport, including control frames
+    uint64_t messages_written;
+    /// Header and payload bytes handed to the transport
+    uint64_t bytes_written;
+
+    /// Transport writes per message written, or 0.0 if nothing was written
+    double writes_per_message() const {
+        if (messages_written == 0) {
+            return 0.0;
+        }
+        return double(transport_writes) / double(messages_written);
+    }
+
+    /// Add the totals from another connection
+    write_stats & operator+=(write_stats const & o) {
+        transport_writes += o.transport_writes;
+        messages_written += o.messages_written;
+        bytes_written += o.bytes_written;
+        return *this;
+    }
+};
+
 namespace session {
 namespace state {
     // externally visible session state (states based on the RFC)
@@ -313,11 +352,16 @@ public:
       , m_close_handshake_timeout_dur(config::timeout_close_handshake)
       , m_pong_timeout_dur(config::timeout_pong)
       , m_max_message_size(config::max_message_size)
+      , m_max_buffered_amount(0)
+      , m_max_write_batch_bytes(0)
+      , m_max_write_batch_messages(0)
       , m_state(session::state::connecting)
       , m_internal_state(session::internal_state::USER_INIT)
       , m_msg_manager(new con_msg_manager_type())
+      , m_conflated_count(0)
       , m_send_buffer_size(0)
       , m_write_flag(false)
+      , m_corked(false)
       , m_read_flag(true)
       , m_is_server(p_is_server)
       , m_alog(alog)
@@ -636,6 +680,176 @@ public:
         return get_buffered_amount();
     }
 
+    /// Get the limit on the outgoing write buffer (in payload bytes)
+    /**
+     * @see set_max_buffered_amount
+     *
+     * @return The current limit, or 0 if unlimited.
+     */
+    size_t get_max_buffered_amount() const {
+        return m_max_buffered_amount;
+    }
+
+    /// Set the limit on the outgoing write buffer (in payload bytes)
+    /**
+     * Bounds the memory a slow reader can hold on the sending side. If a
+     * send would leave more than this many payload bytes queued, the queued
+     * messages are discarded, the send fails with error::send_queue_full and
+     * the connection is closed with status try_again_later. Messages
+     * replaced by conflation do not count, and a single message sent while
+     * nothing else is queued is accepted whatever its size.
+     *
+     * The default is set by the endpoint that creates the connection.
+     *
+     * @param new_value The limit in bytes, or 0 for no limit (the default).
+     */
+    void set_max_buffered_amount(size_t new_value) {
+        m_max_buffered_amount = new_value;
+    }
+
+    /// Get the number of queued messages replaced through conflation
+    /**
+     * This method invokes the m_write_lock mutex
+     *
+     * @return The number of messages discarded because a newer message with
+     * the same conflation key was sent before they were written.
+     */
+    size_t get_conflated_count() const;
+
+    /// Get the limit on bytes per transport write
+    /**
+     * @see set_max_write_batch_bytes
+     *
+     * @return The limit in bytes, or 0 if unlimited.
+     */
+    size_t get_max_write_batch_bytes() const {
+        return m_max_write_batch_bytes;
+    }
+
+    /// Set the limit on bytes per transport write
+    /**
+     * When a transport write starts, every queued message is gathered into
+     * it. This bounds the header and payload bytes gathered so one large
+     * backlog does not hold the transport for a single long write. A message
+     * larger than the limit is still written, on its own.
+     *
+     * The default is set by the endpoint that creates the connection.
+     *
+     * @param new_value The limit in bytes, or 0 for no limit (the default).
+     */
+    void set_max_write_batch_bytes(size_t new_value) {
+        m_max_write_batch_bytes = new_value;
+    }
+
+    /// Get the limit on messages per transport write
+    /**
+     * @see set_max_write_batch_messages
+     *
+     * @return The limit, or 0 if unlimited.
+     */
+    size_t get_max_write_batch_messages() const {
+        return m_max_write_batch_messages;
+    }
+
+    /// Set the limit on messages per transport write
+    /**
+     * Bounds the number of queued messages gathered into one transport
+     * write. Each message adds two buffers to the write, so transports that
+     * split long buffer lists (asio gathers at most 64 buffers per writev
+     * call) gain nothing from batches of more than half that many messages.
+     *
+     * The default is set by the endpoint that creates the connection.
+     *
+     * @param new_value The limit, or 0 for no limit (the default).
+     */
+    void set_max_write_batch_messages(size_t new_value) {
+        m_max_write_batch_messages = new_value;
+    }
+
+    /// Hold outgoing data messages until uncork is called
+    /**
+     * While corked, send() queues messages without starting a transport
+     * write, so a burst of sends made from one handler leaves in a single
+     * gathered write once the burst is over. A write that is already in
+     * progress still picks up queued messages when it completes, and ping,
+     * pong and close frames start a write (carrying the queue) immediately.
+     *
+     * This method invokes the m_write_lock mutex
+     */
+    void cork();
+
+    /// Release a cork and write any queued messages
+    /**
+     * This method invokes the m_write_lock mutex
+     */
+    void uncork();
+
+    /// Whether outgoing data messages are being held by cork()
+    /**
+     * This method invokes the m_write_lock mutex
+     */
+    bool is_corked() const;
+
+    /// Get the transport write totals for this connection
+    /**
+     * This method invokes the m_write_lock mutex
+     *
+     * @return Writes started, messages written and bytes written so far
+     */
+    write_stats get_write_stats() const;
+
+    /// Get the permessage-deflate policy for this connection
+    /**
+     * @see set_permessage_deflate_options
+     *
+     * @return The current policy
+     */
+    extensions::permessage_deflate::options const &
+        get_permessage_deflate_options() const
+    {
+        return m_permessage_deflate_options;
+    }
+
+    /// Set the permessage-deflate policy for this connection
+    /**
+     * Controls the compression threshold, context takeover, window sizes and
+     * zlib levels used if the permessage-deflate extension is negotiated.
+     * Only settings made before the opening handshake is processed take
+     * effect. Has no effect unless the config's permessage_deflate_type is
+     * the enabled extension.
+     *
+     * The default is set by the endpoint that creates the connection.
+     *
+     * @param opts The policy to apply
+     */
+    void set_permessage_deflate_options(
+        extensions::permessage_deflate::options const & opts)
+    {
+        m_permessage_deflate_options = opts;
+        if (m_processor) {
+            m_processor->set_permessage_deflate_options(opts);
+        }
+    }
+
+    /// Get the permessage-deflate compression totals for this connection
+    /**
+     * Reports how many messages were compressed or skipped, the bytes in and
+     * out of zlib and the time spent there. Totals from connections of the
+     * same kind can be summed to judge whether compression pays for them.
+     *
+     * This method is not synchronized with the connection's handlers and
+     * should be called from one of them, e.g. the close handler.
+     *
+     * @return The totals, all zero if permessage-deflate is not in use
+     */
+    extensions::permessage_deflate::stats get_permessage_deflate_stats() const
+    {
+        if (!m_processor) {
+            return extensions::permessage_deflate::stats();
+        }
+        return m_processor->get_permessage_deflate_stats();
+    }
+
     ////////////////////
     // Action Methods //
     ////////////////////
@@ -687,6 +901,41 @@ public:
      */
     lib::error_code send(message_ptr msg);
 
+    /// Add a message to the outgoing send queue, replacing a stale one
+    /**
+     * As send(msg), but if a message sent with the same conflation key is
+     * still waiting in the queue it is replaced by this one, which takes
+     * its place in line. Use this for streams where only the latest value
+     * matters (prices, positions) so a slow reader gets fewer, fresher
+     * messages instead of an ever-growing backlog.
+     *
+     * Only complete, uncompressed frames are conflated; a message compressed
+     * with a shared deflate context cannot be dropped without corrupting
+     * the stream, so such messages are always queued. Messages that are
+     * already being written are never replaced.
+     *
+     * This method invokes the m_write_lock mutex
+     *
+     * @param msg A message_ptr to the message to send.
+     *
+     * @param conflation_key Identifies messages that supersede each other.
+     * An empty key disables conflation for this message.
+     */
+    lib::error_code send(message_ptr msg, std::string const & conflation_key);
+
+    /// Send a payload, replacing a stale queued message with the same key
+    /**
+     * Convenience form of send(msg, conflation_key).
+     *
+     * @param payload The payload string to generated the message with
+     *
+     * @param op The opcode to generated the message with.
+     *
+     * @param conflation_key Identifies messages that supersede each other.
+     */
+    lib::error_code send(std::string const & payload, frame::opcode::value op,
+        std::string const & conflation_key);
+
     /// Asyncronously invoke handler::on_inturrupt
     /**
      * Signals to the connection to asyncronously invoke the on_inturrupt
@@ -1442,6 +1691,33 @@ private:
      */
     void write_push(message_ptr msg);
 
+    /// Add a message to the write queue, replacing a queued message with the
+    /// same conflation key if both frames allow it
+    /**
+     * Lock: m_write_lock
+     *
+     * @return true if the message replaced a queued one
+     */
+    bool write_push(message_ptr msg, std::string const & conflation_key);
+
+    /// Discard every queued message (after the buffered amount limit is hit)
+    /**
+     * Lock: m_write_lock
+     */
+    void write_clear();
+
+    /// Whether the queue has grown past m_max_buffered_amount
+    /**
+     * A message that finds nothing else queued is always accepted, so one
+     * frame larger than the limit does not close an idle connection.
+     *
+     * Lock: m_write_lock
+     */
+    bool write_overflowed() const;
+
+    /// Whether a prepared frame may be replaced by a newer one
+    static bool conflatable_frame(message_ptr const & msg);
+
     /// Pop a message from the write queue
     /**
      * Removes and returns a message from the write queue and updates any
@@ -1516,6 +1792,10 @@ private:
     long                    m_close_handshake_timeout_dur;
     long                    m_pong_timeout_dur;
     size_t                  m_max_message_size;
+    size_t                  m_max_buffered_amount;
+    size_t                  m_max_write_batch_bytes;
+    size_t                  m_max_write_batch_messages;
+    extensions::permessage_deflate::options m_permessage_deflate_options;
 
     /// External connection state
     /**
@@ -1561,11 +1841,29 @@ private:
      */
     processor_ptr           m_processor;
 
+    /// An unsent outgoing message and its conflation key (empty if none)
+    typedef std::pair<message_ptr,std::string> queued_message;
+
     /// Queue of unsent outgoing messages
     /**
      * Lock: m_write_lock
      */
-    std::queue<message_ptr> m_send_queue;
+    std::deque<queued_message> m_send_queue;
+
+    /// Queue slot of the newest message for each conflation key
+    /**
+     * Points into m_send_queue; deque elements do not move when the queue
+     * grows at the back or shrinks at the front.
+     *
+     * Lock: m_write_lock
+     */
+    std::map<std::string,queued_message *> m_conflation_slots;
+
+    /// Number of queued messages replaced through conflation
+    /**
+     * Lock: m_write_lock
+     */
+    size_t m_conflated_count;
 
     /// Size in bytes of the outstanding payloads in the write queue
     /**
@@ -1589,6 +1887,18 @@ private:
      */
     bool m_write_flag;
 
+    /// True if send() should queue without starting a transport write
+    /**
+     * Lock m_write_lock
+     */
+    bool m_corked;
+
+    /// Transport write totals
+    /**
+     * Lock m_write_lock
+     */
+    write_stats m_write_stats;
+
     /// True if this connection is presently reading new data
     bool m_read_flag;
 
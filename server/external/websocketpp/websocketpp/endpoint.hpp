@@ -32,6 +32,7 @@
 
 #include <websocketpp/logger/levels.hpp>
 #include <websocketpp/version.hpp>
+#include <websocketpp/utf8_validator.hpp>
 
 #include <string>
 
@@ -96,6 +97,9 @@ public:
       , m_close_handshake_timeout_dur(config::timeout_close_handshake)
       , m_pong_timeout_dur(config::timeout_pong)
       , m_max_message_size(config::max_message_size)
+      , m_max_buffered_amount(0)
+      , m_max_write_batch_bytes(0)
+      , m_max_write_batch_messages(0)
       , m_max_http_body_size(config::max_http_body_size)
       , m_is_server(p_is_server)
     {
@@ -143,7 +147,11 @@ public:
          , m_close_handshake_timeout_dur(o.m_close_handshake_timeout_dur)
          , m_pong_timeout_dur(o.m_pong_timeout_dur)
          , m_max_message_size(o.m_max_message_size)
+         , m_max_buffered_amount(o.m_max_buffered_amount)
+         , m_max_write_batch_bytes(o.m_max_write_batch_bytes)
+         , m_max_write_batch_messages(o.m_max_write_batch_messages)
          , m_max_http_body_size(o.m_max_http_body_size)
+         , m_permessage_deflate_options(o.m_permessage_deflate_options)
 
          , m_rng(std::move(o.m_rng))
          , m_is_server(o.m_is_server)         
@@ -433,6 +441,109 @@ public:
         m_max_message_size = new_value;
     }
 
+    /// Get default limit on each connection's outgoing write buffer
+    /**
+     * @see connection::set_max_buffered_amount
+     *
+     * @return The limit in payload bytes, or 0 if unlimited.
+     */
+    size_t get_max_buffered_amount() const {
+        return m_max_buffered_amount;
+    }
+
+    /// Set default limit on each connection's outgoing write buffer
+    /**
+     * Set the limit on queued outgoing payload bytes that will be used for
+     * new connections created by this endpoint. A connection whose queue
+     * grows past it is closed. See connection::set_max_buffered_amount.
+     *
+     * The default is 0 (unlimited).
+     *
+     * @param new_value The limit in payload bytes, or 0 for no limit.
+     */
+    void set_max_buffered_amount(size_t new_value) {
+        m_max_buffered_amount = new_value;
+    }
+
+    /// Get default limit on bytes per transport write
+    /**
+     * @see connection::set_max_write_batch_bytes
+     *
+     * @return The limit in bytes, or 0 if unlimited.
+     */
+    size_t get_max_write_batch_bytes() const {
+        return m_max_write_batch_bytes;
+    }
+
+    /// Set default limit on bytes per transport write
+    /**
+     * Set the limit on header and payload bytes gathered into one transport
+     * write that will be used for new connections created by this endpoint.
+     * See connection::set_max_write_batch_bytes.
+     *
+     * The default is 0 (unlimited).
+     *
+     * @param new_value The limit in bytes, or 0 for no limit.
+     */
+    void set_max_write_batch_bytes(size_t new_value) {
+        m_max_write_batch_bytes = new_value;
+    }
+
+    /// Get default limit on messages per transport write
+    /**
+     * @see connection::set_max_write_batch_messages
+     *
+     * @return The limit, or 0 if unlimited.
+     */
+    size_t get_max_write_batch_messages() const {
+        return m_max_write_batch_messages;
+    }
+
+    /// Set default limit on messages per transport write
+    /**
+     * Set the limit on queued messages gathered into one transport write
+     * that will be used for new connections created by this endpoint. See
+     * connection::set_max_write_batch_messages.
+     *
+     * The default is 0 (unlimited).
+     *
+     * @param new_value The limit, or 0 for no limit.
+     */
+    void set_max_write_batch_messages(size_t new_value) {
+        m_max_write_batch_messages = new_value;
+    }
+
+    /// Get default permessage-deflate policy for new connections
+    /**
+     * @see connection::set_permessage_deflate_options
+     *
+     * @return The policy
+     */
+    extensions::permessage_deflate::options const &
+        get_permessage_deflate_options() const
+    {
+        return m_permessage_deflate_options;
+    }
+
+    /// Set default permessage-deflate policy for new connections
+    /**
+     * Set the compression threshold, context takeover, window size and zlib
+     * settings used by connections created by this endpoint if they
+     * negotiate permessage-deflate. See
+     * connection::set_permessage_deflate_options.
+     *
+     * For servers with many connections, enabling server_no_context_takeover
+     * and limiting client_max_window_bits bounds the zlib memory held by
+     * each connection.
+     *
+     * @param opts The policy to apply
+     */
+    void set_permessage_deflate_options(
+        extensions::permessage_deflate::options const & opts)
+    {
+        m_permessage_deflate_options = opts;
+    }
+
     /// Get maximum HTTP message body size
     /**
      * Get maximum HTTP message body size. Maximum message body size determines
@@ -579,6 +690,41 @@ public:
     void send(connection_hdl hdl, message_ptr msg, lib::error_code & ec);
     void send(connection_hdl hdl, message_ptr msg);
 
+    /// Build a pre-framed message for sending to many connections (exception free)
+    /**
+     * Validates and frames the payload once, producing an immutable message
+     * that can be passed to `send(hdl, msg)` for any number of connections.
+     * Each connection queues the same message by reference instead of
+     * copying, validating and framing the payload again, so broadcasting to
+     * N connections costs one encode plus N queue operations.
+     *
+     * Server frames are never masked, so one frame is valid for every
+     * connection that uses RFC6455 framing (hybi07 and later). The message
+     * is not compressed even on connections that negotiated
+     * permessage-deflate. Connections using the legacy hybi00 draft have a
+     * different framing and must be sent the payload with `send(hdl,
+     * payload, op)` instead.
+     *
+     * The returned message must not be modified after it is first sent.
+     *
+     * @param [in] payload The message payload
+     * @param [in] op The opcode of the message (text or binary)
+     * @param [out] ec A code to fill in for errors
+     * @return The prepared message, or an empty pointer on error
+     */
+    message_ptr prepare_broadcast(std::string const & payload,
+        frame::opcode::value op, lib::error_code & ec);
+    /// Build a pre-framed message for sending to many connections
+    /**
+     * Exception variant of `prepare_broadcast`
+     *
+     * @param [in] payload The message payload
+     * @param [in] op The opcode of the message (text or binary)
+     * @return The prepared message
+     */
+    message_ptr prepare_broadcast(std::string const & payload,
+        frame::opcode::value op);
+
     void close(connection_hdl hdl, close::status::value const code,
         std::string const & reason, lib::error_code & ec);
     void close(connection_hdl hdl, close::status::value const code,
@@ -682,7 +828,11 @@ private:
     long                        m_close_handshake_timeout_dur;
     long                        m_pong_timeout_dur;
     size_t                      m_max_message_size;
+    size_t                      m_max_buffered_amount;
+    size_t                      m_max_write_batch_bytes;
+    size_t                      m_max_write_batch_messages;
     size_t                      m_max_http_body_size;
+    extensions::permessage_deflate::options m_permessage_deflate_options;
 
     rng_type m_rng;
 
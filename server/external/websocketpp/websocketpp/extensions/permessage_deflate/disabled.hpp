@@ -34,6 +34,7 @@
 
 #include <websocketpp/http/constants.hpp>
 #include <websocketpp/extensions/extension.hpp>
+#include <websocketpp/extensions/permessage_deflate/options.hpp>
 
 #include <map>
 #include <string>
@@ -89,6 +90,31 @@ public:
         return false;
     }
 
+    /// Apply a local permessage-deflate policy
+    /**
+     * The disabled extension has nothing to configure, so this is a no-op.
+     *
+     * @param opts The policy to apply
+     * @return A status code, always 0
+     */
+    lib::error_code set_options(options const &) {
+        return lib::error_code();
+    }
+
+    /// Get this connection's compression totals, which are always zero
+    stats get_stats() const {
+        return stats();
+    }
+
+    /// Decide whether an outgoing message should be compressed
+    /**
+     * @param size Payload size of the message
+     * @return Always false
+     */
+    bool should_compress(size_t) const {
+        return false;
+    }
+
     /// Generate extension offer
     /**
      * Creates an offer string to include in the Sec-WebSocket-Extensions
@@ -29,6 +29,7 @@
 #define WEBSOCKETPP_PROCESSOR_EXTENSION_PERMESSAGEDEFLATE_HPP
 
 
+#include <websocketpp/common/chrono.hpp>
 #include <websocketpp/common/cpp11.hpp>
 #include <websocketpp/common/memory.hpp>
 #include <websocketpp/common/platforms.hpp>
@@ -37,13 +38,25 @@
 #include <websocketpp/error.hpp>
 
 #include <websocketpp/extensions/extension.hpp>
+#include <websocketpp/extensions/permessage_deflate/options.hpp>
 
 #include "zlib.h"
 
 #include <algorithm>
+#include <limits>
+#include <sstream>
 #include <string>
 #include <vector>
 
+// Connections that reset their compression context after every message share
+// one zlib compression stream per thread. This needs thread_local, so older
+// compilers keep a stream per connection. Define
+// _WEBSOCKETPP_NO_SHARED_DEFLATE_ to always use per connection streams.
+#if defined(_WEBSOCKETPP_CPP11_INTERNAL_) && \
+    !defined(_WEBSOCKETPP_NO_SHARED_DEFLATE_)
+    #define _WEBSOCKETPP_SHARED_DEFLATE_
+#endif
+
 namespace websocketpp {
 namespace extensions {
 
@@ -113,6 +126,9 @@ enum value {
 
     /// Uninitialized
     uninitialized,
+
+    /// Invalid compression level or memory level
+    invalid_options
 };
 
 /// Permessage-deflate error category
@@ -142,6 +158,8 @@ public:
                 return "A zlib function returned an error";
             case uninitialized:
                 return "Deflate extension must be initialized before use";
+            case invalid_options:
+                return "Invalid permessage-deflate compression options";
             default:
                 return "Unknown permessage-compress error";
         }
@@ -201,118 +219,270 @@ static uint8_t const min_client_max_window_bits = 8;
 /// Maximum value for client_max_window_bits as defined by RFC 7692
 static uint8_t const max_client_max_window_bits = 15;
 
-namespace mode {
-enum value {
-    /// Accept any value the remote endpoint offers
-    accept = 1,
-    /// Decline any value the remote endpoint offers. Insist on defaults.
-    decline,
-    /// Use the largest value common to both offers
-    largest,
-    /// Use the smallest value common to both offers
-    smallest
-};
-} // namespace mode
-
-template <typename config>
-class enabled {
+/// A zlib stream producing raw deflate data
+/**
+ * The zlib state is allocated by the first call to init, so a connection that
+ * never sends a message large enough to compress never pays for it.
+ */
+class deflate_stream {
 public:
-    enabled()
-      : m_enabled(false)
-      , m_server_no_context_takeover(false)
-      , m_client_no_context_takeover(false)
-      , m_server_max_window_bits(15)
-      , m_client_max_window_bits(15)
-      , m_server_max_window_bits_mode(mode::accept)
-      , m_client_max_window_bits_mode(mode::accept)
-      , m_initialized(false)
-      , m_compress_buffer_size(8192)
+    deflate_stream()
+      : m_initialized(false)
+      , m_window_bits(0)
+      , m_level(0)
+      , m_memory_level(0)
     {
-        m_dstate.zalloc = Z_NULL;
-        m_dstate.zfree = Z_NULL;
-        m_dstate.opaque = Z_NULL;
+        m_state.zalloc = Z_NULL;
+        m_state.zfree = Z_NULL;
+        m_state.opaque = Z_NULL;
+    }
 
-        m_istate.zalloc = Z_NULL;
-        m_istate.zfree = Z_NULL;
-        m_istate.opaque = Z_NULL;
-        m_istate.avail_in = 0;
-        m_istate.next_in = Z_NULL;
+    ~deflate_stream() {
+        if (m_initialized) {
+            deflateEnd(&m_state);
+        }
     }
 
-    ~enabled() {
-        if (!m_initialized) {
-            return;
+    /// Set up the stream unless it already uses these parameters
+    /**
+     * @param window_bits Base 2 logarithm of the LZ77 window size
+     * @param level zlib compression level
+     * @param memory_level zlib memory level
+     * @return A code representing the error that occurred, if any
+     */
+    lib::error_code init(int window_bits, int level, int memory_level) {
+        if (m_initialized) {
+            if (window_bits == m_window_bits && level == m_level &&
+                memory_level == m_memory_level)
+            {
+                return lib::error_code();
+            }
+            deflateEnd(&m_state);
+            m_initialized = false;
         }
 
-        int ret = deflateEnd(&m_dstate);
+        int ret = deflateInit2(
+            &m_state,
+            level,
+            Z_DEFLATED,
+            -1*window_bits,
+            memory_level,
+            Z_DEFAULT_STRATEGY
+        );
 
         if (ret != Z_OK) {
-            //std::cout << "error cleaning up zlib compression state"
-            //          << std::endl;
+            return make_error_code(error::zlib_error);
         }
 
-        ret = inflateEnd(&m_istate);
+        m_initialized = true;
+        m_window_bits = window_bits;
+        m_level = level;
+        m_memory_level = memory_level;
+        return lib::error_code();
+    }
 
-        if (ret != Z_OK) {
-            //std::cout << "error cleaning up zlib decompression state"
-            //          << std::endl;
-        }
+    /// Discard the LZ77 window so the next message starts a fresh context
+    void reset() {
+        deflateReset(&m_state);
     }
 
-    /// Initialize zlib state
+    /// Compress a message and append it to out, ending with a sync flush
     /**
-     * Note: this should be called *after* the negotiation methods. It will use
-     * information from the negotiation to determine how to initialize the zlib
-     * data structures.
-     *
-     * @todo memory level, strategy, etc are hardcoded
+     * Output is written straight into `out`, sized up front from
+     * deflateBound so a message normally needs a single pass.
      *
-     * @param is_server True to initialize as a server, false for a client.
+     * @param [in] buf Bytes to compress
+     * @param [in] len Length of buf
+     * @param [out] out String to append compressed bytes to
      * @return A code representing the error that occurred, if any
      */
-    lib::error_code init(bool is_server) {
-        uint8_t deflate_bits;
-        uint8_t inflate_bits;
+    lib::error_code compress(uint8_t const * buf, size_t len,
+        std::string & out)
+    {
+        size_t const max_chunk = (std::numeric_limits<uInt>::max)();
+        size_t const start = out.size();
+        size_t used = start;
+        size_t room = std::min<size_t>(max_chunk,
+            deflateBound(&m_state, uLong(std::min(len, max_chunk))) + 16);
 
-        if (is_server) {
-            deflate_bits = m_server_max_window_bits;
-            inflate_bits = m_client_max_window_bits;
-        } else {
-            deflate_bits = m_client_max_window_bits;
-            inflate_bits = m_server_max_window_bits;
-        }
+        m_state.next_in = const_cast<unsigned char *>(buf);
 
-        int ret = deflateInit2(
-            &m_dstate,
-            Z_DEFAULT_COMPRESSION,
-            Z_DEFLATED,
-            -1*deflate_bits,
-            4, // memory level 1-9
-            Z_DEFAULT_STRATEGY
-        );
+        size_t remaining = len;
+        do {
+            size_t chunk = std::min(remaining, max_chunk);
+            remaining -= chunk;
+            m_state.avail_in = uInt(chunk);
+
+            int flush = (remaining == 0 ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+            do {
+                out.resize(used + room);
+                m_state.next_out = reinterpret_cast<unsigned char *>(&out[used]);
+                m_state.avail_out = uInt(room);
+
+                if (deflate(&m_state, flush) == Z_STREAM_ERROR) {
+                    out.resize(start);
+                    return make_error_code(error::zlib_error);
+                }
+
+                used += room - m_state.avail_out;
+                room = std::max<size_t>(room, 1024);
+            } while (m_state.avail_out == 0);
+        } while (remaining > 0);
+
+        out.resize(used);
+        return lib::error_code();
+    }
+private:
+    bool m_initialized;
+    int m_window_bits;
+    int m_level;
+    int m_memory_level;
+    z_stream m_state;
+};
 
-        if (ret != Z_OK) {
-            return make_error_code(error::zlib_error);
+/// A zlib stream consuming raw deflate data
+/**
+ * Like deflate_stream the zlib state is allocated on first use.
+ */
+class inflate_stream {
+public:
+    inflate_stream() : m_initialized(false) {
+        m_state.zalloc = Z_NULL;
+        m_state.zfree = Z_NULL;
+        m_state.opaque = Z_NULL;
+        m_state.avail_in = 0;
+        m_state.next_in = Z_NULL;
+    }
+
+    ~inflate_stream() {
+        if (m_initialized) {
+            inflateEnd(&m_state);
         }
+    }
 
-        ret = inflateInit2(
-            &m_istate,
-            -1*inflate_bits
-        );
+    /// Set up the stream if it hasn't been already
+    /**
+     * @param window_bits Base 2 logarithm of the LZ77 window size
+     * @return A code representing the error that occurred, if any
+     */
+    lib::error_code init(int window_bits) {
+        if (m_initialized) {
+            return lib::error_code();
+        }
 
-        if (ret != Z_OK) {
+        if (inflateInit2(&m_state, -1*window_bits) != Z_OK) {
             return make_error_code(error::zlib_error);
         }
 
-        m_compress_buffer.reset(new unsigned char[m_compress_buffer_size]);
-        m_decompress_buffer.reset(new unsigned char[m_compress_buffer_size]);
-        if ((m_server_no_context_takeover && is_server) ||
-            (m_client_no_context_takeover && !is_server))
-        {
-            m_flush = Z_FULL_FLUSH;
+        m_initialized = true;
+        return lib::error_code();
+    }
+
+    /// Decompress bytes and append them to out
+    /**
+     * @param [in] buf Bytes to decompress
+     * @param [in] len Length of buf
+     * @param [out] out String to append decompressed bytes to
+     * @return A code representing the error that occurred, if any
+     */
+    lib::error_code decompress(uint8_t const * buf, size_t len,
+        std::string & out)
+    {
+        size_t const max_chunk = (std::numeric_limits<uInt>::max)();
+        size_t used = out.size();
+        size_t room = std::min<size_t>(max_chunk,
+            std::max<size_t>(len * 3, 256));
+
+        m_state.next_in = const_cast<unsigned char *>(buf);
+
+        size_t remaining = len;
+        do {
+            size_t chunk = std::min(remaining, max_chunk);
+            remaining -= chunk;
+            m_state.avail_in = uInt(chunk);
+
+            do {
+                out.resize(used + room);
+                m_state.next_out = reinterpret_cast<unsigned char *>(&out[used]);
+                m_state.avail_out = uInt(room);
+
+                int ret = inflate(&m_state, Z_SYNC_FLUSH);
+
+                used += room - m_state.avail_out;
+
+                if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR ||
+                    ret == Z_MEM_ERROR || ret == Z_STREAM_ERROR)
+                {
+                    out.resize(used);
+                    return make_error_code(error::zlib_error);
+                }
+
+                room = std::min<size_t>(max_chunk, room * 2);
+            } while (m_state.avail_out == 0);
+        } while (remaining > 0);
+
+        out.resize(used);
+        return lib::error_code();
+    }
+private:
+    bool m_initialized;
+    z_stream m_state;
+};
+
+#ifdef _WEBSOCKETPP_SHARED_DEFLATE_
+/// Get the calling thread's compression stream for a window size
+/**
+ * A connection that resets its compression context after every message keeps
+ * nothing in its compressor between messages, so every such connection on a
+ * thread can borrow the same stream and reset it before use. There is one
+ * stream per window size; a stream is re-initialized if a connection asks
+ * for a different compression level or memory level.
+ *
+ * @param window_bits Base 2 logarithm of the LZ77 window size (9-15)
+ * @return The thread's stream for that window size
+ */
+inline deflate_stream & get_shared_deflate_stream(uint8_t window_bits) {
+    static thread_local deflate_stream streams[max_server_max_window_bits - 8];
+    return streams[window_bits - 9];
+}
+#endif // _WEBSOCKETPP_SHARED_DEFLATE_
+
+template <typename config>
+class enabled {
+public:
+    enabled()
+      : m_enabled(false)
+      , m_server_no_context_takeover(false)
+      , m_client_no_context_takeover(false)
+      , m_server_max_window_bits(15)
+      , m_client_max_window_bits(15)
+      , m_initialized(false)
+      , m_deflate_bits(15)
+      , m_inflate_bits(15)
+      , m_reset_deflate(false)
+    {}
+
+    /// Initialize compression state
+    /**
+     * Note: this should be called *after* the negotiation methods. It will use
+     * information from the negotiation to determine how to set up the zlib
+     * streams. The streams themselves are allocated the first time a message
+     * is compressed or decompressed.
+     *
+     * @param is_server True to initialize as a server, false for a client.
+     * @return A code representing the error that occurred, if any
+     */
+    lib::error_code init(bool is_server) {
+        if (is_server) {
+            m_deflate_bits = m_server_max_window_bits;
+            m_inflate_bits = m_client_max_window_bits;
+            m_reset_deflate = m_server_no_context_takeover;
         } else {
-            m_flush = Z_SYNC_FLUSH;
+            m_deflate_bits = m_client_max_window_bits;
+            m_inflate_bits = m_server_max_window_bits;
+            m_reset_deflate = m_client_no_context_takeover;
         }
+
         m_initialized = true;
         return lib::error_code();
     }
@@ -338,6 +508,75 @@ public:
         return m_enabled;
     }
 
+    /// Apply a local permessage-deflate policy
+    /**
+     * Replaces all locally configured settings at once. The settings made by
+     * enable_server_no_context_takeover, set_server_max_window_bits and
+     * friends are part of the same policy. Negotiation starts from this
+     * policy for every offer, so an offer that fails part way through does
+     * not leak settings into the next one.
+     *
+     * @param opts The policy to apply
+     * @return A status code, invalid_max_window_bits or invalid_options if
+     * a value is out of range
+     */
+    lib::error_code set_options(options const & opts) {
+        if (opts.server_max_window_bits < min_server_max_window_bits ||
+            opts.server_max_window_bits > max_server_max_window_bits ||
+            opts.client_max_window_bits < min_client_max_window_bits ||
+            opts.client_max_window_bits > max_client_max_window_bits)
+        {
+            return make_error_code(error::invalid_max_window_bits);
+        }
+
+        if (opts.compression_level < Z_DEFAULT_COMPRESSION ||
+            opts.compression_level > Z_BEST_COMPRESSION ||
+            opts.memory_level < 1 || opts.memory_level > MAX_MEM_LEVEL)
+        {
+            return make_error_code(error::invalid_options);
+        }
+
+        m_options = opts;
+
+        // See note in set_server_max_window_bits about 8 bit windows
+        if (m_options.server_max_window_bits == 8) {
+            m_options.server_max_window_bits = 9;
+        }
+        if (m_options.client_max_window_bits == 8) {
+            m_options.client_max_window_bits = 9;
+        }
+
+        apply_options();
+        return lib::error_code();
+    }
+
+    /// Get the local permessage-deflate policy
+    options const & get_options() const {
+        return m_options;
+    }
+
+    /// Get this connection's compression totals
+    stats const & get_stats() const {
+        return m_stats;
+    }
+
+    /// Decide whether an outgoing message should be compressed
+    /**
+     * Messages shorter than the configured compression_threshold are sent
+     * uncompressed and counted in the skipped total. RFC 7692 allows the
+     * sender to choose per message; the receiver uses the RSV1 bit to tell.
+     *
+     * @param size Payload size of the message
+     * @return Whether to compress the message
+     */
+    bool should_compress(size_t size) {
+        if (size < m_options.compression_threshold) {
+            ++m_stats.messages_skipped;
+            return false;
+        }
+        return true;
+    }
+
     /// Reset server's outgoing LZ77 sliding window for each new message
     /**
      * Enabling this setting will cause the server's compressor to reset the
@@ -347,8 +586,10 @@ public:
      * efficiency for large messages somewhat and small messages drastically.
      *
      * This option may reduce server compressor memory usage and client
-     * decompressor memory usage.
-     * @todo Document to what extent memory usage will be reduced
+     * decompressor memory usage. When thread_local is available servers go
+     * further and share one compressor per thread between all connections
+     * using this option, so these connections hold no compressor state of
+     * their own.
      *
      * For clients, this option is dependent on server support. Enabling it
      * via this method does not guarantee that it will be successfully
@@ -360,6 +601,7 @@ public:
      * are able.
      */
     void enable_server_no_context_takeover() {
+        m_options.server_no_context_takeover = true;
         m_server_no_context_takeover = true;
     }
 
@@ -379,6 +621,7 @@ public:
      * it via either endpoint should be sufficient to ensure it is used.
      */
     void enable_client_no_context_takeover() {
+        m_options.client_no_context_takeover = true;
         m_client_no_context_takeover = true;
     }
 
@@ -422,8 +665,9 @@ public:
             bits = 9;
         }
 
+        m_options.server_max_window_bits = bits;
+        m_options.server_max_window_bits_mode = mode;
         m_server_max_window_bits = bits;
-        m_server_max_window_bits_mode = mode;
 
         return lib::error_code();
     }
@@ -443,7 +687,9 @@ public:
      *
      * This setting is dependent on client support. A client may limit its own
      * outgoing window size unilaterally. A server may only limit the client's
-     * window size if the remote client supports that feature.
+     * window size if the remote client supports that feature, which it signals
+     * by including client_max_window_bits in its offer. Offers without it
+     * are answered without a client window limit.
      *
      * NOTE: The permessage-deflate spec specifies that a value of 8 is allowed.
      * Prior to version 0.8.0 a value of 8 was also allowed by this library.
@@ -467,8 +713,9 @@ public:
             bits = 9;
         }
 
+        m_options.client_max_window_bits = bits;
+        m_options.client_max_window_bits_mode = mode;
         m_client_max_window_bits = bits;
-        m_client_max_window_bits_mode = mode;
 
         return lib::error_code();
     }
@@ -509,6 +756,10 @@ public:
     err_str_pair negotiate(http::attribute_list const & offer) {
         err_str_pair ret;
 
+        apply_options();
+
+        bool client_window_offered = false;
+
         http::attribute_list::const_iterator it;
         for (it = offer.begin(); it != offer.end(); ++it) {
             if (it->first == "server_no_context_takeover") {
@@ -519,6 +770,7 @@ public:
                 negotiate_server_max_window_bits(it->second,ret.first);
             } else if (it->first == "client_max_window_bits") {
                 negotiate_client_max_window_bits(it->second,ret.first);
+                client_window_offered = true;
             } else {
                 ret.first = make_error_code(error::invalid_attributes);
             }
@@ -528,6 +780,13 @@ public:
             }
         }
 
+        // A client that did not offer client_max_window_bits may not be able
+        // to limit its window, so we can neither ask it to nor inflate its
+        // messages with anything but the default window.
+        if (!client_window_offered) {
+            m_client_max_window_bits = default_client_max_window_bits;
+        }
+
         if (ret.first == lib::error_code()) {
             m_enabled = true;
             ret.second = generate_response();
@@ -538,8 +797,9 @@ public:
 
     /// Compress bytes
     /**
-     * @todo: avail_in/out is 32 bit, need to fix for cases of >32 bit frames
-     * on 64 bit machines.
+     * Connections that reset their context after each message compress with
+     * the calling thread's shared stream when available, others with their
+     * own stream, created on first use.
      *
      * @param [in] in String to compress
      * @param [out] out String to append compressed bytes to
@@ -550,28 +810,42 @@ public:
             return make_error_code(error::uninitialized);
         }
 
-        size_t output;
-
         if (in.empty()) {
             uint8_t buf[6] = {0x02, 0x00, 0x00, 0x00, 0xff, 0xff};
             out.append((char *)(buf),6);
             return lib::error_code();
         }
 
-        m_dstate.avail_in = in.size();
-        m_dstate.next_in = (unsigned char *)(const_cast<char *>(in.data()));
+        time_point start = now();
 
-        do {
-            // Output to local buffer
-            m_dstate.avail_out = m_compress_buffer_size;
-            m_dstate.next_out = m_compress_buffer.get();
+        deflate_stream * stream = &m_deflate;
+#ifdef _WEBSOCKETPP_SHARED_DEFLATE_
+        if (m_reset_deflate) {
+            stream = &get_shared_deflate_stream(m_deflate_bits);
+        }
+#endif
 
-            deflate(&m_dstate, m_flush);
+        lib::error_code ec = stream->init(m_deflate_bits,
+            m_options.compression_level, m_options.memory_level);
+        if (ec) {
+            return ec;
+        }
+
+        if (m_reset_deflate) {
+            stream->reset();
+        }
 
-            output = m_compress_buffer_size - m_dstate.avail_out;
+        size_t const before = out.size();
+        ec = stream->compress(
+            reinterpret_cast<uint8_t const *>(in.data()), in.size(), out);
+        if (ec) {
+            return ec;
+        }
 
-            out.append((char *)(m_compress_buffer.get()),output);
-        } while (m_dstate.avail_out == 0);
+        ++m_stats.messages_compressed;
+        m_stats.compress_bytes_in += in.size();
+        m_stats.compress_bytes_out += out.size() - before;
+        m_stats.compress_ns += elapsed_ns(start);
 
         return lib::error_code();
     }
@@ -590,30 +864,64 @@ public:
             return make_error_code(error::uninitialized);
         }
 
-        int ret;
-
-        m_istate.avail_in = len;
-        m_istate.next_in = const_cast<unsigned char *>(buf);
+        time_point start = now();
 
-        do {
-            m_istate.avail_out = m_compress_buffer_size;
-            m_istate.next_out = m_decompress_buffer.get();
-
-            ret = inflate(&m_istate, Z_SYNC_FLUSH);
+        lib::error_code ec = m_inflate.init(m_inflate_bits);
+        if (ec) {
+            return ec;
+        }
 
-            if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR) {
-                return make_error_code(error::zlib_error);
-            }
+        size_t const before = out.size();
+        ec = m_inflate.decompress(buf, len, out);
+        if (ec) {
+            return ec;
+        }
 
-            out.append(
-                reinterpret_cast<char *>(m_decompress_buffer.get()),
-                m_compress_buffer_size - m_istate.avail_out
-            );
-        } while (m_istate.avail_out == 0);
+        m_stats.decompress_bytes_in += len;
+        m_stats.decompress_bytes_out += out.size() - before;
+        m_stats.decompress_ns += elapsed_ns(start);
 
         return lib::error_code();
     }
 private:
+    /// Reset the negotiable settings to the local policy
+    void apply_options() {
+        m_server_no_context_takeover = m_options.server_no_context_takeover;
+        m_client_no_context_takeover = m_options.client_no_context_takeover;
+        m_server_max_window_bits = m_options.server_max_window_bits;
+        m_client_max_window_bits = m_options.client_max_window_bits;
+    }
+
+#ifdef _WEBSOCKETPP_CPP11_CHRONO_
+    typedef lib::chrono::steady_clock::time_point time_point;
+
+    static time_point now() {
+        return lib::chrono::steady_clock::now();
+    }
+
+    /// Nanoseconds elapsed since start
+    static uint64_t elapsed_ns(time_point start) {
+        return static_cast<uint64_t>(
+            lib::chrono::duration_cast<lib::chrono::nanoseconds>(
+                lib::chrono::steady_clock::now() - start
+            ).count()
+        );
+    }
+#else
+    // Boost.Chrono's clocks are not header-only, so without std::chrono
+    // compression times are not collected rather than adding a link
+    // dependency.
+    typedef int time_point;
+
+    static time_point now() {
+        return 0;
+    }
+
+    static uint64_t elapsed_ns(time_point) {
+        return 0;
+    }
+#endif
+
     /// Generate negotiation response
     /**
      * @return Generate extension negotiation reponse string to send to client
@@ -679,7 +987,7 @@ private:
     /// Negotiate server_max_window_bits attribute
     /**
      * When this method starts, m_server_max_window_bits will contain the server's
-     * preferred value and m_server_max_window_bits_mode will contain the mode the
+     * preferred value and m_options.server_max_window_bits_mode will contain the mode the
      * server wants to use to for negotiation. `value` contains the value the
      * client requested that we use.
      *
@@ -709,7 +1017,7 @@ private:
             return;
         }
 
-        switch (m_server_max_window_bits_mode) {
+        switch (m_options.server_max_window_bits_mode) {
             case mode::decline:
                 m_server_max_window_bits = default_server_max_window_bits;
                 break;
@@ -769,7 +1077,7 @@ private:
             return;
         }
 
-        switch (m_client_max_window_bits_mode) {
+        switch (m_options.client_max_window_bits_mode) {
             case mode::decline:
                 m_client_max_window_bits = default_client_max_window_bits;
                 break;
@@ -793,21 +1101,21 @@ private:
         }
     }
 
+    options m_options;
+
     bool m_enabled;
     bool m_server_no_context_takeover;
     bool m_client_no_context_takeover;
     uint8_t m_server_max_window_bits;
     uint8_t m_client_max_window_bits;
-    mode::value m_server_max_window_bits_mode;
-    mode::value m_client_max_window_bits_mode;
 
     bool m_initialized;
-    int m_flush;
-    size_t m_compress_buffer_size;
-    lib::unique_ptr_uchar_array m_compress_buffer;
-    lib::unique_ptr_uchar_array m_decompress_buffer;
-    z_stream m_dstate;
-    z_stream m_istate;
+    uint8_t m_deflate_bits;
+    uint8_t m_inflate_bits;
+    bool m_reset_deflate;
+    deflate_stream m_deflate;
+    inflate_stream m_inflate;
+    stats m_stats;
 };
 
 } // namespace permessage_deflate
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2015, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_EXTENSION_PERMESSAGE_DEFLATE_OPTIONS_HPP
+#define WEBSOCKETPP_EXTENSION_PERMESSAGE_DEFLATE_OPTIONS_HPP
+
+#include <websocketpp/common/stdint.hpp>
+
+#include <cstddef>
+
+namespace websocketpp {
+namespace extensions {
+namespace permessage_deflate {
+
+namespace mode {
+enum value {
+    /// Accept any value the remote endpoint offers
+    accept = 1,
+    /// Decline any value the remote endpoint offers. Insist on defaults.
+    decline,
+    /// Use the largest value common to both offers
+    largest,
+    /// Use the smallest value common to both offers
+    smallest
+};
+} // namespace mode
+
+/// Local permessage-deflate policy
+/**
+ * A plain value type describing how an endpoint negotiates and uses
+ * permessage-deflate. Endpoints copy it into each new connection and the
+ * connection hands it to its processor, so it is available to both the
+ * enabled extension and the disabled stub without pulling in zlib.
+ *
+ * The defaults match the behavior of the extension before these options
+ * existed: every message is compressed, the remote endpoint's window and
+ * context takeover requests are accepted as offered and zlib uses its
+ * default compression level with memory level 4.
+ *
+ * Memory use of a connection's compressor is roughly
+ * `(1 << (window_bits + 2)) + (1 << (memory_level + 9))` bytes and that of its
+ * decompressor `(1 << window_bits) + 7KiB`. With default settings that is
+ * about 170KiB per connection, which `server_no_context_takeover` and reduced
+ * window bits can bring down to a few KiB.
+ */
+struct options {
+    options()
+      : compression_threshold(0)
+      , server_no_context_takeover(false)
+      , client_no_context_takeover(false)
+      , server_max_window_bits(15)
+      , server_max_window_bits_mode(mode::accept)
+      , client_max_window_bits(15)
+      , client_max_window_bits_mode(mode::accept)
+      , compression_level(-1)
+      , memory_level(4) {}
+
+    /// Outgoing messages with fewer payload bytes than this are sent
+    /// uncompressed. Deflate rarely shrinks payloads under a few hundred
+    /// bytes enough to pay for the CPU time spent on them.
+    size_t compression_threshold;
+
+    /// Reset the server's compression context after every message
+    bool server_no_context_takeover;
+    /// Ask the client to reset its compression context after every message
+    bool client_no_context_takeover;
+
+    /// Base 2 logarithm of the server's LZ77 window size (9-15)
+    uint8_t server_max_window_bits;
+    /// How to negotiate server_max_window_bits with the remote endpoint
+    mode::value server_max_window_bits_mode;
+    /// Base 2 logarithm of the client's LZ77 window size (9-15)
+    uint8_t client_max_window_bits;
+    /// How to negotiate client_max_window_bits with the remote endpoint
+    mode::value client_max_window_bits_mode;
+
+    /// zlib compression level, 0-9 or -1 for zlib's default (6)
+    int compression_level;
+    /// zlib memory level, 1-9
+    int memory_level;
+};
+
+/// Running compression totals for one connection
+/**
+ * Times are wall clock nanoseconds spent inside zlib and are intended to be
+ * summed across all connections of the same kind to compare the CPU cost of
+ * compression with the bandwidth it saves. Times are only collected when
+ * std::chrono is available.
+ */
+struct stats {
+    stats()
+      : messages_compressed(0)
+      , messages_skipped(0)
+      , compress_bytes_in(0)
+      , compress_bytes_out(0)
+      , compress_ns(0)
+      , decompress_bytes_in(0)
+      , decompress_bytes_out(0)
+      , decompress_ns(0) {}
+
+    /// Outgoing messages that were compressed
+    uint64_t messages_compressed;
+    /// Outgoing messages sent uncompressed because of compression_threshold
+    uint64_t messages_skipped;
+    /// Payload bytes handed to the compressor
+    uint64_t compress_bytes_in;
+    /// Compressed bytes produced, including the four byte flush marker that
+    /// is stripped from each message before it is sent
+    uint64_t compress_bytes_out;
+    /// Time spent compressing
+    uint64_t compress_ns;
+
+    /// Compressed bytes handed to the decompressor, including the four byte
+    /// trailer restored at the end of each message
+    uint64_t decompress_bytes_in;
+    /// Payload bytes produced by the decompressor
+    uint64_t decompress_bytes_out;
+    /// Time spent decompressing
+    uint64_t decompress_ns;
+
+    /// Compressed size of outgoing payloads as a fraction of their original
+    /// size, or 1.0 if nothing has been compressed yet
+    double compression_ratio() const {
+        if (compress_bytes_in == 0) {
+            return 1.0;
+        }
+        return double(compress_bytes_out) / double(compress_bytes_in);
+    }
+
+    /// Add the totals from another connection
+    stats & operator+=(stats const & o) {
+        messages_compressed += o.messages_compressed;
+        messages_skipped += o.messages_skipped;
+        compress_bytes_in += o.compress_bytes_in;
+        compress_bytes_out += o.compress_bytes_out;
+        compress_ns += o.compress_ns;
+        decompress_bytes_in += o.decompress_bytes_in;
+        decompress_bytes_out += o.decompress_bytes_out;
+        decompress_ns += o.decompress_ns;
+        return *this;
+    }
+};
+
+} // namespace permessage_deflate
+} // namespace extensions
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_EXTENSION_PERMESSAGE_DEFLATE_OPTIONS_HPP
@@ -29,13 +29,25 @@
 #define WEBSOCKETPP_FRAME_HPP
 
 #include <algorithm>
+#include <cstring>
 #include <string>
 
 #include <websocketpp/common/system_error.hpp>
 #include <websocketpp/common/network.hpp>
+#include <websocketpp/common/cpu.hpp>
 
 #include <websocketpp/utilities.hpp>
 
+// SIMD masking kernels: SSE2 whenever the compiler targets it, AVX2 when it
+// can be compiled per function and the CPU supports it at run time. Define
+// _WEBSOCKETPP_NO_SIMD_MASKING_ to use the portable word by word code.
+#if !defined(_WEBSOCKETPP_NO_SIMD_MASKING_) && defined(_WEBSOCKETPP_SSE2_)
+    #define _WEBSOCKETPP_SSE2_MASKING_
+    #ifdef _WEBSOCKETPP_TARGET_SIMD_
+        #define _WEBSOCKETPP_AVX2_MASKING_
+    #endif
+#endif
+
 namespace websocketpp {
 /// Data structures and utility functions for manipulating WebSocket frames
 /**
@@ -312,6 +324,16 @@ void word_mask_exact(uint8_t * data, size_t length, masking_key_type const &
 size_t word_mask_circ(uint8_t * input, uint8_t * output, size_t length,
     size_t prepared_key);
 size_t word_mask_circ(uint8_t * data, size_t length, size_t prepared_key);
+size_t word_mask_circ_scalar(uint8_t * input, uint8_t * output, size_t length,
+    size_t prepared_key);
+#ifdef _WEBSOCKETPP_SSE2_MASKING_
+size_t word_mask_circ_sse2(uint8_t * input, uint8_t * output, size_t length,
+    size_t prepared_key);
+#endif
+#ifdef _WEBSOCKETPP_AVX2_MASKING_
+size_t word_mask_circ_avx2(uint8_t * input, uint8_t * output, size_t length,
+    size_t prepared_key);
+#endif
 
 /// Check whether the frame's FIN bit is set.
 /**
@@ -678,6 +700,138 @@ void byte_mask(iter_type b, iter_type e, masking_key_type const & key,
     byte_mask(b,e,b,key,key_offset);
 }
 
+/// Instruction set used by the masking functions
+namespace mask_isa {
+    enum value {
+        /// Portable word by word code
+        scalar = 0,
+        /// 16 bytes at a time with SSE2
+        sse2 = 1,
+        /// 32 bytes at a time with AVX2
+        avx2 = 2
+    };
+} // namespace mask_isa
+
+/// Detect the best masking instruction set supported by this CPU
+/**
+ * The CPU is queried once (see lib::cpu). Always returns scalar if SIMD
+ * masking is disabled or the compiler does not target x86.
+ *
+ * @return The instruction set that word_mask_circ and word_mask_exact use for
+ * buffers large enough to benefit from it.
+ */
+inline mask_isa::value get_mask_isa() {
+#if defined(_WEBSOCKETPP_AVX2_MASKING_)
+    return lib::cpu::has_avx2() ? mask_isa::avx2 : mask_isa::sse2;
+#elif defined(_WEBSOCKETPP_SSE2_MASKING_)
+    return mask_isa::sse2;
+#else
+    return mask_isa::scalar;
+#endif
+}
+
+/// Circular word by word mask/unmask, portable version
+/**
+ * The portable kernel behind word_mask_circ. Words are loaded and stored with
+ * memcpy, so input and output need no particular alignment.
+ *
+ * @see word_mask_circ
+ *
+ * @param input Buffer to mask or unmask
+ *
+ * @param output Buffer to store the output. May be the same as input.
+ *
+ * @param length Length of data
+ *
+ * @param prepared_key Prepared key to use.
+ *
+ * @return the prepared_key shifted to account for the input length
+ */
+inline size_t word_mask_circ_scalar(uint8_t * input, uint8_t * output,
+    size_t length, size_t prepared_key)
+{
+    size_t n = length / sizeof(size_t); // whole words
+    size_t l = length - (n * sizeof(size_t)); // remaining bytes
+
+    // mask word by word
+    for (size_t i = 0; i < n; i++) {
+        size_t word;
+        std::memcpy(&word, input + i*sizeof(size_t), sizeof(size_t));
+        word ^= prepared_key;
+        std::memcpy(output + i*sizeof(size_t), &word, sizeof(size_t));
+    }
+
+    // mask partial word at the end
+    size_t start = length - l;
+    uint8_t * byte_key = reinterpret_cast<uint8_t *>(&prepared_key);
+    for (size_t i = 0; i < l; ++i) {
+        output[start+i] = input[start+i] ^ byte_key[i];
+    }
+
+    return circshift_prepared_key(prepared_key,l);
+}
+
+#ifdef _WEBSOCKETPP_SSE2_MASKING_
+/// Circular mask/unmask 16 bytes at a time with SSE2
+/**
+ * Same contract as word_mask_circ_scalar. Whole 16 byte blocks are masked
+ * with unaligned SSE2 loads and stores; since 16 is a multiple of the key
+ * length the key phase carries over unchanged to the scalar tail.
+ *
+ * @see word_mask_circ
+ */
+inline size_t word_mask_circ_sse2(uint8_t * input, uint8_t * output,
+    size_t length, size_t prepared_key)
+{
+    uint32_t key32 = static_cast<uint32_t>(prepared_key);
+    __m128i key = _mm_set1_epi32(static_cast<int>(key32));
+
+    size_t n = length / 16;
+    for (size_t i = 0; i < n; ++i) {
+        __m128i block = _mm_loadu_si128(
+            reinterpret_cast<__m128i const *>(input + i*16));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i*16),
+            _mm_xor_si128(block, key));
+    }
+
+    size_t done = n * 16;
+    return word_mask_circ_scalar(input+done,output+done,length-done,
+        prepared_key);
+}
+#endif
+
+#ifdef _WEBSOCKETPP_AVX2_MASKING_
+/// Circular mask/unmask 32 bytes at a time with AVX2
+/**
+ * Same contract as word_mask_circ_scalar. Masks two 32 byte blocks per
+ * iteration, then hands what is left to the SSE2 kernel. Must only be called
+ * if get_mask_isa() returns mask_isa::avx2.
+ *
+ * @see word_mask_circ
+ */
+_WEBSOCKETPP_TARGET_AVX2_
+inline size_t word_mask_circ_avx2(uint8_t * input, uint8_t * output,
+    size_t length, size_t prepared_key)
+{
+    uint32_t key32 = static_cast<uint32_t>(prepared_key);
+    __m256i key = _mm256_set1_epi32(static_cast<int>(key32));
+
+    size_t n = length / 64;
+    for (size_t i = 0; i < n; ++i) {
+        __m256i const * in = reinterpret_cast<__m256i const *>(input + i*64);
+        __m256i * out = reinterpret_cast<__m256i *>(output + i*64);
+        __m256i a = _mm256_loadu_si256(in);
+        __m256i b = _mm256_loadu_si256(in + 1);
+        _mm256_storeu_si256(out, _mm256_xor_si256(a, key));
+        _mm256_storeu_si256(out + 1, _mm256_xor_si256(b, key));
+    }
+
+    size_t done = n * 64;
+    return word_mask_circ_sse2(input+done,output+done,length-done,
+        prepared_key);
+}
+#endif
+
 /// Exact word aligned mask/unmask
 /**
  * Balanced combination of byte by byte and circular word by word masking.
@@ -702,18 +856,7 @@ void byte_mask(iter_type b, iter_type e, masking_key_type const & key,
 inline void word_mask_exact(uint8_t* input, uint8_t* output, size_t length,
     const masking_key_type& key)
 {
-    size_t prepared_key = prepare_masking_key(key);
-    size_t n = length/sizeof(size_t);
-    size_t* input_word = reinterpret_cast<size_t*>(input);
-    size_t* output_word = reinterpret_cast<size_t*>(output);
-
-    for (size_t i = 0; i < n; i++) {
-        output_word[i] = input_word[i] ^ prepared_key;
-    }
-
-    for (size_t i = n*sizeof(size_t); i < length; i++) {
-        output[i] = input[i] ^ key.c[i%4];
-    }
+    word_mask_circ(input,output,length,prepare_masking_key(key));
 }
 
 /// Exact word aligned mask/unmask (in place)
@@ -752,6 +895,9 @@ inline void word_mask_exact(uint8_t* data, size_t length, const
  * length value. The returned value may be fed back into word_mask when more
  * data is available.
  *
+ * Buffers of 16 bytes or more are masked with SSE2, and those of 64 bytes or
+ * more with AVX2, when the compiler and CPU support them (see get_mask_isa).
+ *
  * input and output must both have length at least:
  *    ceil(length/sizeof(size_t))*sizeof(size_t)
  * Exactly that many bytes will be written, although only exactly length bytes
@@ -768,24 +914,17 @@ inline void word_mask_exact(uint8_t* data, size_t length, const
 inline size_t word_mask_circ(uint8_t * input, uint8_t * output, size_t length,
     size_t prepared_key)
 {
-    size_t n = length / sizeof(size_t); // whole words
-    size_t l = length - (n * sizeof(size_t)); // remaining bytes
-    size_t * input_word = reinterpret_cast<size_t *>(input);
-    size_t * output_word = reinterpret_cast<size_t *>(output);
-
-    // mask word by word
-    for (size_t i = 0; i < n; i++) {
-        output_word[i] = input_word[i] ^ prepared_key;
+#ifdef _WEBSOCKETPP_AVX2_MASKING_
+    if (length >= 64 && get_mask_isa() == mask_isa::avx2) {
+        return word_mask_circ_avx2(input,output,length,prepared_key);
     }
-
-    // mask partial word at the end
-    size_t start = length - l;
-    uint8_t * byte_key = reinterpret_cast<uint8_t *>(&prepared_key);
-    for (size_t i = 0; i < l; ++i) {
-        output[start+i] = input[start+i] ^ byte_key[i];
+#endif
+#ifdef _WEBSOCKETPP_SSE2_MASKING_
+    if (length >= 16) {
+        return word_mask_circ_sse2(input,output,length,prepared_key);
     }
-
-    return circshift_prepared_key(prepared_key,l);
+#endif
+    return word_mask_circ_scalar(input,output,length,prepared_key);
 }
 
 /// Circular word aligned mask/unmask (in place)
@@ -30,9 +30,12 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <istream>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace websocketpp {
 namespace http {
@@ -42,26 +45,80 @@ inline void parser::set_version(std::string const & version) {
     m_version = version;
 }
 
+/// Case insensitive comparison of two ASCII header names of equal length
+inline bool header_name_equal(char const * a, char const * b, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char ca = static_cast<unsigned char>(a[i]);
+        unsigned char cb = static_cast<unsigned char>(b[i]);
+        if (ca != cb) {
+            if (ca >= 'A' && ca <= 'Z') {ca += 'a'-'A';}
+            if (cb >= 'A' && cb <= 'Z') {cb += 'a'-'A';}
+            if (ca != cb) {return false;}
+        }
+    }
+    return true;
+}
+
+/// Orders header names the same way header_list does
+inline bool header_name_less(std::pair<std::pair<char const *, size_t>,
+    size_t> const & a, std::pair<std::pair<char const *, size_t>, size_t>
+    const & b)
+{
+    return std::lexicographical_compare(
+        a.first.first, a.first.first + a.first.second,
+        b.first.first, b.first.first + b.first.second,
+        utility::ci_less::nocase_compare()
+    );
+}
+
+inline size_t parser::find_header(char const * key, size_t len) const {
+    for (size_t i = 0; i < m_header_fields.size(); ++i) {
+        std::pair<char const *, size_t> name = header_name(m_header_fields[i]);
+        if (name.second == len && header_name_equal(name.first,key,len)) {
+            return i;
+        }
+    }
+    return m_header_fields.size();
+}
+
+inline std::pair<char const *, size_t> parser::header_name(header_field const &
+    f) const
+{
+    if (f.name.empty()) {
+        return std::make_pair(m_header_block.data() + f.name_pos, f.name_len);
+    } else {
+        return std::make_pair(f.name.data(), f.name.size());
+    }
+}
+
+inline std::string const & parser::header_value(header_field const & f) const {
+    if (!f.cached) {
+        f.value.assign(m_header_block, f.value_pos, f.value_len);
+        f.cached = true;
+    }
+    return f.value;
+}
+
 inline std::string const & parser::get_header(std::string const & key) const {
-    header_list::const_iterator h = m_headers.find(key);
+    size_t i = find_header(key.data(),key.size());
 
-    if (h == m_headers.end()) {
+    if (i == m_header_fields.size()) {
         return empty_header;
     } else {
-        return h->second;
+        return header_value(m_header_fields[i]);
     }
 }
 
 inline bool parser::get_header_as_plist(std::string const & key,
     parameter_list & out) const
 {
-    header_list::const_iterator it = m_headers.find(key);
+    std::string const & value = get_header(key);
 
-    if (it == m_headers.end() || it->second.size() == 0) {
+    if (value.size() == 0) {
         return false;
     }
 
-    return this->parse_parameter_list(it->second,out);
+    return this->parse_parameter_list(value,out);
 }
 
 inline void parser::append_header(std::string const & key, std::string const &
@@ -71,21 +128,48 @@ inline void parser::append_header(std::string const & key, std::string const &
         throw exception("Invalid header name",status_code::bad_request);
     }
 
-    if (this->get_header(key).empty()) {
-        m_headers[key] = val;
+    size_t i = find_header(key.data(),key.size());
+    m_header_map_valid = false;
+
+    if (i == m_header_fields.size()) {
+        header_field f;
+        f.name = key;
+        f.value = val;
+        f.cached = true;
+        m_header_fields.push_back(f);
+    } else if (header_value(m_header_fields[i]).empty()) {
+        m_header_fields[i].value = val;
     } else {
-        m_headers[key] += ", " + val;
+        m_header_fields[i].value += ", " + val;
     }
 }
 
 inline void parser::replace_header(std::string const & key, std::string const &
     val)
 {
-    m_headers[key] = val;
+    size_t i = find_header(key.data(),key.size());
+    m_header_map_valid = false;
+
+    if (i == m_header_fields.size()) {
+        header_field f;
+        f.name = key;
+        f.value = val;
+        f.cached = true;
+        m_header_fields.push_back(f);
+    } else {
+        m_header_fields[i].value = val;
+        m_header_fields[i].cached = true;
+    }
 }
 
 inline void parser::remove_header(std::string const & key) {
-    m_headers.erase(key);
+    size_t i = find_header(key.data(),key.size());
+
+    if (i != m_header_fields.size()) {
+        m_header_fields.erase(m_header_fields.begin() + static_cast<
+            header_table::difference_type>(i));
+        m_header_map_valid = false;
+    }
 }
 
 inline void parser::set_body(std::string const & value) {
@@ -176,22 +260,107 @@ inline void parser::process_header(std::string::iterator begin,
                   strip_lws(std::string(cursor+sizeof(header_separator)-1,end)));
 }
 
+inline void parser::add_block_header(size_t name_pos, size_t name_len,
+    size_t value_pos, size_t value_len)
+{
+    size_t i = find_header(m_header_block.data() + name_pos,name_len);
+    m_header_map_valid = false;
+
+    if (i == m_header_fields.size()) {
+        header_field f;
+        f.name_pos = name_pos;
+        f.name_len = name_len;
+        f.value_pos = value_pos;
+        f.value_len = value_len;
+        m_header_fields.push_back(f);
+    } else if (header_value(m_header_fields[i]).empty()) {
+        m_header_fields[i].value.assign(m_header_block, value_pos, value_len);
+    } else {
+        std::string & value = m_header_fields[i].value;
+        value.append(", ");
+        value.append(m_header_block, value_pos, value_len);
+    }
+}
+
+inline void parser::process_block_header(size_t begin, size_t end) {
+    char const * data = m_header_block.data();
+
+    char const * sep = static_cast<char const *>(
+        std::memchr(data + begin, header_separator[0], end - begin));
+
+    if (sep == NULL) {
+        throw exception("Invalid header line",status_code::bad_request);
+    }
+
+    // trim linear whitespace around the name and the value. A line holds no
+    // CRLF so this matches strip_lws.
+    size_t name_begin = begin;
+    size_t name_end = static_cast<size_t>(sep - data);
+    size_t value_begin = name_end + 1;
+    size_t value_end = end;
+
+    while (name_begin < name_end && is_whitespace_char(
+        static_cast<unsigned char>(data[name_begin]))) {++name_begin;}
+    while (name_end > name_begin && is_whitespace_char(
+        static_cast<unsigned char>(data[name_end-1]))) {--name_end;}
+    while (value_begin < value_end && is_whitespace_char(
+        static_cast<unsigned char>(data[value_begin]))) {++value_begin;}
+    while (value_end > value_begin && is_whitespace_char(
+        static_cast<unsigned char>(data[value_end-1]))) {--value_end;}
+
+    for (size_t i = name_begin; i < name_end; ++i) {
+        if (is_not_token_char(static_cast<unsigned char>(data[i]))) {
+            throw exception("Invalid header name",status_code::bad_request);
+        }
+    }
+
+    add_block_header(name_begin, name_end - name_begin, value_begin,
+        value_end - value_begin);
+}
+
 inline header_list const & parser::get_headers() const {
-    return m_headers;
+    if (!m_header_map_valid) {
+        m_header_map.clear();
+
+        header_table::const_iterator it;
+        for (it = m_header_fields.begin(); it != m_header_fields.end(); ++it) {
+            std::pair<char const *, size_t> name = header_name(*it);
+            m_header_map.insert(std::make_pair(
+                std::string(name.first,name.second), header_value(*it)));
+        }
+
+        m_header_map_valid = true;
+    }
+
+    return m_header_map;
 }
 
 inline std::string parser::raw_headers() const {
-    std::stringstream raw;
+    // emit headers in the same case insensitive order as header_list
+    std::vector<std::pair<std::pair<char const *, size_t>, size_t> > order;
+    order.reserve(m_header_fields.size());
 
-    header_list::const_iterator it;
-    for (it = m_headers.begin(); it != m_headers.end(); it++) {
-        raw << it->first << ": " << it->second << "\r\n";
+    size_t size = 0;
+    for (size_t i = 0; i < m_header_fields.size(); ++i) {
+        std::pair<char const *, size_t> name = header_name(m_header_fields[i]);
+        order.push_back(std::make_pair(name,i));
+        size += name.second + header_value(m_header_fields[i]).size() + 4;
     }
 
-    return raw.str();
-}
+    std::sort(order.begin(),order.end(),&header_name_less);
 
+    std::string raw;
+    raw.reserve(size);
 
+    for (size_t i = 0; i < order.size(); ++i) {
+        raw.append(order[i].first.first,order[i].first.second);
+        raw.append(": ");
+        raw.append(header_value(m_header_fields[order[i].second]));
+        raw.append("\r\n");
+    }
+
+    return raw;
+}
 
 } // namespace parser
 } // namespace http
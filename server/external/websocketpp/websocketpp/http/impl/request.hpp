@@ -29,6 +29,7 @@
 #define HTTP_PARSER_REQUEST_IMPL_HPP
 
 #include <algorithm>
+#include <cstring>
 #include <sstream>
 #include <string>
 
@@ -51,54 +52,72 @@ inline size_t request::consume(char const * buf, size_t len) {
         return bytes_processed;
     }
 
-    // copy new header bytes into buffer
-    m_buf->append(buf,len);
+    // Copy new header bytes into the header block. No more than one byte
+    // past the maximum header size is needed to tell that a request is too
+    // large, so trailing body bytes are only copied up to that point.
+    size_t const prior = m_header_block.size();
+    size_t const copied = (std::min)(len, max_header_size + 1 - prior);
 
-    // Search for delimiter in buf. If found read until then. If not read all
-    std::string::iterator begin = m_buf->begin();
-    std::string::iterator end;
+    m_header_block.append(buf,copied);
+
+    size_t const size = m_header_block.size();
 
     for (;;) {
-        // search for line delimiter
-        end = std::search(
-            begin,
-            m_buf->end(),
-            header_delimiter,
-            header_delimiter+sizeof(header_delimiter)-1
-        );
-        
-        m_header_bytes += (end-begin+sizeof(header_delimiter));
-        
-        if (m_header_bytes > max_header_size) {
-            // exceeded max header size
-            throw exception("Maximum header size exceeded.",
-                status_code::request_header_fields_too_large);
+        // search for the next line delimiter
+        char const * data = m_header_block.data();
+        char const * cursor = data + m_scan_pos;
+        char const * const last = data + size;
+        char const * end = NULL;
+
+        while (cursor != last) {
+            cursor = static_cast<char const *>(std::memchr(cursor,
+                header_delimiter[0], static_cast<size_t>(last - cursor)));
+
+            if (cursor == NULL || cursor + 1 == last) {
+                break;
+            }
+            if (cursor[1] == header_delimiter[1]) {
+                end = cursor;
+                break;
+            }
+            ++cursor;
         }
 
-        if (end == m_buf->end()) {
-            // we are out of bytes. Discard the processed bytes and copy the
-            // remaining unprecessed bytes to the beginning of the buffer
-            std::copy(begin,end,m_buf->begin());
-            m_buf->resize(static_cast<std::string::size_type>(end-begin));
-            m_header_bytes -= m_buf->size();
+        if (end == NULL) {
+            if (size > max_header_size) {
+                // exceeded max header size
+                throw exception("Maximum header size exceeded.",
+                    status_code::request_header_fields_too_large);
+            }
+
+            // out of bytes. Resume the search at a trailing CR so that a
+            // delimiter split across reads is found.
+            m_scan_pos = (cursor != NULL && cursor + 1 == last) ?
+                size - 1 : size;
 
             return len;
         }
 
-        //the range [begin,end) now represents a line to be processed.
-        if (end-begin == 0) {
+        size_t const line_end = static_cast<size_t>(end - data);
+
+        if (line_end + sizeof(header_delimiter) - 1 > max_header_size) {
+            // exceeded max header size
+            throw exception("Maximum header size exceeded.",
+                status_code::request_header_fields_too_large);
+        }
+
+        //the range [m_line_begin,line_end) now represents a line to be
+        //processed.
+        if (line_end == m_line_begin) {
             // we got a blank line
             if (m_method.empty() || get_header("Host").empty()) {
                 throw exception("Incomplete Request",status_code::bad_request);
             }
 
-            bytes_processed = (
-                len - static_cast<std::string::size_type>(m_buf->end()-end)
-                    + sizeof(header_delimiter) - 1
-            );
+            bytes_processed = line_end + sizeof(header_delimiter) - 1 - prior;
 
-            // frees memory used temporarily during request parsing
-            m_buf.reset();
+            // drop the delimiter and any body bytes copied with the headers
+            m_header_block.resize(line_end);
 
             // if this was not an upgrade request and has a content length
             // continue capturing content-length bytes and expose them as a 
@@ -118,13 +137,15 @@ inline size_t request::consume(char const * buf, size_t len) {
             }
         } else {
             if (m_method.empty()) {
-                this->process(begin,end);
+                this->process(data + m_line_begin, end);
+                m_header_fields.reserve(16);
             } else {
-                this->process_header(begin,end);
+                this->process_block_header(m_line_begin, line_end);
             }
         }
 
-        begin = end+(sizeof(header_delimiter)-1);
+        m_line_begin = line_end + sizeof(header_delimiter) - 1;
+        m_scan_pos = m_line_begin;
     }
 }
 
@@ -161,11 +182,9 @@ inline void request::set_uri(std::string const & uri) {
     m_uri = uri;
 }
 
-inline void request::process(std::string::iterator begin, std::string::iterator
-    end)
-{
-    std::string::iterator cursor_start = begin;
-    std::string::iterator cursor_end = std::find(begin,end,' ');
+inline void request::process(char const * begin, char const * end) {
+    char const * cursor_start = begin;
+    char const * cursor_end = std::find(begin,end,' ');
 
     if (cursor_end == end) {
         throw exception("Invalid request line1",status_code::bad_request);
@@ -178,14 +178,33 @@ inline size_t response::consume(std::istream & s) {
 inline std::string response::raw() const {
     // TODO: validation. Make sure all required fields have been set?
 
-    std::stringstream ret;
-
-    ret << get_version() << " " << m_status_code << " " << m_status_msg;
-    ret << "\r\n" << raw_headers() << "\r\n";
-
-    ret << m_body;
-
-    return ret.str();
+    // status codes are non-negative and at most a few digits
+    char code[16];
+    char * code_end = code + sizeof(code);
+    char * code_begin = code_end;
+    unsigned int value = static_cast<unsigned int>(m_status_code);
+    do {
+        *--code_begin = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    std::string const headers = raw_headers();
+
+    std::string ret;
+    ret.reserve(get_version().size() + (code_end - code_begin) +
+        m_status_msg.size() + headers.size() + m_body.size() + 6);
+
+    ret.append(get_version());
+    ret.append(1,' ');
+    ret.append(code_begin,code_end);
+    ret.append(1,' ');
+    ret.append(m_status_msg);
+    ret.append("\r\n");
+    ret.append(headers);
+    ret.append("\r\n");
+    ret.append(m_body);
+
+    return ret;
 }
 
 inline void response::set_status(status_code::value code) {
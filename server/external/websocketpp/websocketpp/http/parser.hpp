@@ -32,6 +32,7 @@
 #include <map>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <websocketpp/utilities.hpp>
 #include <websocketpp/http/constants.hpp>
@@ -398,7 +399,8 @@ inline std::string strip_lws(std::string const & input) {
 class parser {
 public:
     parser()
-      : m_header_bytes(0)
+      : m_header_map_valid(false)
+      , m_header_bytes(0)
       , m_body_bytes_needed(0)
       , m_body_bytes_max(max_body_size)
       , m_body_encoding(body_encoding::unknown) {}
@@ -422,7 +424,8 @@ public:
 
     /// Get the value of an HTTP header
     /**
-     * @todo Make this method case insensitive.
+     * Header names are matched case insensitively. The returned reference is
+     * valid until the headers of this parser are next modified.
      *
      * @param [in] key The name/key of the header to get.
      * @return The value associated with the given HTTP header key.
@@ -443,7 +446,8 @@ public:
 
     /// Return a list of all HTTP headers
     /**
-     * Return a list of all HTTP headers
+     * Return a list of all HTTP headers. The list is built from the header
+     * table on first use after the headers change.
      *
      * @since 0.8.0
      *
@@ -609,8 +613,80 @@ protected:
      */
     std::string raw_headers() const;
 
+    /// One entry of the flat header table
+    /**
+     * Parsed headers refer to their name and value by offset into
+     * `m_header_block` so parsing a request does not allocate per header.
+     * The std::string returned by `get_header` is built on first use and
+     * becomes authoritative once set. Headers set by application code and
+     * values merged from repeated headers are held in `name` and `value`.
+     */
+    struct header_field {
+        header_field()
+          : name_pos(0)
+          , name_len(0)
+          , value_pos(0)
+          , value_len(0)
+          , cached(false) {}
+
+        size_t name_pos;
+        size_t name_len;
+        size_t value_pos;
+        size_t value_len;
+
+        /// Owned name, empty for headers that point into m_header_block
+        std::string name;
+        /// Materialized value, valid when `cached` is set
+        mutable std::string value;
+        mutable bool cached;
+    };
+
+    typedef std::vector<header_field> header_table;
+
+    /// Look up a header in the header table (case insensitive)
+    /**
+     * @param [in] key The name of the header to find
+     * @param [in] len The length of the name
+     * @return The index of the header or header_table::size() if not found
+     */
+    size_t find_header(char const * key, size_t len) const;
+
+    /// Return the name of a header table entry
+    std::pair<char const *, size_t> header_name(header_field const & f)
+        const;
+
+    /// Return the value of a header table entry, materializing it if needed
+    std::string const & header_value(header_field const & f) const;
+
+    /// Add a header that points into the header block
+    /**
+     * Merges the value with an existing header of the same name the way
+     * `append_header` does.
+     *
+     * @param [in] name_pos Offset of the name in m_header_block
+     * @param [in] name_len Length of the name
+     * @param [in] value_pos Offset of the value in m_header_block
+     * @param [in] value_len Length of the value
+     */
+    void add_block_header(size_t name_pos, size_t name_len, size_t value_pos,
+        size_t value_len);
+
+    /// Process a header line in m_header_block
+    /**
+     * @param [in] begin Offset of the first character of the line
+     * @param [in] end Offset of the line's CRLF
+     */
+    void process_block_header(size_t begin, size_t end);
+
     std::string m_version;
-    header_list m_headers;
+
+    /// Raw header block of a parsed message, referenced by m_header_fields
+    std::string m_header_block;
+    header_table m_header_fields;
+
+    /// Map view of the header table returned by get_headers
+    mutable header_list m_header_map;
+    mutable bool m_header_map_valid;
     
     size_t                  m_header_bytes;
     
@@ -53,7 +53,8 @@ public:
     typedef lib::shared_ptr<type> ptr;
 
     request()
-      : m_buf(lib::make_shared<std::string>())
+      : m_line_begin(0)
+      , m_scan_pos(0)
       , m_ready(false) {}
 
     /// Process bytes in the input buffer
@@ -68,6 +69,10 @@ public:
      * the ready flag will be set. Further calls to consume once ready will be
      * ignored.
      *
+     * Header bytes are copied once into a block owned by the request and
+     * parsed in a single pass as they arrive. Parsed headers refer into that
+     * block rather than being copied into individual strings.
+     *
      * Consume will throw an http::exception in the case of an error. Typical
      * error reasons include malformed requests, incomplete requests, and max
      * header size being reached.
@@ -107,9 +112,12 @@ public:
 
 private:
     /// Helper function for message::consume. Process request line
-    void process(std::string::iterator begin, std::string::iterator end);
+    void process(char const * begin, char const * end);
 
-    lib::shared_ptr<std::string>    m_buf;
+    /// Offset in m_header_block of the first byte of the current line
+    size_t                          m_line_begin;
+    /// Offset in m_header_block to resume searching for a CRLF from
+    size_t                          m_scan_pos;
     std::string                     m_method;
     std::string                     m_uri;
     bool                            m_ready;
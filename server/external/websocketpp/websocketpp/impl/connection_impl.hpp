@@ -73,6 +73,47 @@ size_t connection<config>::get_buffered_amount() const {
     return m_send_buffer_size;
 }
 
+template <typename config>
+size_t connection<config>::get_conflated_count() const {
+    scoped_lock_type lock(const_cast<mutex_type &>(m_write_lock));
+    return m_conflated_count;
+}
+
+template <typename config>
+void connection<config>::cork() {
+    scoped_lock_type lock(m_write_lock);
+    m_corked = true;
+}
+
+template <typename config>
+void connection<config>::uncork() {
+    bool needs_writing = false;
+    {
+        scoped_lock_type lock(m_write_lock);
+        m_corked = false;
+        needs_writing = !m_write_flag && !m_send_queue.empty();
+    }
+
+    if (needs_writing) {
+        transport_con_type::dispatch(lib::bind(
+            &type::write_frame,
+            type::get_shared()
+        ));
+    }
+}
+
+template <typename config>
+bool connection<config>::is_corked() const {
+    scoped_lock_type lock(const_cast<mutex_type &>(m_write_lock));
+    return m_corked;
+}
+
+template <typename config>
+write_stats connection<config>::get_write_stats() const {
+    scoped_lock_type lock(const_cast<mutex_type &>(m_write_lock));
+    return m_write_stats;
+}
+
 template <typename config>
 session::state::value connection<config>::get_state() const {
     //scoped_lock_type lock(m_connection_state_lock);
@@ -90,6 +131,17 @@ lib::error_code connection<config>::send(std::string const & payload,
     return send(msg);
 }
 
+template <typename config>
+lib::error_code connection<config>::send(std::string const & payload,
+    frame::opcode::value op, std::string const & conflation_key)
+{
+    message_ptr msg = m_msg_manager->get_message(op,payload.size());
+    msg->append_payload(payload);
+    msg->set_compressed(true);
+
+    return send(msg,conflation_key);
+}
+
 template <typename config>
 lib::error_code connection<config>::send(void const * payload, size_t len,
     frame::opcode::value op)
@@ -102,6 +154,13 @@ lib::error_code connection<config>::send(void const * payload, size_t len,
 
 template <typename config>
 lib::error_code connection<config>::send(typename config::message_type::ptr msg)
+{
+    return send(msg,std::string());
+}
+
+template <typename config>
+lib::error_code connection<config>::send(typename config::message_type::ptr msg,
+    std::string const & conflation_key)
 {
     if (m_alog->static_test(log::alevel::devel)) {
         m_alog->write(log::alevel::devel,"connection send");
@@ -116,13 +175,15 @@ lib::error_code connection<config>::send(typename config::message_type::ptr msg)
 
     message_ptr outgoing_msg;
     bool needs_writing = false;
+    bool overflow = false;
 
     if (msg->get_prepared()) {
         outgoing_msg = msg;
 
         scoped_lock_type lock(m_write_lock);
-        write_push(outgoing_msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
+        write_push(outgoing_msg,conflation_key);
+        overflow = write_overflowed();
+        needs_writing = !m_write_flag && !m_corked && !m_send_queue.empty();
     } else {
         outgoing_msg = m_msg_manager->get_message();
 
@@ -137,8 +198,25 @@ lib::error_code connection<config>::send(typename config::message_type::ptr msg)
             return ec;
         }
 
-        write_push(outgoing_msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
+        write_push(outgoing_msg,conflation_key);
+        overflow = write_overflowed();
+        needs_writing = !m_write_flag && !m_corked && !m_send_queue.empty();
+    }
+
+    if (overflow) {
+        // The reader is too far behind to catch up; drop its backlog and
+        // close rather than let the queue grow without bound.
+        {
+            scoped_lock_type lock(m_write_lock);
+            write_clear();
+        }
+        m_elog->write(log::elevel::rerror,
+            "Send queue limit exceeded, closing connection");
+
+        lib::error_code close_ec;
+        this->close(close::status::try_again_later,"Send queue limit exceeded",
+            close_ec);
+        return error::make_error_code(error::send_queue_full);
     }
 
     if (needs_writing) {
@@ -866,7 +944,9 @@ void connection<config>::handle_read_handshake(lib::error_code const & ec,
         return;
     }
 
-    if (m_alog->static_test(log::alevel::devel)) {
+    if (m_alog->static_test(log::alevel::devel) &&
+        m_alog->dynamic_test(log::alevel::devel))
+    {
         std::stringstream s;
         s << "bytes_transferred: " << bytes_transferred
           << " bytes, bytes processed: " << bytes_processed << " bytes";
@@ -898,7 +978,9 @@ void connection<config>::handle_read_handshake(lib::error_code const & ec,
             }
         }
 
-        if (m_alog->static_test(log::alevel::devel)) {
+        if (m_alog->static_test(log::alevel::devel) &&
+            m_alog->dynamic_test(log::alevel::devel))
+        {
             m_alog->write(log::alevel::devel,m_request.raw());
             if (!m_request.get_header("Sec-WebSocket-Key3").empty()) {
                 m_alog->write(log::alevel::devel,
@@ -1327,7 +1409,9 @@ void connection<config>::write_http_response(lib::error_code const & ec) {
         m_handshake_buffer = m_response.raw();
     }
 
-    if (m_alog->static_test(log::alevel::devel)) {
+    if (m_alog->static_test(log::alevel::devel) &&
+        m_alog->dynamic_test(log::alevel::devel))
+    {
         m_alog->write(log::alevel::devel,"Raw Handshake response:\n"+m_handshake_buffer);
         if (!m_response.get_header("Sec-WebSocket-Key3").empty()) {
             m_alog->write(log::alevel::devel,
@@ -1463,7 +1547,9 @@ void connection<config>::send_http_request() {
 
     m_handshake_buffer = m_request.raw();
 
-    if (m_alog->static_test(log::alevel::devel)) {
+    if (m_alog->static_test(log::alevel::devel) &&
+        m_alog->dynamic_test(log::alevel::devel))
+    {
         m_alog->write(log::alevel::devel,"Raw Handshake request:\n"+m_handshake_buffer);
     }
 
@@ -1804,15 +1890,32 @@ void connection<config>::write_frame() {
             return;
         }
 
-        // pull off all the messages that are ready to write.
+        // pull off the messages that are ready to write, up to the batch
+        // limits. The first message is always taken, however large.
         // stop if we get a message marked terminal
-        message_ptr next_message = write_pop();
-        while (next_message) {
-            m_current_msgs.push_back(next_message);
-            if (!next_message->get_terminal()) {
-                next_message = write_pop();
-            } else {
-                next_message = message_ptr();
+        size_t batch_bytes = 0;
+        while (!m_send_queue.empty()) {
+            message_ptr const & next = m_send_queue.front().first;
+            size_t next_bytes = next->get_header().size() +
+                                next->get_payload().size();
+
+            if (!m_current_msgs.empty()) {
+                if (m_max_write_batch_messages &&
+                    m_current_msgs.size() >= m_max_write_batch_messages)
+                {
+                    break;
+                }
+                if (m_max_write_batch_bytes &&
+                    batch_bytes + next_bytes > m_max_write_batch_bytes)
+                {
+                    break;
+                }
+            }
+
+            m_current_msgs.push_back(write_pop());
+            batch_bytes += next_bytes;
+            if (m_current_msgs.back()->get_terminal()) {
+                break;
             }
         }
         
@@ -1825,6 +1928,10 @@ void connection<config>::write_frame() {
             // successfully sent or there is some error
             m_write_flag = true;
         }
+
+        ++m_write_stats.transport_writes;
+        m_write_stats.messages_written += m_current_msgs.size();
+        m_write_stats.bytes_written += batch_bytes;
     }
 
     typename std::vector<message_ptr>::iterator it;
@@ -2202,6 +2309,7 @@ connection<config>::get_processor(int version) const {
     
     // Settings not configured by the constructor
     p->set_max_message_size(m_max_message_size);
+    p->set_permessage_deflate_options(m_permessage_deflate_options);
     
     return p;
 }
@@ -2214,7 +2322,7 @@ void connection<config>::write_push(typename config::message_type::ptr msg)
     }
 
     m_send_buffer_size += msg->get_payload().size();
-    m_send_queue.push(msg);
+    m_send_queue.push_back(queued_message(msg,std::string()));
 
     if (m_alog->static_test(log::alevel::devel)) {
         std::stringstream s;
@@ -2224,6 +2332,69 @@ void connection<config>::write_push(typename config::message_type::ptr msg)
     }
 }
 
+template <typename config>
+bool connection<config>::write_overflowed() const {
+    return m_max_buffered_amount &&
+           m_send_buffer_size > m_max_buffered_amount &&
+           m_send_queue.size() > 1;
+}
+
+template <typename config>
+bool connection<config>::conflatable_frame(message_ptr const & msg) {
+    // A complete message (FIN set) that is not compressed (RSV1 clear):
+    // later compressed frames may depend on its deflate output.
+    std::string const & header = msg->get_header();
+    return !header.empty() && (header[0] & 0x80) && !(header[0] & 0x40);
+}
+
+template <typename config>
+bool connection<config>::write_push(typename config::message_type::ptr msg,
+    std::string const & conflation_key)
+{
+    if (!msg) {
+        return false;
+    }
+
+    if (conflation_key.empty()) {
+        write_push(msg);
+        return false;
+    }
+
+    typename std::map<std::string,queued_message *>::iterator it =
+        m_conflation_slots.find(conflation_key);
+
+    if (it != m_conflation_slots.end() && conflatable_frame(msg) &&
+        conflatable_frame(it->second->first))
+    {
+        message_ptr & slot = it->second->first;
+        m_send_buffer_size -= slot->get_payload().size();
+        m_send_buffer_size += msg->get_payload().size();
+        slot = msg;
+        ++m_conflated_count;
+        return true;
+    }
+
+    m_send_buffer_size += msg->get_payload().size();
+    m_send_queue.push_back(queued_message(msg,conflation_key));
+    m_conflation_slots[conflation_key] = &m_send_queue.back();
+
+    if (m_alog->static_test(log::alevel::devel)) {
+        std::stringstream s;
+        s << "write_push: message count: " << m_send_queue.size()
+          << " buffer size: " << m_send_buffer_size;
+        m_alog->write(log::alevel::devel,s.str());
+    }
+    return false;
+}
+
+template <typename config>
+void connection<config>::write_clear()
+{
+    m_send_queue.clear();
+    m_conflation_slots.clear();
+    m_send_buffer_size = 0;
+}
+
 template <typename config>
 typename config::message_type::ptr connection<config>::write_pop()
 {
@@ -2233,10 +2404,19 @@ typename config::message_type::ptr connection<config>::write_pop()
         return msg;
     }
 
-    msg = m_send_queue.front();
+    queued_message & front = m_send_queue.front();
+    msg = front.first;
+
+    if (!front.second.empty()) {
+        typename std::map<std::string,queued_message *>::iterator it =
+            m_conflation_slots.find(front.second);
+        if (it != m_conflation_slots.end() && it->second == &front) {
+            m_conflation_slots.erase(it);
+        }
+    }
 
     m_send_buffer_size -= msg->get_payload().size();
-    m_send_queue.pop();
+    m_send_queue.pop_front();
 
     if (m_alog->static_test(log::alevel::devel)) {
         std::stringstream s;
@@ -2250,6 +2430,12 @@ typename config::message_type::ptr connection<config>::write_pop()
 template <typename config>
 void connection<config>::log_open_result()
 {
+    if (!m_alog->static_test(log::alevel::connect) ||
+        !m_alog->dynamic_test(log::alevel::connect))
+    {
+        return;
+    }
+
     std::stringstream s;
 
     int version;
@@ -80,6 +80,10 @@ endpoint<connection,config>::create_connection() {
         con->set_max_message_size(m_max_message_size);
     }
     con->set_max_http_body_size(m_max_http_body_size);
+    con->set_max_buffered_amount(m_max_buffered_amount);
+    con->set_max_write_batch_bytes(m_max_write_batch_bytes);
+    con->set_max_write_batch_messages(m_max_write_batch_messages);
+    con->set_permessage_deflate_options(m_permessage_deflate_options);
 
     lib::error_code ec;
 
@@ -211,6 +215,49 @@ void endpoint<connection,config>::send(connection_hdl hdl, message_ptr msg) {
     if (ec) { throw exception(ec); }
 }
 
+template <typename connection, typename config>
+typename endpoint<connection,config>::message_ptr
+endpoint<connection,config>::prepare_broadcast(std::string const & payload,
+    frame::opcode::value op, lib::error_code & ec)
+{
+    typedef typename connection_type::message_type message_type;
+    typedef typename connection_type::con_msg_manager_ptr con_msg_manager_ptr;
+
+    if (frame::opcode::is_control(op)) {
+        ec = processor::error::make_error_code(processor::error::invalid_opcode);
+        return message_ptr();
+    }
+    if (op == frame::opcode::text && !utf8_validator::validate(payload)) {
+        ec = processor::error::make_error_code(processor::error::invalid_payload);
+        return message_ptr();
+    }
+
+    // The message belongs to no connection's manager; it is freed when the
+    // last connection has written it.
+    message_ptr msg = lib::make_shared<message_type>(con_msg_manager_ptr(),
+        op, payload.size());
+    msg->append_payload(payload);
+
+    frame::basic_header h(op,payload.size(),true,false);
+    frame::extended_header e(payload.size());
+    msg->set_header(frame::prepare_header(h,e));
+    msg->set_prepared(true);
+
+    ec = lib::error_code();
+    return msg;
+}
+
+template <typename connection, typename config>
+typename endpoint<connection,config>::message_ptr
+endpoint<connection,config>::prepare_broadcast(std::string const & payload,
+    frame::opcode::value op)
+{
+    lib::error_code ec;
+    message_ptr msg = prepare_broadcast(payload,op,ec);
+    if (ec) { throw exception(ec); }
+    return msg;
+}
+
 template <typename connection, typename config>
 void endpoint<connection,config>::close(connection_hdl hdl, close::status::value
     const code, std::string const & reason,
@@ -0,0 +1,551 @@
+/*
+ * Copyright (c) 2014, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_LOGGER_ASYNC_HPP
+#define WEBSOCKETPP_LOGGER_ASYNC_HPP
+
+#include <websocketpp/logger/levels.hpp>
+
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/time.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace websocketpp {
+namespace log {
+
+/// Implementation details of the async logger
+namespace async_detail {
+
+/// Single producer, single consumer ring of log records
+/**
+ * Records are a 16 byte header followed by the message text, padded to a
+ * multiple of 16 bytes. A record that would straddle the end of the buffer
+ * is preceded by a padding record (channel 0) that fills the rest of it.
+ * Only the owning thread pushes and only the flusher drains, so neither side
+ * takes a lock.
+ */
+class ring {
+public:
+    /// Create a ring holding `capacity` bytes, a power of two of at least 64
+    explicit ring(size_t capacity)
+      : m_data(new char[capacity])
+      , m_mask(capacity - 1)
+      , m_head(0)
+      , m_tail(0) {}
+
+    ~ring() {
+        delete[] m_data;
+    }
+
+    /// Append a record. Returns false if there is not enough free space.
+    bool push(level channel, int64_t time, char const * msg, size_t len) {
+        size_t const capacity = m_mask + 1;
+        size_t const size = record_size(len);
+        if (size > capacity) {
+            return false;
+        }
+
+        size_t const head = m_head.load(std::memory_order_relaxed);
+        size_t const tail = m_tail.load(std::memory_order_acquire);
+        size_t offset = head & m_mask;
+        size_t const pad = (capacity - offset < size) ? capacity - offset : 0;
+
+        if (head + pad + size - tail > capacity) {
+            return false;
+        }
+
+        if (pad) {
+            write_header(offset, pad - header_size, 0, 0);
+            offset = 0;
+        }
+        write_header(offset, len, channel, time);
+        std::memcpy(m_data + offset + header_size, msg, len);
+
+        m_head.store(head + pad + size, std::memory_order_release);
+        return true;
+    }
+
+    /// Bytes in use, as seen by the producer
+    size_t used() const {
+        return m_head.load(std::memory_order_relaxed) -
+               m_tail.load(std::memory_order_relaxed);
+    }
+
+    size_t capacity() const {
+        return m_mask + 1;
+    }
+
+    /// Pass every record to `sink(channel, time, msg, len)` and free them
+    template <typename sink_type>
+    void drain(sink_type & sink) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t const head = m_head.load(std::memory_order_acquire);
+
+        while (tail != head) {
+            size_t const offset = tail & m_mask;
+            header h;
+            std::memcpy(&h, m_data + offset, header_size);
+            if (h.channel != 0) {
+                sink(h.channel, h.time, m_data + offset + header_size, h.len);
+            }
+            tail += record_size(h.len);
+        }
+
+        m_tail.store(tail, std::memory_order_release);
+    }
+private:
+    struct header {
+        uint32_t len;
+        level channel;
+        int64_t time;
+    };
+
+    static size_t const header_size = sizeof(header);
+
+    static size_t record_size(size_t len) {
+        return (header_size + len + header_size - 1) & ~(header_size - 1);
+    }
+
+    void write_header(size_t offset, size_t len, level channel, int64_t time) {
+        header h;
+        h.len = static_cast<uint32_t>(len);
+        h.channel = channel;
+        h.time = time;
+        std::memcpy(m_data + offset, &h, header_size);
+    }
+
+    // not copyable
+    ring(ring const &);
+    ring & operator=(ring const &);
+
+    char * const m_data;
+    size_t const m_mask;
+
+    // head and tail on their own cache lines so the producer and the flusher
+    // do not contend for them
+    char m_pad0[64];
+    std::atomic<size_t> m_head;
+    char m_pad1[64];
+    std::atomic<size_t> m_tail;
+    char m_pad2[64];
+};
+
+/// A logger's ring for the calling thread
+struct ring_slot {
+    uint64_t owner;
+    ring * r;
+};
+
+/// Per thread cache of the rings of the loggers it used most recently
+struct thread_rings {
+    static size_t const slot_count = 8;
+    ring_slot slots[slot_count];
+    size_t next;
+};
+
+inline thread_rings & local_rings() {
+    static thread_local thread_rings rings;
+    return rings;
+}
+
+/// Unique, never reused logger ids, so a stale cache slot can not match
+inline uint64_t next_logger_id() {
+    static std::atomic<uint64_t> next(0);
+    return next.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+} // namespace async_detail
+
+/// Logger that hands messages to a background thread through per thread rings
+/**
+ * Each thread that writes to the logger gets its own lock free ring buffer
+ * the first time it does, so writing a message is a copy into that ring and
+ * never waits on other threads or on the output stream. A background thread,
+ * started with the first message, drains the rings every flush interval (or
+ * sooner when a ring is half full), formats the messages like the basic
+ * logger and writes them to the ostream. Messages from one thread keep their
+ * order; messages from different threads are only ordered per drain pass.
+ * When a ring is full the message is dropped and counted (see get_dropped).
+ *
+ * `static_channels` is fixed at compile time. Writes to channels outside it
+ * and static_test() calls for them reduce to constants, so the library's
+ * logging code for those channels is removed entirely. The constructor's
+ * channel argument further restricts the channels that may be enabled at
+ * runtime, as it does for the basic logger.
+ *
+ * The concurrency policy parameter is accepted for compatibility with the
+ * other loggers; this logger always synchronizes internally. Requires C++11.
+ */
+template <typename concurrency, typename names,
+    level static_channels = 0xffffffff>
+class async {
+public:
+    /// Default size of each thread's ring in bytes
+    static size_t const default_ring_size = 64 * 1024;
+    /// Default time between flushes in milliseconds
+    static long const default_flush_interval = 10;
+
+    async<concurrency,names,static_channels>(channel_type_hint::value h =
+        channel_type_hint::access)
+      : m_static_channels(0xffffffff)
+      , m_dynamic_channels(0)
+      , m_out(h == channel_type_hint::error ? &std::cerr : &std::cout)
+    {
+        init();
+    }
+
+    async<concurrency,names,static_channels>(std::ostream * out)
+      : m_static_channels(0xffffffff)
+      , m_dynamic_channels(0)
+      , m_out(out)
+    {
+        init();
+    }
+
+    async<concurrency,names,static_channels>(level c,
+        channel_type_hint::value h = channel_type_hint::access)
+      : m_static_channels(c)
+      , m_dynamic_channels(0)
+      , m_out(h == channel_type_hint::error ? &std::cerr : &std::cout)
+    {
+        init();
+    }
+
+    async<concurrency,names,static_channels>(level c, std::ostream * out)
+      : m_static_channels(c)
+      , m_dynamic_channels(0)
+      , m_out(out)
+    {
+        init();
+    }
+
+    /// Copy constructor
+    /**
+     * The copy has the same channels, stream and settings but its own rings
+     * and flusher; messages already written stay with the original.
+     */
+    async<concurrency,names,static_channels>(
+        async<concurrency,names,static_channels> const & other)
+      : m_static_channels(other.m_static_channels)
+      , m_dynamic_channels(other.m_dynamic_channels.load())
+      , m_out(other.m_out)
+    {
+        init();
+        m_ring_size = other.m_ring_size;
+        m_flush_interval = other.m_flush_interval;
+    }
+
+    /// Destructor
+    /**
+     * Stops the flusher and writes out every message still queued.
+     */
+    ~async<concurrency,names,static_channels>() {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_stop = true;
+        }
+        m_wake.notify_one();
+        if (m_flusher.joinable()) {
+            m_flusher.join();
+        }
+        flush();
+
+        for (size_t i = 0; i < m_rings.size(); i++) {
+            delete m_rings[i].second;
+        }
+    }
+
+    void set_ostream(std::ostream * out = &std::cout) {
+        std::lock_guard<std::mutex> lock(m_flush_lock);
+        m_out = out;
+    }
+
+    /// Set the size of the rings created for threads that have not logged yet
+    /**
+     * @param bytes Ring size, rounded up to a power of two of at least 64.
+     * Messages larger than a ring are always dropped.
+     */
+    void set_ring_size(size_t bytes) {
+        size_t size = 64;
+        while (size < bytes) {
+            size <<= 1;
+        }
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_ring_size = size;
+    }
+
+    /// Set the longest time a message waits before it is written out
+    /**
+     * @param ms The flush interval in milliseconds
+     */
+    void set_flush_interval(long ms) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_flush_interval = ms;
+    }
+
+    /// Number of messages dropped because the writing thread's ring was full
+    uint64_t get_dropped() const {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+    void set_channels(level channels) {
+        if (channels == names::none) {
+            clear_channels(names::all);
+            return;
+        }
+
+        m_dynamic_channels.fetch_or(channels & m_static_channels,
+            std::memory_order_relaxed);
+    }
+
+    void clear_channels(level channels) {
+        m_dynamic_channels.fetch_and(~channels, std::memory_order_relaxed);
+    }
+
+    /// Write a string message to the given channel
+    /**
+     * @param channel The channel to write to
+     * @param msg The message to write
+     */
+    void write(level channel, std::string const & msg) {
+        if ((channel & static_channels) == 0) { return; }
+        append(channel, msg.data(), msg.size());
+    }
+
+    /// Write a cstring message to the given channel
+    /**
+     * @param channel The channel to write to
+     * @param msg The message to write
+     */
+    void write(level channel, char const * msg) {
+        if ((channel & static_channels) == 0) { return; }
+        append(channel, msg, std::strlen(msg));
+    }
+
+    bool static_test(level channel) const {
+        return ((channel & static_channels) != 0) &&
+               ((channel & m_static_channels) != 0);
+    }
+
+    bool dynamic_test(level channel) {
+        return ((channel & static_channels) != 0) &&
+               ((channel & m_dynamic_channels.load(
+                    std::memory_order_relaxed)) != 0);
+    }
+
+    /// Write out every queued message now
+    /**
+     * Messages written by other threads while this runs may be left for
+     * the next flush.
+     */
+    void flush() {
+        std::lock_guard<std::mutex> guard(m_flush_lock);
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_flush_rings.clear();
+            for (size_t i = 0; i < m_rings.size(); i++) {
+                m_flush_rings.push_back(m_rings[i].second);
+            }
+        }
+
+        m_text.clear();
+        formatter sink(*this);
+        for (size_t i = 0; i < m_flush_rings.size(); i++) {
+            m_flush_rings[i]->drain(sink);
+        }
+
+        if (!m_text.empty() && m_out) {
+            m_out->write(m_text.data(), m_text.size());
+            m_out->flush();
+        }
+    }
+
+private:
+    typedef std::pair<std::thread::id,async_detail::ring *> thread_ring;
+
+    void init() {
+        m_id = async_detail::next_logger_id();
+        m_ring_size = default_ring_size;
+        m_flush_interval = default_flush_interval;
+        m_dropped.store(0);
+        m_stop = false;
+        m_stamp_time = 0;
+    }
+
+    /// Appends drained records to m_text
+    struct formatter {
+        explicit formatter(async & l) : logger(l) {}
+
+        void operator()(level channel, int64_t time, char const * msg,
+            size_t len)
+        {
+            logger.format(channel, time, msg, len);
+        }
+
+        async & logger;
+    };
+
+    /// Format one drained record. Lock: m_flush_lock
+    void format(level channel, int64_t time, char const * msg, size_t len) {
+        if (time != m_stamp_time || m_stamp.empty()) {
+            m_stamp_time = time;
+            m_stamp = timestamp(static_cast<std::time_t>(time));
+        }
+        m_text.append(m_stamp);
+        m_text.append("[");
+        m_text.append(names::channel_name(channel));
+        m_text.append("] ");
+        m_text.append(msg, len);
+        m_text.append("\n");
+    }
+
+    void append(level channel, char const * msg, size_t len) {
+        if ((channel & m_dynamic_channels.load(std::memory_order_relaxed))
+            == 0)
+        {
+            return;
+        }
+
+        async_detail::ring * r = local_ring();
+        if (!r || !r->push(channel, static_cast<int64_t>(std::time(NULL)),
+            msg, len))
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        if (r->used() > r->capacity() / 2) {
+            m_wake.notify_one();
+        }
+    }
+
+    /// The calling thread's ring, registering one on first use
+    async_detail::ring * local_ring() {
+        async_detail::thread_rings & cache = async_detail::local_rings();
+        for (size_t i = 0; i < async_detail::thread_rings::slot_count; i++) {
+            if (cache.slots[i].owner == m_id) {
+                return cache.slots[i].r;
+            }
+        }
+
+        async_detail::ring * r = register_ring();
+        if (r) {
+            async_detail::ring_slot & slot = cache.slots[cache.next++ %
+                async_detail::thread_rings::slot_count];
+            slot.owner = m_id;
+            slot.r = r;
+        }
+        return r;
+    }
+
+    async_detail::ring * register_ring() {
+        std::thread::id const self = std::this_thread::get_id();
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_stop) {
+            return NULL;
+        }
+
+        // a thread whose cache slot was evicted keeps its ring
+        for (size_t i = 0; i < m_rings.size(); i++) {
+            if (m_rings[i].first == self) {
+                return m_rings[i].second;
+            }
+        }
+
+        async_detail::ring * r = new async_detail::ring(m_ring_size);
+        m_rings.push_back(thread_ring(self,r));
+
+        if (!m_flusher.joinable()) {
+            m_flusher = std::thread(&async::run, this);
+        }
+        return r;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(m_lock);
+        while (!m_stop) {
+            m_wake.wait_for(lock, std::chrono::milliseconds(m_flush_interval));
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    // The timestamp does not include the time zone, see basic.
+    static std::string timestamp(std::time_t t) {
+        std::tm lt = lib::localtime(t);
+        char buffer[24];
+        size_t result = std::strftime(buffer,sizeof(buffer),
+            "[%Y-%m-%d %H:%M:%S] ",&lt);
+        return result == 0 ? std::string("[Unknown] ") : std::string(buffer);
+    }
+
+    // no copy assignment operator because of const member variables
+    async<concurrency,names,static_channels> & operator=(
+        async<concurrency,names,static_channels> const &);
+
+    level const m_static_channels;
+    std::atomic<level> m_dynamic_channels;
+    std::atomic<uint64_t> m_dropped;
+    uint64_t m_id;
+
+    /// Lock: m_lock
+    std::vector<thread_ring> m_rings;
+    size_t m_ring_size;
+    long m_flush_interval;
+    bool m_stop;
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::thread m_flusher;
+
+    /// Lock: m_flush_lock
+    std::ostream * m_out;
+    std::vector<async_detail::ring *> m_flush_rings;
+    std::string m_text;
+    std::string m_stamp;
+    int64_t m_stamp_time;
+    std::mutex m_flush_lock;
+};
+
+} // log
+} // websocketpp
+
+#endif // WEBSOCKETPP_LOGGER_ASYNC_HPP
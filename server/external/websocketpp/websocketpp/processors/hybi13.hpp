@@ -42,6 +42,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <utility>
@@ -85,6 +86,11 @@ public:
         return m_permessage_deflate.is_implemented();
     }
 
+    extensions::permessage_deflate::stats get_permessage_deflate_stats() const
+    {
+        return m_permessage_deflate.get_stats();
+    }
+
     err_str_pair negotiate_extensions(request_type const & request) {
         return negotiate_extensions_helper(request);
     }
@@ -128,6 +134,14 @@ public:
         // look through the list of extension requests to find the first
         // one that we can accept.
         if (m_permessage_deflate.is_implemented()) {
+            // Start from the local policy. Invalid settings fail negotiation
+            // of the extension, which leaves the connection uncompressed.
+            ret.first = m_permessage_deflate.set_options(
+                base::m_permessage_deflate_options);
+            if (ret.first) {
+                return ret;
+            }
+
             err_str_pair neg_ret;
             for (it = p.begin(); it != p.end(); ++it) {
                 // not a permessage-deflate extension request, ignore
@@ -209,15 +223,11 @@ public:
     lib::error_code process_handshake(request_type const & request, 
         std::string const & subprotocol, response_type & response) const
     {
-        std::string server_key = request.get_header("Sec-WebSocket-Key");
-
-        lib::error_code ec = process_handshake_key(server_key);
+        char accept[accept_key_size];
+        compute_accept_key(request.get_header("Sec-WebSocket-Key"),accept);
 
-        if (ec) {
-            return ec;
-        }
-
-        response.replace_header("Sec-WebSocket-Accept",server_key);
+        response.replace_header("Sec-WebSocket-Accept",
+            std::string(accept,accept_key_size));
         response.append_header("Upgrade",constants::upgrade_token);
         response.append_header("Connection",constants::connection_token);
 
@@ -309,10 +319,13 @@ public:
         }
 
         // And has a valid Sec-WebSocket-Accept value
-        std::string key = req.get_header("Sec-WebSocket-Key");
-        lib::error_code ec = process_handshake_key(key);
+        char accept[accept_key_size];
+        compute_accept_key(req.get_header("Sec-WebSocket-Key"),accept);
 
-        if (ec || key != res.get_header("Sec-WebSocket-Accept")) {
+        std::string const & accept_header = res.get_header("Sec-WebSocket-Accept");
+        if (accept_header.size() != accept_key_size ||
+            std::memcmp(accept_header.data(),accept,accept_key_size) != 0)
+        {
             return error::make_error_code(error::missing_required_header);
         }
 
@@ -626,7 +639,8 @@ public:
         frame::masking_key_type key;
         bool masked = !base::m_server;
         bool compressed = m_permessage_deflate.is_enabled()
-                          && in->get_compressed();
+                          && in->get_compressed()
+                          && m_permessage_deflate.should_compress(i.size());
         bool fin = in->get_fin();
 
         if (masked) {
@@ -639,7 +653,10 @@ public:
         // prepare payload
         if (compressed) {
             // compress and store in o after header.
-            m_permessage_deflate.compress(i,o);
+            lib::error_code ec = m_permessage_deflate.compress(i,o);
+            if (ec) {
+                return ec;
+            }
 
             if (o.size() < 4) {
                 return make_error_code(error::general);
@@ -729,13 +746,40 @@ public:
         return this->prepare_control(frame::opcode::CLOSE,payload,out);
     }
 protected:
-    /// Convert a client handshake key into a server response key in place
-    lib::error_code process_handshake_key(std::string & key) const {
-        key.append(constants::handshake_guid);
+    /// Length of a Sec-WebSocket-Accept value
+    static size_t const accept_key_size = 28;
 
+    /// Compute the Sec-WebSocket-Accept value for a client handshake key
+    /**
+     * The key and handshake GUID are hashed from a stack buffer and the
+     * digest is base64 encoded straight into `accept`, so valid keys are
+     * processed without allocating.
+     *
+     * @param [in] key The client's Sec-WebSocket-Key
+     * @param [out] accept Buffer of accept_key_size characters for the result
+     */
+    static void compute_accept_key(std::string const & key, char * accept) {
+        size_t const guid_size = sizeof(constants::handshake_guid)-1;
         unsigned char message_digest[20];
-        sha1::calc(key.c_str(),key.length(),message_digest);
-        key = base64_encode(message_digest,20);
+        char input[128];
+
+        if (key.size() + guid_size <= sizeof(input)) {
+            std::memcpy(input,key.data(),key.size());
+            std::memcpy(input+key.size(),constants::handshake_guid,guid_size);
+            sha1::calc(input,key.size()+guid_size,message_digest);
+        } else {
+            std::string long_input = key + constants::handshake_guid;
+            sha1::calc(long_input.data(),long_input.size(),message_digest);
+        }
+
+        base64_encode(message_digest,20,accept);
+    }
+
+    /// Convert a client handshake key into a server response key in place
+    lib::error_code process_handshake_key(std::string & key) const {
+        char accept[accept_key_size];
+        compute_accept_key(key,accept);
+        key.assign(accept,accept_key_size);
 
         return lib::error_code();
     }
@@ -800,9 +844,8 @@ protected:
     {
         // unmask if masked
         if (frame::get_masked(m_basic_header)) {
-            m_current_msg->prepared_key = frame::byte_mask_circ(
+            m_current_msg->prepared_key = frame::word_mask_circ(
                 buf, len, m_current_msg->prepared_key);
-            // TODO: SIMD masking
         }
 
         std::string & out = m_current_msg->msg_ptr->get_raw_payload();
@@ -952,7 +995,8 @@ protected:
 
     /// Copy and mask/unmask in one operation
     /**
-     * Reads input from one string and writes unmasked output to another.
+     * Reads input from one string and writes unmasked output to another. o
+     * must be at least as long as i and may be the same string.
      *
      * @param [in] i The input string.
      * @param [out] o The output string.
@@ -961,8 +1005,12 @@ protected:
     void masked_copy (std::string const & i, std::string & o,
         frame::masking_key_type key) const
     {
-        frame::byte_mask(i.begin(),i.end(),o.begin(),key);
-        // TODO: SIMD masking
+        if (i.empty()) {
+            return;
+        }
+        frame::word_mask_exact(
+            reinterpret_cast<uint8_t *>(const_cast<char *>(i.data())),
+            reinterpret_cast<uint8_t *>(&o[0]), i.size(), key);
     }
 
     /// Generic prepare control frame with opcode and payload.
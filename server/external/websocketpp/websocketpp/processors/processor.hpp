@@ -32,9 +32,12 @@
 #include <websocketpp/common/system_error.hpp>
 
 #include <websocketpp/close.hpp>
+#include <websocketpp/extensions/permessage_deflate/options.hpp>
 #include <websocketpp/utilities.hpp>
 #include <websocketpp/uri.hpp>
 
+#include <cctype>
+#include <climits>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -113,14 +116,33 @@ int get_websocket_version(request_type& r) {
         return 0;
     }
 
-    int version;
-    std::istringstream ss(r.get_header("Sec-WebSocket-Version"));
+    // Parse the way `std::istream >> int` would, without building a stream
+    std::string const & header = r.get_header("Sec-WebSocket-Version");
+    std::string::const_iterator it = header.begin();
 
-    if ((ss >> version).fail()) {
+    while (it != header.end() && std::isspace(static_cast<unsigned char>(*it))) {
+        ++it;
+    }
+
+    bool negative = false;
+    if (it != header.end() && (*it == '+' || *it == '-')) {
+        negative = (*it == '-');
+        ++it;
+    }
+
+    if (it == header.end() || !std::isdigit(static_cast<unsigned char>(*it))) {
         return -1;
     }
 
-    return version;
+    long version = 0;
+    for (; it != header.end() && std::isdigit(static_cast<unsigned char>(*it)); ++it) {
+        version = version * 10 + (*it - '0');
+        if (version > INT_MAX) {
+            return -1;
+        }
+    }
+
+    return static_cast<int>(negative ? -version : version);
 }
 
 /// Extract a URI ptr from the host header of the request
@@ -204,6 +226,39 @@ public:
         m_max_message_size = new_value;
     }
 
+    /// Get the permessage-deflate policy used during extension negotiation
+    /**
+     * @return The policy, default constructed unless set
+     */
+    extensions::permessage_deflate::options const &
+        get_permessage_deflate_options() const
+    {
+        return m_permessage_deflate_options;
+    }
+
+    /// Set the permessage-deflate policy used during extension negotiation
+    /**
+     * Must be set before the handshake is negotiated to have any effect.
+     * Processors that don't support permessage-deflate ignore it.
+     *
+     * @param opts The policy to apply
+     */
+    void set_permessage_deflate_options(
+        extensions::permessage_deflate::options const & opts)
+    {
+        m_permessage_deflate_options = opts;
+    }
+
+    /// Get the permessage-deflate compression totals for this connection
+    /**
+     * @return The totals, all zero unless permessage-deflate is in use
+     */
+    virtual extensions::permessage_deflate::stats
+        get_permessage_deflate_stats() const
+    {
+        return extensions::permessage_deflate::stats();
+    }
+
     /// Returns whether or not the permessage_compress extension is implemented
     /**
      * Compile time flag that indicates whether this processor has implemented
@@ -399,6 +454,7 @@ protected:
     bool const m_secure;
     bool const m_server;
     size_t m_max_message_size;
+    extensions::permessage_deflate::options m_permessage_deflate_options;
 };
 
 } // namespace processor
@@ -36,6 +36,20 @@ under the same license as the original, which is listed below.
 #ifndef SHA1_DEFINED
 #define SHA1_DEFINED
 
+#include <websocketpp/common/cpu.hpp>
+#include <websocketpp/common/stdint.hpp>
+
+#include <cstddef>
+#include <cstring>
+
+// SHA extensions kernel, compiled per function when the compiler can target
+// it and used when the CPU supports it at run time. Define
+// _WEBSOCKETPP_NO_SHA_EXTENSIONS_ to always use the portable code.
+#if !defined(_WEBSOCKETPP_NO_SHA_EXTENSIONS_) && \
+    defined(_WEBSOCKETPP_TARGET_SHA_)
+    #define _WEBSOCKETPP_SHA_EXTENSIONS_
+#endif
+
 namespace websocketpp {
 namespace sha1 {
 
@@ -46,16 +60,6 @@ inline unsigned int rol(unsigned int value, unsigned int steps) {
     return ((value << steps) | (value >> (32 - steps)));
 }
 
-// Sets the first 16 integers in the buffert to zero.
-// Used for clearing the W buffert.
-inline void clearWBuffert(unsigned int * buffert)
-{
-    for (int pos = 16; --pos >= 0;)
-    {
-        buffert[pos] = 0;
-    }
-}
-
 inline void innerHash(unsigned int * result, unsigned int * w)
 {
     unsigned int a = result[0];
@@ -115,16 +119,158 @@ inline void innerHash(unsigned int * result, unsigned int * w)
     result[4] += e;
 }
 
+// Hash whole 64 byte blocks with the portable code
+inline void process_blocks_scalar(unsigned int * result,
+    unsigned char const * sarray, size_t blocks)
+{
+    // The reusable round buffer
+    unsigned int w[80];
+
+    for (size_t currentBlock = 0; blocks > 0; --blocks) {
+        size_t const endCurrentBlock = currentBlock + 64;
+
+        // Init the round buffer with the 64 byte block data.
+        for (int roundPos = 0; currentBlock < endCurrentBlock; currentBlock += 4)
+        {
+            // This line will swap endian on big endian and keep endian on
+            // little endian.
+            w[roundPos++] = (unsigned int) sarray[currentBlock + 3]
+                    | (((unsigned int) sarray[currentBlock + 2]) << 8)
+                    | (((unsigned int) sarray[currentBlock + 1]) << 16)
+                    | (((unsigned int) sarray[currentBlock]) << 24);
+        }
+        innerHash(result, w);
+    }
+}
+
+#ifdef _WEBSOCKETPP_SHA_EXTENSIONS_
+// Four rounds of a block after the first sixteen. Computes the schedule for
+// later rounds as it goes; the extra schedule work in the last rounds is
+// harmless.
+#define WEBSOCKETPP_SHA1_ROUNDS4(e_in, e_out, m0, m1, m2, m3, func) \
+    e_in = _mm_sha1nexte_epu32(e_in, m0); \
+    e_out = abcd; \
+    m1 = _mm_sha1msg2_epu32(m1, m0); \
+    abcd = _mm_sha1rnds4_epu32(abcd, e_in, func); \
+    m3 = _mm_sha1msg1_epu32(m3, m0); \
+    m2 = _mm_xor_si128(m2, m0);
+
+// Hash whole 64 byte blocks with the SHA extensions. Must only be called
+// after lib::cpu::has_sha() returned true.
+_WEBSOCKETPP_TARGET_SHA_
+inline void process_blocks_sha(unsigned int * result,
+    unsigned char const * data, size_t blocks)
+{
+    __m128i const mask = _mm_set_epi64x(0x0001020304050607LL,
+        0x08090a0b0c0d0e0fLL);
+
+    __m128i abcd = _mm_loadu_si128(reinterpret_cast<__m128i const *>(result));
+    __m128i e0 = _mm_set_epi32(static_cast<int>(result[4]), 0, 0, 0);
+    abcd = _mm_shuffle_epi32(abcd, 0x1B);
+
+    for (; blocks > 0; --blocks, data += 64) {
+        __m128i const abcd_save = abcd;
+        __m128i const e0_save = e0;
+        __m128i e1, m0, m1, m2, m3;
+
+        // Rounds 0-15 load the message
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128(
+            reinterpret_cast<__m128i const *>(data)), mask);
+        e0 = _mm_add_epi32(e0, m0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128(
+            reinterpret_cast<__m128i const *>(data + 16)), mask);
+        e1 = _mm_sha1nexte_epu32(e1, m1);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        m0 = _mm_sha1msg1_epu32(m0, m1);
+
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128(
+            reinterpret_cast<__m128i const *>(data + 32)), mask);
+        e0 = _mm_sha1nexte_epu32(e0, m2);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        m1 = _mm_sha1msg1_epu32(m1, m2);
+        m0 = _mm_xor_si128(m0, m2);
+
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128(
+            reinterpret_cast<__m128i const *>(data + 48)), mask);
+        WEBSOCKETPP_SHA1_ROUNDS4(e1, e0, m3, m0, m1, m2, 0)
+
+        // Rounds 16-79
+        WEBSOCKETPP_SHA1_ROUNDS4(e0, e1, m0, m1, m2, m3, 0)
+        WEBSOCKETPP_SHA1_ROUNDS4(e1, e0, m1, m2, m3, m0, 1)
+        WEBSOCKETPP_SHA1_ROUNDS4(e0, e1, m2, m3, m0, m1, 1)
+        WEBSOCKETPP_SHA1_ROUNDS4(e1, e0, m3, m0, m1, m2, 1)
+        WEBSOCKETPP_SHA1_ROUNDS4(e0, e1, m0, m1, m2, m3, 1)
+        WEBSOCKETPP_SHA1_ROUNDS4(e1, e0, m1, m2, m3, m0, 1)
+        WEBSOCKETPP_SHA1_ROUNDS4(e0, e1, m2, m3, m0, m1, 2)
+        WEBSOCKETPP_SHA1_ROUNDS4(e1, e0, m3, m0, m1, m2, 2)
+        WEBSOCKETPP_SHA1_ROUNDS4(e0, e1, m0, m1, m2, m3, 2)
+        WEBSOCKETPP_SHA1_ROUNDS4(e1, e0, m1, m2, m3, m0, 2)
+        WEBSOCKETPP_SHA1_ROUNDS4(e0, e1, m2, m3, m0, m1, 2)
+        WEBSOCKETPP_SHA1_ROUNDS4(e1, e0, m3, m0, m1, m2, 3)
+        WEBSOCKETPP_SHA1_ROUNDS4(e0, e1, m0, m1, m2, m3, 3)
+        WEBSOCKETPP_SHA1_ROUNDS4(e1, e0, m1, m2, m3, m0, 3)
+        WEBSOCKETPP_SHA1_ROUNDS4(e0, e1, m2, m3, m0, m1, 3)
+        WEBSOCKETPP_SHA1_ROUNDS4(e1, e0, m3, m0, m1, m2, 3)
+
+        // Combine state
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    abcd = _mm_shuffle_epi32(abcd, 0x1B);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(result), abcd);
+    result[4] = static_cast<unsigned int>(_mm_extract_epi32(e0, 3));
+}
+
+#undef WEBSOCKETPP_SHA1_ROUNDS4
+#endif // _WEBSOCKETPP_SHA_EXTENSIONS_
+
 } // namespace
 
-/// Calculate a SHA1 hash
+/// Instruction set used to compute hashes
+namespace isa {
+    enum value {
+        /// Portable code
+        scalar = 0,
+        /// x86 SHA extensions
+        sha = 1
+    };
+} // namespace isa
+
+/// Detect the best SHA1 instruction set supported by this CPU
 /**
+ * The CPU is queried once (see lib::cpu). Always returns scalar if the SHA
+ * extensions are disabled or the compiler can not target them.
+ *
+ * @return The instruction set that calc uses
+ */
+inline isa::value get_isa() {
+#ifdef _WEBSOCKETPP_SHA_EXTENSIONS_
+    return lib::cpu::has_sha() ? isa::sha : isa::scalar;
+#else
+    return isa::scalar;
+#endif
+}
+
+/// Calculate a SHA1 hash with a specific instruction set
+/**
+ * Requesting an instruction set that get_isa() does not report falls back to
+ * the portable code.
+ *
  * @param src points to any kind of data to be hashed.
  * @param bytelength the number of bytes to hash from the src pointer.
  * @param hash should point to a buffer of at least 20 bytes of size for storing
  * the sha1 result in.
+ * @param use The instruction set to use
  */
-inline void calc(void const * src, size_t bytelength, unsigned char * hash) {
+inline void calc(void const * src, size_t bytelength, unsigned char * hash,
+    isa::value use)
+{
     // Init the result array.
     unsigned int result[5] = { 0x67452301, 0xefcdab89, 0x98badcfe,
                                0x10325476, 0xc3d2e1f0 };
@@ -132,49 +278,36 @@ inline void calc(void const * src, size_t bytelength, unsigned char * hash) {
     // Cast the void src pointer to be the byte array we can work with.
     unsigned char const * sarray = (unsigned char const *) src;
 
-    // The reusable round buffer
-    unsigned int w[80];
+    void (*process_blocks)(unsigned int *, unsigned char const *, size_t) =
+        &process_blocks_scalar;
+#ifdef _WEBSOCKETPP_SHA_EXTENSIONS_
+    if (use == isa::sha && lib::cpu::has_sha()) {
+        process_blocks = &process_blocks_sha;
+    }
+#else
+    (void)use;
+#endif
 
     // Loop through all complete 64byte blocks.
+    size_t const fullBlocks = bytelength / 64;
+    process_blocks(result, sarray, fullBlocks);
 
-    size_t endCurrentBlock;
-    size_t currentBlock = 0;
-
-    if (bytelength >= 64) {
-        size_t const endOfFullBlocks = bytelength - 64;
-
-        while (currentBlock <= endOfFullBlocks) {
-            endCurrentBlock = currentBlock + 64;
-
-            // Init the round buffer with the 64 byte block data.
-            for (int roundPos = 0; currentBlock < endCurrentBlock; currentBlock += 4)
-            {
-                // This line will swap endian on big endian and keep endian on
-                // little endian.
-                w[roundPos++] = (unsigned int) sarray[currentBlock + 3]
-                        | (((unsigned int) sarray[currentBlock + 2]) << 8)
-                        | (((unsigned int) sarray[currentBlock + 1]) << 16)
-                        | (((unsigned int) sarray[currentBlock]) << 24);
-            }
-            innerHash(result, w);
-        }
-    }
+    // Pad the last and not full 64 byte block into one or two blocks on the
+    // stack: a 0x80 byte, zeros and the message length in bits.
+    unsigned char tail[128];
+    size_t const lastBlockBytes = bytelength - fullBlocks * 64;
+    size_t const tailLength = (lastBlockBytes >= 56) ? 128 : 64;
 
-    // Handle the last and not full 64 byte block if existing.
-    endCurrentBlock = bytelength - currentBlock;
-    clearWBuffert(w);
-    size_t lastBlockBytes = 0;
-    for (;lastBlockBytes < endCurrentBlock; ++lastBlockBytes) {
-        w[lastBlockBytes >> 2] |= (unsigned int) sarray[lastBlockBytes + currentBlock] << ((3 - (lastBlockBytes & 3)) << 3);
-    }
+    std::memcpy(tail, sarray + fullBlocks * 64, lastBlockBytes);
+    tail[lastBlockBytes] = 0x80;
+    std::memset(tail + lastBlockBytes + 1, 0, tailLength - lastBlockBytes - 1);
 
-    w[lastBlockBytes >> 2] |= 0x80 << ((3 - (lastBlockBytes & 3)) << 3);
-    if (endCurrentBlock >= 56) {
-        innerHash(result, w);
-        clearWBuffert(w);
+    uint64_t const bitLength = static_cast<uint64_t>(bytelength) << 3;
+    for (int i = 0; i < 8; ++i) {
+        tail[tailLength - 1 - i] = (unsigned char)(bitLength >> (i * 8));
     }
-    w[15] = bytelength << 3;
-    innerHash(result, w);
+
+    process_blocks(result, tail, tailLength / 64);
 
     // Store hash in result pointer, and make sure we get in in the correct
     // order on both endian models.
@@ -183,6 +316,19 @@ inline void calc(void const * src, size_t bytelength, unsigned char * hash) {
     }
 }
 
+/// Calculate a SHA1 hash
+/**
+ * Uses the SHA extensions when the CPU supports them.
+ *
+ * @param src points to any kind of data to be hashed.
+ * @param bytelength the number of bytes to hash from the src pointer.
+ * @param hash should point to a buffer of at least 20 bytes of size for storing
+ * the sha1 result in.
+ */
+inline void calc(void const * src, size_t bytelength, unsigned char * hash) {
+    calc(src, bytelength, hash, get_isa());
+}
+
 } // namespace sha1
 } // namespace websocketpp
 
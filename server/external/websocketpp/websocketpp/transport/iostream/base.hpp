@@ -56,6 +56,17 @@ typedef lib::function<lib::error_code(connection_hdl, char const *, size_t)>
 typedef lib::function<lib::error_code(connection_hdl, std::vector<transport::buffer> const
     & bufs)> vector_write_handler;
 
+/// The type and signature of the callback used by iostream transport to start
+/// an asynchronous write.
+/**
+ * The buffers stay valid until the application reports the outcome of the
+ * write by calling `complete_write` on the connection. The library starts at
+ * most one write at a time, so while a write is outstanding new messages
+ * wait in the connection's send queue.
+ */
+typedef lib::function<void(connection_hdl, std::vector<transport::buffer> const
+    & bufs)> async_write_handler;
+
 /// The type and signature of the callback used by iostream transport to signal
 /// a transport shutdown.
 typedef lib::function<lib::error_code(connection_hdl)> shutdown_handler;
@@ -381,6 +381,48 @@ public:
         m_vector_write_handler = h;
     }
 
+    /// Sets the asynchronous write handler
+    /**
+     * The asynchronous write handler is called when the iostream transport has
+     * data to write, like the vectored write handler, but the write is not
+     * considered complete when the handler returns. The buffers remain valid
+     * and the library waits until the application calls `complete_write`.
+     *
+     * This lets an application that owns a real socket write straight from
+     * the library's buffers (scatter-gather, no copy), and lets the
+     * connection's send queue see actual backpressure: messages sent while
+     * a write is outstanding wait in the queue, where they can be conflated
+     * or counted against the buffered amount limit.
+     *
+     * The signature of the handler is
+     * `void (connection_hdl, std::vector<websocketpp::transport::buffer>
+     * const & bufs)`. A single buffer write is passed as a vector of one.
+     *
+     * When set, this handler takes precedence over the write handler and the
+     * vectored write handler.
+     *
+     * @param h The handler to call when data is to be written.
+     */
+    void set_async_write_handler(async_write_handler h) {
+        m_async_write_handler = h;
+    }
+
+    /// Report the outcome of a write started by the async write handler
+    /**
+     * Must be called exactly once for each call of the async write handler.
+     * The library may start the next write before this returns.
+     *
+     * @param ec The result of the write; an error fails the connection.
+     */
+    void complete_write(lib::error_code const & ec) {
+        transport::write_handler handler;
+        std::swap(handler, m_write_complete);
+        m_async_buffers.clear();
+        if (handler) {
+            handler(ec);
+        }
+    }
+
     /// Sets the shutdown handler
     /**
      * The shutdown handler is called when the iostream transport receives a
@@ -439,9 +481,12 @@ protected:
     void async_read_at_least(size_t num_bytes, char *buf, size_t len,
         read_handler handler)
     {
-        std::stringstream s;
-        s << "iostream_con async_read_at_least: " << num_bytes;
-        m_alog->write(log::alevel::devel,s.str());
+        // Called once per frame; skip formatting when devel is disabled
+        if (m_alog->dynamic_test(log::alevel::devel)) {
+            std::stringstream s;
+            s << "iostream_con async_read_at_least: " << num_bytes;
+            m_alog->write(log::alevel::devel,s.str());
+        }
 
         if (num_bytes > len) {
             handler(make_error_code(error::invalid_num_bytes),size_t(0));
@@ -498,6 +543,11 @@ protected:
             if (m_output_stream->bad()) {
                 ec = make_error_code(error::bad_stream);
             }
+        } else if (m_async_write_handler) {
+            m_async_buffers.assign(1,buffer(buf,len));
+            m_write_complete = handler;
+            m_async_write_handler(m_connection_hdl, m_async_buffers);
+            return;
         } else if (m_write_handler) {
             ec = m_write_handler(m_connection_hdl, buf, len);
         } else {
@@ -542,6 +592,10 @@ protected:
                     break;
                 }
             }
+        } else if (m_async_write_handler) {
+            m_write_complete = handler;
+            m_async_write_handler(m_connection_hdl, bufs);
+            return;
         } else if (m_vector_write_handler) {
             ec = m_vector_write_handler(m_connection_hdl, bufs);
         } else if (m_write_handler) {
@@ -689,6 +743,9 @@ private:
     connection_hdl  m_connection_hdl;
     write_handler   m_write_handler;
     vector_write_handler m_vector_write_handler;
+    async_write_handler m_async_write_handler;
+    transport::write_handler m_write_complete;
+    std::vector<buffer> m_async_buffers;
     shutdown_handler    m_shutdown_handler;
 
     bool            m_reading;
@@ -30,9 +30,22 @@
 #define UTF8_VALIDATOR_HPP
 
 #include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/cpu.hpp>
 
+#include <cstring>
 #include <string>
 
+// Vectorized validation. The ASCII fast path uses SSE2 whenever the compiler
+// targets it (8 byte words otherwise). The full SIMD validators need SSSE3 or
+// AVX2, are compiled per function and chosen at run time. Define
+// _WEBSOCKETPP_NO_SIMD_UTF8_ to use only the portable code.
+#if !defined(_WEBSOCKETPP_NO_SIMD_UTF8_) && defined(_WEBSOCKETPP_SSE2_)
+    #define _WEBSOCKETPP_SSE2_UTF8_
+    #ifdef _WEBSOCKETPP_TARGET_SIMD_
+        #define _WEBSOCKETPP_SIMD_UTF8_
+    #endif
+#endif
+
 namespace websocketpp {
 namespace utf8_validator {
 
@@ -77,6 +90,274 @@ inline uint32_t decode(uint32_t * state, uint32_t * codep, uint8_t byte) {
   return *state;
 }
 
+/// Length of the longest prefix of data that ends on a code point boundary
+/**
+ * Leaves out a trailing lead byte and its continuation bytes if the input
+ * ends before the sequence does.
+ *
+ * @param data The input
+ * @param length Length of data
+ * @return The length of the prefix
+ */
+inline size_t complete_prefix(uint8_t const * data, size_t length) {
+    for (size_t k = 1; k <= 3 && k <= length; ++k) {
+        uint8_t byte = data[length-k];
+        if ((byte & 0xC0) == 0x80) {
+            continue;
+        }
+        size_t need = byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : byte >= 0xC0 ? 2 : 1;
+        return need > k ? length-k : length;
+    }
+    return length;
+}
+
+#ifdef _WEBSOCKETPP_SIMD_UTF8_
+// Vectorized validation after Keiser and Lemire, "Validating UTF-8 In Less
+// Than One Instruction Per Byte" (2021). Each byte is classified by three
+// 16 entry table lookups (high nibble of the previous byte, low nibble of
+// the previous byte, high nibble of the byte itself) whose AND flags every
+// invalid two byte combination; a separate check catches missing or extra
+// continuation bytes of three and four byte sequences. Blocks of pure ASCII
+// skip all of that.
+
+/// Error bits of the lookup tables
+namespace simd_error {
+    static uint8_t const too_short = 1<<0;   // lead byte not followed by continuation
+    static uint8_t const too_long = 1<<1;    // ASCII followed by continuation
+    static uint8_t const overlong_3 = 1<<2;
+    static uint8_t const too_large = 1<<3;   // above U+10FFFF
+    static uint8_t const surrogate = 1<<4;
+    static uint8_t const overlong_2 = 1<<5;
+    static uint8_t const too_large_1000 = 1<<6;
+    static uint8_t const overlong_4 = 1<<6;
+    static uint8_t const two_conts = 1<<7;   // continuation after continuation
+    static uint8_t const carry = too_short | too_long | two_conts;
+} // namespace simd_error
+
+/// Table indexed by the high nibble of the previous byte
+#define _WEBSOCKETPP_UTF8_BYTE_1_HIGH_ \
+    simd_error::too_long, simd_error::too_long, simd_error::too_long, \
+    simd_error::too_long, simd_error::too_long, simd_error::too_long, \
+    simd_error::too_long, simd_error::too_long, \
+    simd_error::two_conts, simd_error::two_conts, simd_error::two_conts, \
+    simd_error::two_conts, \
+    simd_error::too_short | simd_error::overlong_2, \
+    simd_error::too_short, \
+    simd_error::too_short | simd_error::overlong_3 | simd_error::surrogate, \
+    simd_error::too_short | simd_error::too_large | \
+        simd_error::too_large_1000 | simd_error::overlong_4
+
+/// Table indexed by the low nibble of the previous byte
+#define _WEBSOCKETPP_UTF8_BYTE_1_LOW_ \
+    simd_error::carry | simd_error::overlong_3 | simd_error::overlong_2 | \
+        simd_error::overlong_4, \
+    simd_error::carry | simd_error::overlong_2, \
+    simd_error::carry, \
+    simd_error::carry, \
+    simd_error::carry | simd_error::too_large, \
+    simd_error::carry | simd_error::too_large | simd_error::too_large_1000, \
+    simd_error::carry | simd_error::too_large | simd_error::too_large_1000, \
+    simd_error::carry | simd_error::too_large | simd_error::too_large_1000, \
+    simd_error::carry | simd_error::too_large | simd_error::too_large_1000, \
+    simd_error::carry | simd_error::too_large | simd_error::too_large_1000, \
+    simd_error::carry | simd_error::too_large | simd_error::too_large_1000, \
+    simd_error::carry | simd_error::too_large | simd_error::too_large_1000, \
+    simd_error::carry | simd_error::too_large | simd_error::too_large_1000, \
+    simd_error::carry | simd_error::too_large | simd_error::too_large_1000 | \
+        simd_error::surrogate, \
+    simd_error::carry | simd_error::too_large | simd_error::too_large_1000, \
+    simd_error::carry | simd_error::too_large | simd_error::too_large_1000
+
+/// Table indexed by the high nibble of the current byte
+#define _WEBSOCKETPP_UTF8_BYTE_2_HIGH_ \
+    simd_error::too_short, simd_error::too_short, simd_error::too_short, \
+    simd_error::too_short, simd_error::too_short, simd_error::too_short, \
+    simd_error::too_short, simd_error::too_short, \
+    simd_error::too_long | simd_error::overlong_2 | simd_error::two_conts | \
+        simd_error::overlong_3 | simd_error::too_large_1000 | \
+        simd_error::overlong_4, \
+    simd_error::too_long | simd_error::overlong_2 | simd_error::two_conts | \
+        simd_error::overlong_3 | simd_error::too_large, \
+    simd_error::too_long | simd_error::overlong_2 | simd_error::two_conts | \
+        simd_error::surrogate | simd_error::too_large, \
+    simd_error::too_long | simd_error::overlong_2 | simd_error::two_conts | \
+        simd_error::surrogate | simd_error::too_large, \
+    simd_error::too_short, simd_error::too_short, simd_error::too_short, \
+    simd_error::too_short
+
+/// SSSE3 validation state for 16 byte blocks
+struct ssse3_state {
+    __m128i error;
+    __m128i prev_input;
+    __m128i prev_incomplete;
+};
+
+_WEBSOCKETPP_TARGET_SSSE3_
+inline void ssse3_check_block(ssse3_state & st, __m128i input) {
+    if (_mm_movemask_epi8(input) == 0) {
+        // ASCII: only a sequence left open by the previous block can fail
+        st.error = _mm_or_si128(st.error, st.prev_incomplete);
+        st.prev_incomplete = _mm_setzero_si128();
+        st.prev_input = input;
+        return;
+    }
+
+    __m128i const nibble = _mm_set1_epi8(0x0F);
+    __m128i const byte_1_high_table = _mm_setr_epi8(_WEBSOCKETPP_UTF8_BYTE_1_HIGH_);
+    __m128i const byte_1_low_table = _mm_setr_epi8(_WEBSOCKETPP_UTF8_BYTE_1_LOW_);
+    __m128i const byte_2_high_table = _mm_setr_epi8(_WEBSOCKETPP_UTF8_BYTE_2_HIGH_);
+
+    __m128i prev1 = _mm_alignr_epi8(input, st.prev_input, 15);
+    __m128i byte_1_high = _mm_shuffle_epi8(byte_1_high_table,
+        _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+    __m128i byte_1_low = _mm_shuffle_epi8(byte_1_low_table,
+        _mm_and_si128(prev1, nibble));
+    __m128i byte_2_high = _mm_shuffle_epi8(byte_2_high_table,
+        _mm_and_si128(_mm_srli_epi16(input, 4), nibble));
+    __m128i special = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low),
+        byte_2_high);
+
+    // bytes two and three places after a three or four byte lead must be
+    // continuations, and only those may be when not flagged above
+    __m128i prev2 = _mm_alignr_epi8(input, st.prev_input, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, st.prev_input, 13);
+    __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8(static_cast<char>(0xE0u-0x80)));
+    __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xF0u-0x80)));
+    __m128i must23 = _mm_and_si128(_mm_or_si128(third, fourth),
+        _mm_set1_epi8(static_cast<char>(0x80)));
+    st.error = _mm_or_si128(st.error, _mm_xor_si128(must23, special));
+
+    // a lead byte in the last three positions needs bytes from the next block
+    __m128i const max = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, static_cast<char>(0xF0u-1),
+        static_cast<char>(0xE0u-1), static_cast<char>(0xC0u-1));
+    st.prev_incomplete = _mm_subs_epu8(input, max);
+    st.prev_input = input;
+}
+
+/// Validate a complete UTF8 buffer with SSSE3
+/**
+ * Must only be called if lib::cpu::has_ssse3() is true.
+ *
+ * @param data The input
+ * @param length Length of data
+ * @return Whether data is valid UTF8 that ends on a code point boundary
+ */
+_WEBSOCKETPP_TARGET_SSSE3_
+inline bool validate_ssse3(uint8_t const * data, size_t length) {
+    ssse3_state st;
+    st.error = _mm_setzero_si128();
+    st.prev_input = _mm_setzero_si128();
+    st.prev_incomplete = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        ssse3_check_block(st, _mm_loadu_si128(
+            reinterpret_cast<__m128i const *>(data + i)));
+    }
+    if (i < length) {
+        // pad with ASCII, which ends any open sequence as too short
+        uint8_t tail[16] = {0};
+        std::memcpy(tail, data + i, length - i);
+        ssse3_check_block(st, _mm_loadu_si128(
+            reinterpret_cast<__m128i const *>(tail)));
+    }
+    st.error = _mm_or_si128(st.error, st.prev_incomplete);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(st.error, _mm_setzero_si128()))
+        == 0xFFFF;
+}
+
+/// AVX2 validation state for 32 byte blocks
+struct avx2_state {
+    __m256i error;
+    __m256i prev_input;
+    __m256i prev_incomplete;
+};
+
+_WEBSOCKETPP_TARGET_AVX2_
+inline void avx2_check_block(avx2_state & st, __m256i input) {
+    if (_mm256_movemask_epi8(input) == 0) {
+        // ASCII: only a sequence left open by the previous block can fail
+        st.error = _mm256_or_si256(st.error, st.prev_incomplete);
+        st.prev_incomplete = _mm256_setzero_si256();
+        st.prev_input = input;
+        return;
+    }
+
+    __m256i const nibble = _mm256_set1_epi8(0x0F);
+    __m256i const byte_1_high_table = _mm256_setr_epi8(
+        _WEBSOCKETPP_UTF8_BYTE_1_HIGH_, _WEBSOCKETPP_UTF8_BYTE_1_HIGH_);
+    __m256i const byte_1_low_table = _mm256_setr_epi8(
+        _WEBSOCKETPP_UTF8_BYTE_1_LOW_, _WEBSOCKETPP_UTF8_BYTE_1_LOW_);
+    __m256i const byte_2_high_table = _mm256_setr_epi8(
+        _WEBSOCKETPP_UTF8_BYTE_2_HIGH_, _WEBSOCKETPP_UTF8_BYTE_2_HIGH_);
+
+    // the previous block's high half followed by this block's low half, so
+    // alignr can shift bytes across the 128 bit lanes
+    __m256i carried = _mm256_permute2x128_si256(st.prev_input, input, 0x21);
+
+    __m256i prev1 = _mm256_alignr_epi8(input, carried, 15);
+    __m256i byte_1_high = _mm256_shuffle_epi8(byte_1_high_table,
+        _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+    __m256i byte_1_low = _mm256_shuffle_epi8(byte_1_low_table,
+        _mm256_and_si256(prev1, nibble));
+    __m256i byte_2_high = _mm256_shuffle_epi8(byte_2_high_table,
+        _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high,
+        byte_1_low), byte_2_high);
+
+    __m256i prev2 = _mm256_alignr_epi8(input, carried, 14);
+    __m256i prev3 = _mm256_alignr_epi8(input, carried, 13);
+    __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0u-0x80)));
+    __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0u-0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth),
+        _mm256_set1_epi8(static_cast<char>(0x80)));
+    st.error = _mm256_or_si256(st.error, _mm256_xor_si256(must23, special));
+
+    __m256i const max = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, static_cast<char>(0xF0u-1),
+        static_cast<char>(0xE0u-1), static_cast<char>(0xC0u-1));
+    st.prev_incomplete = _mm256_subs_epu8(input, max);
+    st.prev_input = input;
+}
+
+/// Validate a complete UTF8 buffer with AVX2
+/**
+ * Must only be called if lib::cpu::has_avx2() is true.
+ *
+ * @param data The input
+ * @param length Length of data
+ * @return Whether data is valid UTF8 that ends on a code point boundary
+ */
+_WEBSOCKETPP_TARGET_AVX2_
+inline bool validate_avx2(uint8_t const * data, size_t length) {
+    avx2_state st;
+    st.error = _mm256_setzero_si256();
+    st.prev_input = _mm256_setzero_si256();
+    st.prev_incomplete = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        avx2_check_block(st, _mm256_loadu_si256(
+            reinterpret_cast<__m256i const *>(data + i)));
+    }
+    if (i < length) {
+        // pad with ASCII, which ends any open sequence as too short
+        uint8_t tail[32] = {0};
+        std::memcpy(tail, data + i, length - i);
+        avx2_check_block(st, _mm256_loadu_si256(
+            reinterpret_cast<__m256i const *>(tail)));
+    }
+    st.error = _mm256_or_si256(st.error, st.prev_incomplete);
+    return _mm256_testz_si256(st.error, st.error) != 0;
+}
+
+#undef _WEBSOCKETPP_UTF8_BYTE_1_HIGH_
+#undef _WEBSOCKETPP_UTF8_BYTE_1_LOW_
+#undef _WEBSOCKETPP_UTF8_BYTE_2_HIGH_
+#endif // _WEBSOCKETPP_SIMD_UTF8_
+
 /// Provides streaming UTF8 validation functionality
 class validator {
 public:
@@ -117,6 +398,92 @@ public:
         return true;
     }
 
+    /// Advance validator state with input from a string iterator pair
+    /**
+     * String storage is contiguous, so this uses decode_bytes.
+     *
+     * @param begin Iterator to the start of the input range
+     * @param end Iterator to the end of the input range
+     * @return Whether or not decoding the bytes resulted in a validation error.
+     */
+    bool decode (std::string::const_iterator begin,
+        std::string::const_iterator end)
+    {
+        if (begin == end) {
+            return true;
+        }
+        return decode_bytes(reinterpret_cast<uint8_t const *>(&*begin),
+            static_cast<size_t>(end - begin));
+    }
+
+    /// Advance validator state with input from a string iterator pair
+    /**
+     * @see decode(std::string::const_iterator,std::string::const_iterator)
+     */
+    bool decode (std::string::iterator begin, std::string::iterator end) {
+        return decode(std::string::const_iterator(begin),
+            std::string::const_iterator(end));
+    }
+
+    /// Advance validator state with input from a buffer
+    /**
+     * Equivalent to decode on the byte range, but validates many bytes per
+     * step: whole ASCII blocks are skipped 16 bytes at a time (8 without
+     * SSE2), and with SSSE3 or AVX2 available, input beyond a sequence left
+     * open by the previous call is checked by a vectorized validator up to
+     * the last complete code point. The byte by byte state machine handles
+     * the rest, so a sequence may be split across calls.
+     *
+     * @param data The input
+     * @param length Length of data
+     * @return Whether or not decoding the bytes resulted in a validation error.
+     */
+    bool decode_bytes (uint8_t const * data, size_t length) {
+        size_t i = 0;
+
+        // finish a sequence left open by the previous call
+        while (i < length && m_state != utf8_accept) {
+            if (utf8_validator::decode(&m_state,&m_codepoint,data[i]) ==
+                utf8_reject)
+            {
+                return false;
+            }
+            ++i;
+        }
+
+#ifdef _WEBSOCKETPP_SIMD_UTF8_
+        if (length - i >= 32) {
+            bool avx2 = lib::cpu::has_avx2();
+            if (avx2 || lib::cpu::has_ssse3()) {
+                size_t n = complete_prefix(data+i,length-i);
+                bool valid = avx2 ? validate_avx2(data+i,n)
+                                  : validate_ssse3(data+i,n);
+                if (!valid) {
+                    m_state = utf8_reject;
+                    return false;
+                }
+                i += n;
+            }
+        }
+#endif
+
+        while (i < length) {
+            if (m_state == utf8_accept) {
+                i += ascii_prefix(data+i,length-i);
+                if (i == length) {
+                    break;
+                }
+            }
+            if (utf8_validator::decode(&m_state,&m_codepoint,data[i]) ==
+                utf8_reject)
+            {
+                return false;
+            }
+            ++i;
+        }
+        return true;
+    }
+
     /// Return whether the input sequence ended on a valid utf8 codepoint
     /**
      * @return Whether or not the input sequence ended on a valid codepoint.
@@ -131,6 +498,27 @@ public:
         m_codepoint = 0;
     }
 private:
+    /// Number of leading bytes of data below 0x80, in whole blocks
+    static size_t ascii_prefix(uint8_t const * data, size_t length) {
+        size_t i = 0;
+#ifdef _WEBSOCKETPP_SSE2_UTF8_
+        while (i + 16 <= length && _mm_movemask_epi8(_mm_loadu_si128(
+            reinterpret_cast<__m128i const *>(data + i))) == 0)
+        {
+            i += 16;
+        }
+#endif
+        uint64_t word;
+        while (i + 8 <= length) {
+            std::memcpy(&word, data + i, 8);
+            if (word & 0x8080808080808080ULL) {
+                break;
+            }
+            i += 8;
+        }
+        return i;
+    }
+
     uint32_t    m_state;
     uint32_t    m_codepoint;
 };
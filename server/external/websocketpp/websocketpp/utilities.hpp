@@ -51,7 +51,8 @@ struct my_equal {
     /**
      * @param [in] loc The locale to use for determining the case of values
      */
-    my_equal(std::locale const & loc ) : m_loc(loc) {}
+    my_equal(std::locale const & loc )
+      : m_ctype(std::use_facet<std::ctype<charT> >(loc)) {}
 
     /// Perform a case insensitive comparison
     /**
@@ -61,10 +62,11 @@ struct my_equal {
      *         to uppercase using the given locale.
      */
     bool operator()(charT ch1, charT ch2) {
-        return std::toupper(ch1, m_loc) == std::toupper(ch2, m_loc);
+        return m_ctype.toupper(ch1) == m_ctype.toupper(ch2);
     }
 private:
-    std::locale const & m_loc;
+    // Looked up once; std::toupper(c,loc) looks the facet up on every call
+    std::ctype<charT> const & m_ctype;
 };
 
 /// Helper less than functor for case insensitive find
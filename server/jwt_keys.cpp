@@ -0,0 +1,131 @@
+// File: jwt_keys.cpp
+// Implementation of the JWT key ring and its lock-free per-thread access.
+
+#include "jwt_keys.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+
+namespace
+{
+const char *const token_issuer = "auction_server";
+
+std::mutex ring_mutex;
+std::shared_ptr<const jwt_keyring> active_ring;
+std::atomic<std::uint64_t> ring_generation{0};
+}
+
+jwt_keyring::jwt_keyring(const std::vector<key_spec> &keys)
+{
+    if (keys.empty())
+        throw std::invalid_argument("JWT key ring needs at least one key");
+    keys_.reserve(keys.size());
+    for (const auto &k : keys)
+    {
+        keys_.push_back(key{
+            k.kid,
+            jwt::algorithm::hs256{k.secret},
+            jwt::verify()
+                .allow_algorithm(jwt::algorithm::hs256{k.secret})
+                .with_issuer(token_issuer)});
+    }
+}
+
+std::vector<jwt_keyring::key_spec> jwt_keyring::parse(const std::string &spec)
+{
+    std::vector<key_spec> keys;
+    std::size_t pos = 0;
+    while (pos <= spec.size())
+    {
+        std::size_t end = spec.find_first_of(",\n", pos);
+        if (end == std::string::npos)
+            end = spec.size();
+        std::string item = spec.substr(pos, end - pos);
+        if (!item.empty() && item.back() == '\r')
+            item.pop_back();
+        if (!item.empty())
+        {
+            std::size_t colon = item.find(':');
+            if (colon == std::string::npos || colon == 0 || colon + 1 == item.size())
+                throw std::invalid_argument("JWT key must be written as kid:secret");
+            keys.push_back({item.substr(0, colon), item.substr(colon + 1)});
+        }
+        pos = end + 1;
+    }
+    return keys;
+}
+
+const jwt_keyring::key *jwt_keyring::find(const std::string &kid) const
+{
+    for (const auto &k : keys_)
+        if (k.kid == kid)
+            return &k;
+    return nullptr;
+}
+
+std::string jwt_keyring::sign(const std::string &username, std::chrono::system_clock::time_point expires) const
+{
+    const key &signer = keys_.front();
+    return jwt::create()
+        .set_issuer(token_issuer)
+        .set_key_id(signer.kid)
+        .set_payload_claim("username", jwt::claim(username))
+        .set_expires_at(expires)
+        .sign(signer.algorithm);
+}
+
+std::string jwt_keyring::verify(const std::string &token, std::chrono::system_clock::time_point &expires) const
+{
+    auto decoded = jwt::decode(token);
+    if (decoded.has_key_id())
+    {
+        const key *k = find(decoded.get_key_id());
+        if (!k)
+            throw std::runtime_error("Unknown JWT key id");
+        k->verifier.verify(decoded);
+    }
+    else
+    {
+        // No kid: the signing key first, then every key still in the ring,
+        // so such tokens survive a rotation for as long as their key does.
+        for (std::size_t i = 0;; ++i)
+        {
+            try
+            {
+                keys_[i].verifier.verify(decoded);
+                break;
+            }
+            catch (const std::exception &)
+            {
+                if (i + 1 == keys_.size())
+                    throw;
+            }
+        }
+    }
+    expires = decoded.get_expires_at();
+    return decoded.get_payload_claim("username").as_string();
+}
+
+void install_jwt_keyring(std::shared_ptr<const jwt_keyring> ring)
+{
+    std::lock_guard<std::mutex> lock(ring_mutex);
+    active_ring = std::move(ring);
+    ring_generation.fetch_add(1, std::memory_order_release);
+}
+
+const jwt_keyring &current_jwt_keyring()
+{
+    thread_local std::shared_ptr<const jwt_keyring> ring;
+    thread_local std::uint64_t generation = 0;
+
+    std::uint64_t latest = ring_generation.load(std::memory_order_acquire);
+    if (generation != latest)
+    {
+        std::lock_guard<std::mutex> lock(ring_mutex);
+        ring = active_ring;
+        generation = ring_generation.load(std::memory_order_relaxed);
+    }
+    return *ring;
+}
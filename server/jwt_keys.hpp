@@ -0,0 +1,64 @@
+// File: jwt_keys.hpp
+// Signing and verification keys for session tokens. Each key's HS256
+// algorithm and jwt-cpp verifier are built once when the key ring is
+// loaded, not per request. Several keys can be active at once, selected
+// by the token's "kid" header, so a secret can be rotated without
+// invalidating sessions signed with the previous one.
+//
+// The ring is immutable; rotation installs a new one. Request threads
+// keep a thread-local reference and only re-fetch it when the ring
+// generation changes, so the hot path takes no lock and touches no
+// shared reference count.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <jwt-cpp/jwt.h>
+
+class jwt_keyring
+{
+public:
+    struct key_spec
+    {
+        std::string kid;
+        std::string secret;
+    };
+
+    // The first key signs new tokens; all keys verify.
+    explicit jwt_keyring(const std::vector<key_spec> &keys);
+
+    // Parse "kid:secret[,kid:secret...]" (commas or newlines separate
+    // keys). Throws std::invalid_argument on malformed input.
+    static std::vector<key_spec> parse(const std::string &spec);
+
+    std::string sign(const std::string &username, std::chrono::system_clock::time_point expires) const;
+
+    // Decode and verify signature, issuer and expiry; return the username
+    // claim and set expires. Tokens without a kid are checked with the
+    // signing key, then with the older keys the ring still holds. Throws
+    // on any failure.
+    std::string verify(const std::string &token, std::chrono::system_clock::time_point &expires) const;
+
+private:
+    using verifier_type = decltype(jwt::verify());
+
+    struct key
+    {
+        std::string kid;
+        jwt::algorithm::hs256 algorithm;
+        verifier_type verifier;
+    };
+
+    const key *find(const std::string &kid) const;
+
+    std::vector<key> keys_;
+};
+
+// Replace the active key ring.
+void install_jwt_keyring(std::shared_ptr<const jwt_keyring> ring);
+
+// The active key ring, cached per thread.
+const jwt_keyring &current_jwt_keyring();
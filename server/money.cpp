@@ -0,0 +1,122 @@
+// File: money.cpp
+// Parsing and formatting for the fixed-point money type.
+
+#include "money.hpp"
+
+#include <charconv>
+#include <cmath>
+
+bool money::parse(std::string_view text, money &out)
+{
+    const char *p = text.data();
+    const char *end = p + text.size();
+    if (p == end)
+        return false;
+
+    bool negative = false;
+    if (*p == '-' || *p == '+')
+    {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    constexpr rep max_units = max_minor / scale;
+    rep units = 0;
+    int digits = 0;
+    for (; p != end && *p >= '0' && *p <= '9'; ++p, ++digits)
+    {
+        units = units * 10 + (*p - '0');
+        if (units > max_units)
+            return false;
+    }
+
+    rep frac = 0;
+    int frac_digits = 0;
+    if (p != end && *p == '.')
+    {
+        ++p;
+        for (; p != end && *p >= '0' && *p <= '9'; ++p, ++frac_digits)
+        {
+            if (frac_digits < decimals)
+                frac = frac * 10 + (*p - '0');
+            else if (*p != '0')
+                return false; // sub-cent precision
+        }
+    }
+    if (p != end || digits + frac_digits == 0)
+        return false;
+    for (int i = frac_digits; i < decimals; ++i)
+        frac *= 10;
+
+    rep cents = units * scale + frac;
+    out = money(negative ? -cents : cents);
+    return true;
+}
+
+bool money::parse(nlohmann::json const &value, money &out)
+{
+    if (value.is_number_integer())
+    {
+        constexpr rep max_units = max_minor / scale;
+        if (value.is_number_unsigned())
+        {
+            auto units = value.get<std::uint64_t>();
+            if (units > static_cast<std::uint64_t>(max_units))
+                return false;
+            out = money(static_cast<rep>(units) * scale);
+            return true;
+        }
+        auto units = value.get<std::int64_t>();
+        if (units > max_units || units < -max_units)
+            return false;
+        out = money(units * scale);
+        return true;
+    }
+    if (value.is_number_float())
+    {
+        double d = value.get<double>();
+        if (!std::isfinite(d) || std::fabs(d) > 1e15)
+            return false;
+        // Shortest round-trip fixed notation: 0.1 -> "0.1", never "0.1000000000000000055".
+        char buf[64];
+        auto res = std::to_chars(buf, buf + sizeof(buf), d, std::chars_format::fixed);
+        if (res.ec != std::errc())
+            return false;
+        return parse(std::string_view(buf, static_cast<std::size_t>(res.ptr - buf)), out);
+    }
+    if (value.is_string())
+        return parse(std::string_view(value.get_ref<const std::string &>()), out);
+    return false;
+}
+
+std::string_view money::format(char *buf) const
+{
+    // Work on the magnitude as unsigned so INT64_MIN does not overflow.
+    std::uint64_t magnitude = cents_ < 0 ? 0 - static_cast<std::uint64_t>(cents_)
+                                         : static_cast<std::uint64_t>(cents_);
+    char tmp[max_chars];
+    char *p = tmp + sizeof(tmp);
+    for (int i = 0; i < decimals; ++i)
+    {
+        *--p = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    }
+    *--p = '.';
+    do
+    {
+        *--p = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (cents_ < 0)
+        *--p = '-';
+
+    std::size_t len = static_cast<std::size_t>(tmp + sizeof(tmp) - p);
+    std::char_traits<char>::copy(buf, p, len);
+    return std::string_view(buf, len);
+}
+
+std::string money::to_string() const
+{
+    char buf[max_chars];
+    return std::string(format(buf));
+}
@@ -0,0 +1,107 @@
+// File: money.hpp
+// Exact fixed-point money amounts stored as an int64 count of cents.
+// Amounts are parsed from request JSON and database text and formatted
+// back to decimal text without going through double or allocating.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <nlohmann/json.hpp>
+
+class money
+{
+public:
+    using rep = std::int64_t;
+    static constexpr rep scale = 100;     // minor units (cents) per unit
+    static constexpr int decimals = 2;
+    static constexpr std::size_t max_chars = 24; // "-92233720368547758.07" plus slack
+    // Largest magnitude parse accepts: 9999999999999999.99, what the
+    // NUMERIC(18,2) columns can store.
+    static constexpr rep max_minor = 999999999999999999;
+
+    constexpr money() = default;
+    static constexpr money from_minor(rep cents) { return money(cents); }
+
+    constexpr rep minor() const { return cents_; }
+
+    // Parse decimal text such as "12", "-3.5" or "100.00". Fractional digits
+    // beyond the second must be zeros. Returns false on malformed input or
+    // a magnitude above max_minor, leaving out untouched.
+    static bool parse(std::string_view text, money &out);
+
+    // Parse a JSON number or numeric string. Floating-point JSON numbers are
+    // converted through their shortest decimal representation, so 0.1 is
+    // exactly 10 cents.
+    static bool parse(nlohmann::json const &value, money &out);
+
+    // Write the amount as "<units>.<cc>" into buf (at least max_chars bytes)
+    // and return a view of the written characters.
+    std::string_view format(char *buf) const;
+
+    std::string to_string() const;
+
+    constexpr bool positive() const { return cents_ > 0; }
+
+    friend constexpr bool operator==(money a, money b) { return a.cents_ == b.cents_; }
+    friend constexpr bool operator!=(money a, money b) { return a.cents_ != b.cents_; }
+    friend constexpr bool operator<(money a, money b) { return a.cents_ < b.cents_; }
+    friend constexpr bool operator<=(money a, money b) { return a.cents_ <= b.cents_; }
+    friend constexpr bool operator>(money a, money b) { return a.cents_ > b.cents_; }
+    friend constexpr bool operator>=(money a, money b) { return a.cents_ >= b.cents_; }
+    friend constexpr money operator+(money a, money b) { return money(a.cents_ + b.cents_); }
+    friend constexpr money operator-(money a, money b) { return money(a.cents_ - b.cents_); }
+    money &operator+=(money other)
+    {
+        cents_ += other.cents_;
+        return *this;
+    }
+    money &operator-=(money other)
+    {
+        cents_ -= other.cents_;
+        return *this;
+    }
+
+    // Overflow-checked arithmetic for amounts that come from requests.
+    // Return false, leaving out untouched, if the result does not fit.
+    static bool add(money a, money b, money &out)
+    {
+        rep sum;
+        if (__builtin_add_overflow(a.cents_, b.cents_, &sum))
+            return false;
+        out = money(sum);
+        return true;
+    }
+    static bool sub(money a, money b, money &out)
+    {
+        rep difference;
+        if (__builtin_sub_overflow(a.cents_, b.cents_, &difference))
+            return false;
+        out = money(difference);
+        return true;
+    }
+
+private:
+    constexpr explicit money(rep cents) : cents_(cents) {}
+
+    rep cents_ = 0;
+};
+
+// Formatted amount held in a stack buffer, for binding as a query parameter
+// or emitting into JSON without a heap allocation.
+class money_text
+{
+public:
+    explicit money_text(money amount) : view_(amount.format(buf_)) {}
+    money_text(const money_text &) = delete;
+    money_text &operator=(const money_text &) = delete;
+
+    std::string_view view() const { return view_; }
+    operator std::string_view() const { return view_; }
+
+private:
+    char buf_[money::max_chars];
+    std::string_view view_;
+};
@@ -0,0 +1,73 @@
+// File: mpsc_queue.hpp
+// Intrusive lock-free multi-producer/single-consumer queue (Dmitry
+// Vyukov's algorithm). Producers push with one atomic exchange and never
+// wait for each other or for the consumer; only the owning thread pops.
+
+#pragma once
+
+#include <atomic>
+
+struct mpsc_node
+{
+    std::atomic<mpsc_node *> next{nullptr};
+};
+
+class mpsc_queue
+{
+public:
+    mpsc_queue() : head_(&stub_), tail_(&stub_) {}
+    mpsc_queue(const mpsc_queue &) = delete;
+    mpsc_queue &operator=(const mpsc_queue &) = delete;
+
+    // Any thread.
+    void push(mpsc_node *n)
+    {
+        n->next.store(nullptr, std::memory_order_relaxed);
+        mpsc_node *prev = head_.exchange(n, std::memory_order_seq_cst);
+        prev->next.store(n, std::memory_order_release);
+    }
+
+    // Consumer only. Returns nullptr when empty, or when a producer is
+    // between its exchange and its link (the node appears momentarily).
+    mpsc_node *pop()
+    {
+        mpsc_node *tail = tail_;
+        mpsc_node *next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_)
+        {
+            if (!next)
+                return nullptr;
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next)
+        {
+            tail_ = next;
+            return tail;
+        }
+        if (tail != head_.load(std::memory_order_acquire))
+            return nullptr;
+        push(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next)
+        {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    // Consumer only. True if nothing has been pushed since the last pop
+    // emptied the queue, including pushes still being linked.
+    bool empty() const
+    {
+        return tail_->next.load(std::memory_order_acquire) == nullptr &&
+               head_.load(std::memory_order_seq_cst) == tail_;
+    }
+
+private:
+    alignas(64) std::atomic<mpsc_node *> head_;
+    alignas(64) mpsc_node *tail_;
+    mpsc_node stub_;
+};
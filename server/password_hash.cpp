@@ -0,0 +1,139 @@
+// File: password_hash.cpp
+// scrypt password hashing on top of OpenSSL's EVP_PBE_scrypt.
+
+#include "password_hash.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+namespace
+{
+const char *const scheme = "$scrypt$";
+
+// N = 2^14, r = 8 needs 128 * r * N = 16 MiB per hash.
+constexpr unsigned default_log_n = 14;
+constexpr unsigned default_r = 8;
+constexpr unsigned default_p = 1;
+constexpr std::size_t salt_bytes = 16;
+constexpr std::size_t hash_bytes = 32;
+constexpr std::uint64_t max_memory = 64ull * 1024 * 1024;
+
+struct scrypt_params
+{
+    unsigned log_n = default_log_n;
+    unsigned r = default_r;
+    unsigned p = default_p;
+};
+
+std::string base64_encode(const unsigned char *data, std::size_t len)
+{
+    std::string out(4 * ((len + 2) / 3), '\0');
+    int n = EVP_EncodeBlock(reinterpret_cast<unsigned char *>(&out[0]), data, static_cast<int>(len));
+    out.resize(static_cast<std::size_t>(n));
+    return out;
+}
+
+bool base64_decode(const std::string &in, std::vector<unsigned char> &out)
+{
+    if (in.empty() || in.size() % 4 != 0)
+        return false;
+    out.resize(3 * in.size() / 4);
+    int n = EVP_DecodeBlock(out.data(), reinterpret_cast<const unsigned char *>(in.data()), static_cast<int>(in.size()));
+    if (n < 0)
+        return false;
+    // EVP_DecodeBlock keeps the bytes that padding stands for; drop them.
+    std::size_t padding = 0;
+    if (in[in.size() - 1] == '=')
+        ++padding;
+    if (in[in.size() - 2] == '=')
+        ++padding;
+    out.resize(static_cast<std::size_t>(n) - padding);
+    return true;
+}
+
+void derive(const std::string &password, const unsigned char *salt, std::size_t salt_len,
+            const scrypt_params &params, unsigned char *out, std::size_t out_len)
+{
+    if (EVP_PBE_scrypt(password.data(), password.size(), salt, salt_len,
+                       std::uint64_t{1} << params.log_n, params.r, params.p,
+                       max_memory, out, out_len) != 1)
+        throw std::runtime_error("scrypt failed");
+}
+
+// Split "$scrypt$ln=..,r=..,p=..$salt$hash" into its parts.
+bool parse_stored(const std::string &stored, scrypt_params &params,
+                  std::vector<unsigned char> &salt, std::vector<unsigned char> &hash)
+{
+    if (stored.compare(0, std::char_traits<char>::length(scheme), scheme) != 0)
+        return false;
+    std::size_t params_begin = std::char_traits<char>::length(scheme);
+    std::size_t salt_begin = stored.find('$', params_begin);
+    if (salt_begin == std::string::npos)
+        return false;
+    std::size_t hash_begin = stored.find('$', salt_begin + 1);
+    if (hash_begin == std::string::npos)
+        return false;
+
+    std::string param_text = stored.substr(params_begin, salt_begin - params_begin);
+    if (std::sscanf(param_text.c_str(), "ln=%u,r=%u,p=%u", &params.log_n, &params.r, &params.p) != 3)
+        return false;
+    if (params.log_n < 1 || params.log_n > 20 || params.r == 0 || params.p == 0)
+        return false;
+
+    return base64_decode(stored.substr(salt_begin + 1, hash_begin - salt_begin - 1), salt) &&
+           base64_decode(stored.substr(hash_begin + 1), hash) && !hash.empty();
+}
+}
+
+std::string hash_password(const std::string &password)
+{
+    unsigned char salt[salt_bytes];
+    if (RAND_bytes(salt, sizeof(salt)) != 1)
+        throw std::runtime_error("RAND_bytes failed");
+
+    scrypt_params params;
+    unsigned char hash[hash_bytes];
+    derive(password, salt, sizeof(salt), params, hash, sizeof(hash));
+
+    return std::string(scheme) + "ln=" + std::to_string(params.log_n) +
+           ",r=" + std::to_string(params.r) + ",p=" + std::to_string(params.p) +
+           "$" + base64_encode(salt, sizeof(salt)) + "$" + base64_encode(hash, sizeof(hash));
+}
+
+bool verify_password(const std::string &password, const std::string &stored)
+{
+    if (password_needs_rehash(stored))
+        return stored.size() == password.size() &&
+               CRYPTO_memcmp(stored.data(), password.data(), password.size()) == 0;
+
+    scrypt_params params;
+    std::vector<unsigned char> salt, expected;
+    if (!parse_stored(stored, params, salt, expected))
+        return false;
+
+    std::vector<unsigned char> actual(expected.size());
+    derive(password, salt.data(), salt.size(), params, actual.data(), actual.size());
+    return CRYPTO_memcmp(actual.data(), expected.data(), expected.size()) == 0;
+}
+
+const std::string &dummy_password_hash()
+{
+    static const std::string dummy = []
+    {
+        unsigned char secret[salt_bytes];
+        if (RAND_bytes(secret, sizeof(secret)) != 1)
+            throw std::runtime_error("RAND_bytes failed");
+        return hash_password(base64_encode(secret, sizeof(secret)));
+    }();
+    return dummy;
+}
+
+bool password_needs_rehash(const std::string &stored)
+{
+    return stored.compare(0, std::char_traits<char>::length(scheme), scheme) != 0;
+}
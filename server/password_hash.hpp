@@ -0,0 +1,28 @@
+// File: password_hash.hpp
+// Salted, memory-hard password hashing (scrypt via OpenSSL). Hashes are
+// stored self-describing as
+//   $scrypt$ln=<log2 N>,r=<r>,p=<p>$<base64 salt>$<base64 hash>
+// so the cost parameters can be raised later without breaking existing
+// rows. Each call takes tens of milliseconds and ~16 MiB of memory by
+// design: run it on the cpu_pool, never on a network thread.
+
+#pragma once
+
+#include <string>
+
+// Hash a password with a fresh random salt.
+std::string hash_password(const std::string &password);
+
+// Check a password against a stored value in constant time. Values that
+// are not scrypt hashes are treated as legacy plaintext passwords.
+bool verify_password(const std::string &password, const std::string &stored);
+
+// A hash of a random password in the current format. Checking a login
+// for an unknown user against it costs the same scrypt work as a real
+// account, so response times do not reveal which usernames exist. The
+// hash is computed on first use; call once at startup.
+const std::string &dummy_password_hash();
+
+// True if the stored value should be replaced by hash_password(), i.e. it
+// is a legacy plaintext password.
+bool password_needs_rehash(const std::string &stored);
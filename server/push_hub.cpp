@@ -0,0 +1,96 @@
+// File: push_hub.cpp
+// Implementation of the topic -> subscriber index.
+
+#include "push_hub.hpp"
+
+#include <algorithm>
+#include <functional>
+
+push_hub::push_hub(std::size_t shard_count)
+    : shard_count_(shard_count ? shard_count : 1),
+      shards_(new shard[shard_count_])
+{
+}
+
+push_hub::shard &push_hub::shard_for(const std::string &topic) const
+{
+    return shards_[std::hash<std::string>{}(topic) % shard_count_];
+}
+
+bool push_hub::subscribe(const std::string &topic, const std::shared_ptr<push_subscriber> &subscriber)
+{
+    shard &s = shard_for(topic);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto &members = s.topics[topic];
+    for (auto const &m : members)
+        if (m.key == subscriber.get())
+            return false;
+    members.push_back({subscriber.get(), subscriber});
+    return true;
+}
+
+bool push_hub::unsubscribe(const std::string &topic, const push_subscriber *subscriber)
+{
+    shard &s = shard_for(topic);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.topics.find(topic);
+    if (it == s.topics.end())
+        return false;
+    auto &members = it->second;
+    auto m = std::find_if(members.begin(), members.end(),
+                          [subscriber](member const &x)
+                          { return x.key == subscriber; });
+    if (m == members.end())
+        return false;
+    // Order does not matter: swap with the last member and drop it.
+    *m = std::move(members.back());
+    members.pop_back();
+    if (members.empty())
+        s.topics.erase(it);
+    return true;
+}
+
+bool push_hub::has_subscribers(const std::string &topic) const
+{
+    shard &s = shard_for(topic);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.topics.count(topic) != 0;
+}
+
+std::size_t push_hub::publish(const std::string &topic, const push_message_ptr &message)
+{
+    std::vector<std::shared_ptr<push_subscriber>> recipients;
+    {
+        shard &s = shard_for(topic);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.topics.find(topic);
+        if (it == s.topics.end())
+            return 0;
+        recipients.reserve(it->second.size());
+        for (auto const &m : it->second)
+            if (auto subscriber = m.subscriber.lock())
+                recipients.push_back(std::move(subscriber));
+    }
+
+    for (auto const &subscriber : recipients)
+        subscriber->deliver(message);
+
+    published_.fetch_add(1, std::memory_order_relaxed);
+    delivered_.fetch_add(recipients.size(), std::memory_order_relaxed);
+    return recipients.size();
+}
+
+push_hub::stats push_hub::snapshot() const
+{
+    stats st;
+    for (std::size_t i = 0; i < shard_count_; ++i)
+    {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        st.topics += shards_[i].topics.size();
+        for (auto const &entry : shards_[i].topics)
+            st.subscriptions += entry.second.size();
+    }
+    st.published = published_.load(std::memory_order_relaxed);
+    st.delivered = delivered_.load(std::memory_order_relaxed);
+    return st;
+}
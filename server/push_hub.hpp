@@ -0,0 +1,77 @@
+// File: push_hub.hpp
+// Topic -> subscriber index for server push. Each topic keeps its own
+// subscriber list, so publishing touches only that topic's subscribers
+// rather than every open connection. A message is encoded once by the
+// publisher and handed to every recipient by reference. Topics are spread
+// over mutex-guarded shards; delivery happens outside the lock.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Encoded message; defined by the transport (push_session.hpp).
+struct push_message;
+using push_message_ptr = std::shared_ptr<const push_message>;
+
+// One receiving end (a WebSocket connection). deliver may be called from
+// any thread and must not block.
+class push_subscriber
+{
+public:
+    virtual ~push_subscriber() = default;
+    virtual void deliver(push_message_ptr message) = 0;
+};
+
+class push_hub
+{
+public:
+    struct stats
+    {
+        std::size_t topics = 0;
+        std::size_t subscriptions = 0;
+        std::uint64_t published = 0;
+        std::uint64_t delivered = 0;
+    };
+
+    explicit push_hub(std::size_t shard_count = 16);
+
+    // Returns false if the subscriber was already on the topic.
+    bool subscribe(const std::string &topic, const std::shared_ptr<push_subscriber> &subscriber);
+    bool unsubscribe(const std::string &topic, const push_subscriber *subscriber);
+
+    // Cheap check so publishers can skip building a message nobody gets.
+    bool has_subscribers(const std::string &topic) const;
+
+    // Send message to the topic's current subscribers. Returns how many
+    // received it; costs nothing beyond a lookup when nobody listens.
+    std::size_t publish(const std::string &topic, const push_message_ptr &message);
+
+    stats snapshot() const;
+
+private:
+    struct member
+    {
+        const push_subscriber *key;
+        std::weak_ptr<push_subscriber> subscriber;
+    };
+
+    struct alignas(64) shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, std::vector<member>> topics;
+    };
+
+    shard &shard_for(const std::string &topic) const;
+
+    std::size_t shard_count_;
+    std::unique_ptr<shard[]> shards_;
+    std::atomic<std::uint64_t> published_{0};
+    std::atomic<std::uint64_t> delivered_{0};
+};
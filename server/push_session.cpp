@@ -0,0 +1,421 @@
+// File: push_session.cpp
+// Bridges Beast sockets and websocketpp connections for the push endpoint.
+
+#include "push_session.hpp"
+
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/system_timer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/bind_handler.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/http/write.hpp>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+using json = nlohmann::json;
+
+namespace
+{
+// Helper: value of the token query parameter in a resource such as
+// "/ws?token=abc", or empty.
+std::string query_token(const std::string &resource)
+{
+    auto query = resource.find('?');
+    if (query == std::string::npos)
+        return {};
+    std::size_t pos = query + 1;
+    while (pos < resource.size())
+    {
+        auto end = resource.find('&', pos);
+        if (end == std::string::npos)
+            end = resource.size();
+        if (resource.compare(pos, 6, "token=") == 0)
+            return resource.substr(pos + 6, end - pos - 6);
+        pos = end + 1;
+    }
+    return {};
+}
+
+std::string error_message(const std::string &message)
+{
+    return json{{"type", "error"}, {"message", message}}.dump();
+}
+}
+
+// One WebSocket connection. Every call into the websocketpp connection
+// happens on the socket's strand; pushes from other threads are posted
+// there first. The websocketpp handlers capture this raw: the session owns
+// the connection, so they can only run while the session is alive.
+class push_session : public push_subscriber, public std::enable_shared_from_this<push_session>
+{
+    push_endpoint &endpoint_;
+    beast::tcp_stream stream_;
+    push_endpoint::server::connection_ptr con_;
+    std::string username_;
+    std::chrono::system_clock::time_point expires_; // the token's
+    std::unordered_set<std::string> topics_;
+    net::steady_timer idle_timer_;
+    net::system_timer expiry_timer_;
+
+    char read_buf_[4096];
+    std::vector<net::const_buffer> sending_; // websocketpp's buffers being written
+    bool writing_ = false;
+    bool legacy_ = false;   // hybi00 client: frames differ, cannot share
+    bool shutdown_ = false; // websocketpp is done; close once the write ends
+    bool finished_ = false;
+    bool heard_ = false;   // bytes arrived since the last idle check
+    bool pinged_ = false;  // a ping is waiting for any reply
+    bool closing_seen_ = false; // an idle check found the closing handshake running
+    websocketpp::write_stats reported_; // write totals already added to endpoint_
+
+public:
+    push_session(push_endpoint &endpoint, tcp::socket &&socket)
+        : endpoint_(endpoint), stream_(std::move(socket)),
+          con_(endpoint.server_.get_connection()),
+          idle_timer_(stream_.get_executor()), expiry_timer_(stream_.get_executor())
+    {
+        // websocketpp starts the next write only after complete_write, so
+        // while the socket is slow further messages wait (and conflate) in
+        // the connection's send queue.
+        con_->set_async_write_handler(
+            [this](websocketpp::connection_hdl, std::vector<websocketpp::transport::buffer> const &bufs)
+            { do_write(bufs); });
+        con_->set_shutdown_handler(
+            [this](websocketpp::connection_hdl)
+            {
+                shutdown_ = true;
+                if (!writing_)
+                    close_socket();
+                return websocketpp::lib::error_code();
+            });
+        con_->set_validate_handler([this](websocketpp::connection_hdl)
+                                   { return validate(); });
+        con_->set_open_handler([this](websocketpp::connection_hdl)
+                               {
+                                   legacy_ = con_->get_request_header("Sec-WebSocket-Version").empty();
+                                   endpoint_.accepted_.fetch_add(1, std::memory_order_relaxed);
+                                   on_open();
+                               });
+        con_->set_fail_handler([this](websocketpp::connection_hdl)
+                               {
+                                   endpoint_.rejected_.fetch_add(1, std::memory_order_relaxed);
+                                   finish();
+                               });
+        con_->set_close_handler([this](websocketpp::connection_hdl)
+                                { finish(); });
+        con_->set_message_handler([this](websocketpp::connection_hdl, push_endpoint::server::message_ptr msg)
+                                  { on_message(msg->get_payload()); });
+        endpoint_.open_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~push_session()
+    {
+        finish();
+        endpoint_.open_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Replay the upgrade request and any bytes read after it, then keep
+    // reading from the socket.
+    void start(std::string request, beast::flat_buffer &buffered)
+    {
+        if (endpoint_.options_.handshake_timeout.count() > 0)
+            stream_.expires_after(endpoint_.options_.handshake_timeout);
+        con_->start();
+        if (!feed(request.data(), request.size()))
+            return;
+        auto extra = buffered.data();
+        if (extra.size() && !feed(static_cast<const char *>(extra.data()), extra.size()))
+            return;
+        do_read();
+    }
+
+    void deliver(push_message_ptr message) override
+    {
+        net::post(stream_.get_executor(),
+                  [self = shared_from_this(), message = std::move(message)]
+                  {
+                      self->push(*message);
+                  });
+    }
+
+private:
+    void push(const push_message &message)
+    {
+        if (con_->get_state() != websocketpp::session::state::open)
+            return;
+        // Pushes already posted to the strand run before the uncork.
+        if (endpoint_.options_.cork_bursts && !con_->is_corked())
+        {
+            con_->cork();
+            net::post(stream_.get_executor(),
+                      [self = shared_from_this()]
+                      {
+                          self->con_->uncork();
+                      });
+        }
+        std::size_t conflated = con_->get_conflated_count();
+        websocketpp::lib::error_code ec;
+        if (legacy_)
+            ec = con_->send(message.frame->get_payload(), websocketpp::frame::opcode::text, message.key);
+        else
+            ec = con_->send(message.frame, message.key);
+        if (ec == websocketpp::error::send_queue_full)
+            endpoint_.overflowed_.fetch_add(1, std::memory_order_relaxed);
+        else if (con_->get_conflated_count() != conflated)
+            endpoint_.conflated_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool validate()
+    {
+        std::string token;
+        std::string const &auth = con_->get_request_header("Authorization");
+        if (auth.rfind("Bearer ", 0) == 0)
+            token = auth.substr(7);
+        else
+            token = query_token(con_->get_resource());
+
+        if (!token.empty())
+            username_ = endpoint_.options_.authenticate(token, expires_);
+        if (username_.empty())
+        {
+            con_->set_status(websocketpp::http::status_code::unauthorized);
+            return false;
+        }
+        return true;
+    }
+
+    // The handshake deadline is replaced by the ping and token deadlines.
+    void on_open()
+    {
+        stream_.expires_never();
+        if (endpoint_.options_.ping_interval.count() > 0)
+            wait_idle();
+        if (expires_ == std::chrono::system_clock::time_point())
+            return;
+        expiry_timer_.expires_at(expires_);
+        expiry_timer_.async_wait(beast::bind_front_handler(&push_session::on_token_expired, shared_from_this()));
+    }
+
+    void wait_idle()
+    {
+        idle_timer_.expires_after(endpoint_.options_.ping_interval);
+        idle_timer_.async_wait(beast::bind_front_handler(&push_session::on_idle, shared_from_this()));
+    }
+
+    // Once per ping_interval: ping a client that has gone quiet, and drop
+    // it if it has not answered since the last ping, or if a closing
+    // handshake is still unfinished an interval after it was noticed.
+    void on_idle(beast::error_code ec)
+    {
+        if (ec)
+            return;
+        bool open = con_->get_state() == websocketpp::session::state::open;
+        if ((open && pinged_ && !heard_) || (!open && closing_seen_))
+        {
+            endpoint_.timed_out_.fetch_add(1, std::memory_order_relaxed);
+            return close_socket();
+        }
+        if (!open)
+            closing_seen_ = true;
+        else if (!heard_)
+        {
+            websocketpp::lib::error_code ignored;
+            con_->ping("", ignored);
+            pinged_ = true;
+        }
+        heard_ = false;
+        wait_idle();
+    }
+
+    void on_token_expired(beast::error_code ec)
+    {
+        if (ec || con_->get_state() != websocketpp::session::state::open)
+            return;
+        endpoint_.expired_.fetch_add(1, std::memory_order_relaxed);
+        websocketpp::lib::error_code ignored;
+        con_->close(websocketpp::close::status::policy_violation, "Token expired", ignored);
+    }
+
+    void on_message(const std::string &payload)
+    {
+        std::string action, requested;
+        try
+        {
+            auto j = json::parse(payload);
+            action = j.at("action").get<std::string>();
+            requested = j.at("topic").get<std::string>();
+        }
+        catch (const std::exception &)
+        {
+            return reply(error_message("Expected {\"action\": ..., \"topic\": ...}"));
+        }
+
+        std::string topic = endpoint_.options_.resolve_topic(username_, requested);
+        if (topic.empty())
+            return reply(error_message("Unknown topic " + requested));
+
+        if (action == "subscribe")
+        {
+            if (!topics_.count(topic) && topics_.size() >= endpoint_.options_.max_topics)
+                return reply(error_message("Too many subscriptions"));
+            topics_.insert(topic);
+            endpoint_.hub_.subscribe(topic, shared_from_this());
+            return reply(json{{"type", "subscribed"}, {"topic", requested}}.dump());
+        }
+        if (action == "unsubscribe")
+        {
+            if (topics_.erase(topic))
+                endpoint_.hub_.unsubscribe(topic, this);
+            return reply(json{{"type", "unsubscribed"}, {"topic", requested}}.dump());
+        }
+        reply(error_message("Unknown action " + action));
+    }
+
+    void reply(const std::string &message)
+    {
+        con_->send(message, websocketpp::frame::opcode::text);
+    }
+
+    // Leave every topic; the hub only holds weak references, but this
+    // keeps the index from accumulating dead entries.
+    void finish()
+    {
+        if (finished_)
+            return;
+        finished_ = true;
+        for (auto const &topic : topics_)
+            endpoint_.hub_.unsubscribe(topic, this);
+        topics_.clear();
+    }
+
+    // Hand bytes to websocketpp. Returns false once it stops reading.
+    bool feed(const char *data, std::size_t len)
+    {
+        return con_->read_all(data, len) == len;
+    }
+
+    void do_read()
+    {
+        stream_.async_read_some(net::buffer(read_buf_),
+                                beast::bind_front_handler(&push_session::on_read, shared_from_this()));
+    }
+
+    void on_read(beast::error_code ec, std::size_t n)
+    {
+        if (ec)
+        {
+            if (ec == beast::error::timeout)
+                endpoint_.timed_out_.fetch_add(1, std::memory_order_relaxed);
+            if (ec == net::error::eof)
+                con_->eof();
+            else
+                con_->fatal_error();
+            return close_socket();
+        }
+        heard_ = true;
+        pinged_ = false;
+        if (feed(read_buf_, n))
+            do_read();
+    }
+
+    // Write websocketpp's header and payload buffers in one gathered
+    // write; they stay valid until complete_write.
+    void do_write(std::vector<websocketpp::transport::buffer> const &bufs)
+    {
+        writing_ = true;
+        websocketpp::write_stats totals = con_->get_write_stats();
+        endpoint_.writes_.fetch_add(totals.transport_writes - reported_.transport_writes,
+                                    std::memory_order_relaxed);
+        endpoint_.messages_written_.fetch_add(totals.messages_written - reported_.messages_written,
+                                              std::memory_order_relaxed);
+        reported_ = totals;
+        sending_.clear();
+        for (auto const &buf : bufs)
+            sending_.emplace_back(buf.buf, buf.len);
+        net::async_write(stream_, sending_,
+                         beast::bind_front_handler(&push_session::on_write, shared_from_this()));
+    }
+
+    void on_write(beast::error_code ec, std::size_t)
+    {
+        writing_ = false;
+        if (ec)
+        {
+            con_->fatal_error();
+            con_->complete_write(websocketpp::transport::error::make_error_code(
+                websocketpp::transport::error::pass_through));
+            return close_socket();
+        }
+        // May start the next write before returning.
+        con_->complete_write(websocketpp::lib::error_code());
+        if (shutdown_ && !writing_)
+            close_socket();
+    }
+
+    void close_socket()
+    {
+        idle_timer_.cancel();
+        expiry_timer_.cancel();
+        beast::error_code ec;
+        stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+        stream_.socket().close(ec);
+    }
+};
+
+push_endpoint::push_endpoint(push_hub &hub, push_options options)
+    : hub_(hub), options_(std::move(options))
+{
+    server_.clear_access_channels(websocketpp::log::alevel::all);
+    server_.clear_error_channels(websocketpp::log::elevel::all);
+    server_.set_error_channels(websocketpp::log::elevel::fatal);
+    server_.set_max_buffered_amount(options_.max_buffered_bytes);
+    server_.set_max_write_batch_bytes(options_.write_batch_bytes);
+    server_.set_max_write_batch_messages(options_.write_batch_messages);
+}
+
+void push_endpoint::accept(tcp::socket socket,
+                           const http::request<http::string_body> &req,
+                           beast::flat_buffer &buffered)
+{
+    // websocketpp parses the handshake itself, so give it the request as
+    // it arrived on the wire.
+    std::ostringstream request;
+    request << req.base();
+
+    // Called on the socket's strand, so the session may start right away.
+    std::make_shared<push_session>(*this, std::move(socket))->start(request.str(), buffered);
+}
+
+std::size_t push_endpoint::publish(const std::string &topic, const std::string &text)
+{
+    auto message = std::make_shared<push_message>();
+    message->frame = server_.prepare_broadcast(text, websocketpp::frame::opcode::text);
+    message->key = topic;
+    return hub_.publish(topic, message);
+}
+
+push_endpoint::stats push_endpoint::snapshot() const
+{
+    stats st;
+    st.open = open_.load(std::memory_order_relaxed);
+    st.accepted = accepted_.load(std::memory_order_relaxed);
+    st.rejected = rejected_.load(std::memory_order_relaxed);
+    st.conflated = conflated_.load(std::memory_order_relaxed);
+    st.overflowed = overflowed_.load(std::memory_order_relaxed);
+    st.timed_out = timed_out_.load(std::memory_order_relaxed);
+    st.expired = expired_.load(std::memory_order_relaxed);
+    st.writes = writes_.load(std::memory_order_relaxed);
+    st.messages_written = messages_written_.load(std::memory_order_relaxed);
+    return st;
+}
@@ -0,0 +1,172 @@
+// File: push_session.hpp
+// WebSocket push endpoint served from the HTTP port. The protocol is
+// handled by the vendored websocketpp through its iostream transport,
+// while the socket stays on the server's own io_context: bytes read by
+// Asio are fed to the websocketpp connection, and the frames it produces
+// are written with async_write straight from websocketpp's buffers, one
+// write at a time, on the connection's strand.
+// (websocketpp's own Asio transport predates the Boost version we build
+// against.)
+//
+// Clients authenticate with the REST API's JWT, as an Authorization
+// header or a ?token= query parameter, and are disconnected when it
+// expires. They then send
+//   {"action": "subscribe",   "topic": "<topic>"}
+//   {"action": "unsubscribe", "topic": "<topic>"}
+// Published messages for subscribed topics are pushed as text frames,
+// framed once per publish and shared by every recipient. Each message
+// describes the topic's current state, so a queued update that has not
+// been written yet is replaced by a newer one for the same topic, and a
+// client that falls further behind than max_buffered_bytes is closed.
+//
+// The iostream transport has no timers of its own, so the session keeps
+// the deadlines: the opening handshake must finish within
+// handshake_timeout, a quiet client is pinged and dropped if it stays
+// quiet, and a closing handshake the client never answers is cut short.
+//
+// Updates that reach a connection in a burst leave in as few writes as
+// possible: the first push of a strand turn corks the connection and the
+// cork is released once the pushes already posted to the strand have been
+// queued, so they share one gathered write (bounded by the write_batch_*
+// options).
+
+#pragma once
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <websocketpp/config/core.hpp>
+#include <websocketpp/logger/async.hpp>
+#include <websocketpp/message_buffer/pool.hpp>
+#include <websocketpp/server.hpp>
+#include "push_hub.hpp"
+
+// websocketpp configuration: iostream transport, pooled message buffers
+// so steady traffic does not allocate a message per frame, small inbound
+// messages since clients only send subscription commands, and async
+// loggers: access logging is compiled out and errors never make the I/O
+// threads wait on a shared lock or stderr.
+struct push_config : public websocketpp::config::core
+{
+    typedef push_config type;
+    typedef websocketpp::config::core base;
+
+    typedef websocketpp::log::async<concurrency_type, websocketpp::log::elevel,
+                                    websocketpp::log::elevel::rerror | websocketpp::log::elevel::fatal>
+        elog_type;
+    typedef websocketpp::log::async<concurrency_type, websocketpp::log::alevel,
+                                    websocketpp::log::alevel::none>
+        alog_type;
+
+    struct transport_config : public base::transport_config
+    {
+        typedef type::elog_type elog_type;
+        typedef type::alog_type alog_type;
+    };
+    typedef websocketpp::transport::iostream::endpoint<transport_config> transport_type;
+
+    typedef websocketpp::message_buffer::message<websocketpp::message_buffer::pool::con_msg_manager>
+        message_type;
+    typedef websocketpp::message_buffer::pool::con_msg_manager<message_type>
+        con_msg_manager_type;
+    typedef websocketpp::message_buffer::pool::endpoint_msg_manager<con_msg_manager_type>
+        endpoint_msg_manager_type;
+
+    static const std::size_t max_message_size = 16 * 1024;
+};
+
+struct push_options
+{
+    // Username for a token, or empty if it is not valid. Sets expires to
+    // when the token stops being valid; the connection is closed then.
+    std::function<std::string(const std::string &token, std::chrono::system_clock::time_point &expires)>
+        authenticate;
+    // Hub topic a user may subscribe to for the requested name, or empty
+    // if the request is not allowed.
+    std::function<std::string(const std::string &username, const std::string &topic)> resolve_topic;
+    std::size_t max_topics = 64; // subscriptions per connection
+    // Time from taking over the socket until the upgrade completes.
+    std::chrono::milliseconds handshake_timeout{10000};
+    // A client that sends nothing for an interval is pinged, and closed if
+    // it stays silent, pong included, for another one. It also bounds the
+    // wait for the client's side of a closing handshake.
+    std::chrono::milliseconds ping_interval{30000};
+    // Outbound bytes a connection may have queued before it is closed
+    // with 1013 (try again later); 0 for no limit. A message that finds
+    // nothing else queued is sent whatever its size.
+    std::size_t max_buffered_bytes = 1024 * 1024;
+    // Limits on one gathered write. Asio passes at most 64 buffers to a
+    // writev call, two per message; 0 for no limit.
+    std::size_t write_batch_bytes = 256 * 1024;
+    std::size_t write_batch_messages = 32;
+    // Hold pushes until the strand's queued pushes have been sent, so a
+    // burst shares one write.
+    bool cork_bursts = true;
+};
+
+class push_endpoint
+{
+public:
+    using server = websocketpp::server<push_config>;
+
+    struct stats
+    {
+        std::size_t open = 0;
+        std::uint64_t accepted = 0;
+        std::uint64_t rejected = 0; // failed handshakes, including bad tokens
+        std::uint64_t conflated = 0; // queued updates replaced by newer ones
+        std::uint64_t overflowed = 0; // connections closed for max_buffered_bytes
+        std::uint64_t timed_out = 0; // handshake or ping deadline missed
+        std::uint64_t expired = 0; // connections closed when their token expired
+        std::uint64_t writes = 0; // socket writes carrying messages
+        std::uint64_t messages_written = 0;
+    };
+
+    push_endpoint(push_hub &hub, push_options options);
+
+    // Frame text once and push it to the topic's subscribers. Returns how
+    // many received it.
+    std::size_t publish(const std::string &topic, const std::string &text);
+
+    // Take over an HTTP connection whose request asked for a WebSocket
+    // upgrade. buffered holds any bytes read past the request. The socket
+    // must be bound to a strand.
+    void accept(boost::asio::ip::tcp::socket socket,
+                const boost::beast::http::request<boost::beast::http::string_body> &req,
+                boost::beast::flat_buffer &buffered);
+
+    stats snapshot() const;
+
+private:
+    friend class push_session;
+
+    push_hub &hub_;
+    push_options options_;
+    server server_;
+
+    std::atomic<std::size_t> open_{0};
+    std::atomic<std::uint64_t> accepted_{0};
+    std::atomic<std::uint64_t> rejected_{0};
+    std::atomic<std::uint64_t> conflated_{0};
+    std::atomic<std::uint64_t> overflowed_{0};
+    std::atomic<std::uint64_t> timed_out_{0};
+    std::atomic<std::uint64_t> expired_{0};
+    std::atomic<std::uint64_t> writes_{0};
+    std::atomic<std::uint64_t> messages_written_{0};
+};
+
+// A published message: one immutable, pre-framed websocketpp message that
+// every subscriber's connection queues by reference. key is the
+// conflation key: a queued message with the same key is replaced.
+struct push_message
+{
+    push_endpoint::server::message_ptr frame;
+    std::string key;
+};
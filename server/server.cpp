@@ -1,25 +1,93 @@
 // File: server.cpp
 // This HTTP server uses Boost.Beast, libpqxx, nlohmann/json, and jwt-cpp
-// to implement user registration, login, and profile management endpoints.
+// to implement user registration, login, profile management, and auction
+// endpoints.
 // Endpoints:
 //   POST /register: expects JSON { "username": "...", "password": "..." }
 //   POST /login:    expects JSON { "username": "...", "password": "..." }
 //                   On success returns a JWT token (expires in 1 hour),
 //                   username, and balance.
 //   GET  /profile:  requires header "Authorization: Bearer <token>"
-//                   Returns username and balance.
+//                   Returns username, balance, held and available funds.
 //   POST /deposit:  requires header "Authorization: Bearer <token>",
-//                   JSON { "amount": <number> }
+//                   JSON { "amount": <number or decimal string> }
+//                   Returns the new balance.
 //   POST /withdraw: requires header "Authorization: Bearer <token>",
-//                   JSON { "amount": <number> }
-// NOTE: Passwords are stored in plaintext for demonstration purposes only.
+//                   JSON { "amount": <number or decimal string> }
+//                   Returns the new balance. Held funds cannot be withdrawn.
+//   POST /hold:     requires header "Authorization: Bearer <token>",
+//                   JSON { "amount": <amount> }. Reserves funds from the
+//                   available balance; returns hold_id, balance, held and
+//                   available.
+//   POST /release:  requires header "Authorization: Bearer <token>",
+//                   JSON { "hold_id": <id> }. Returns the held funds to
+//                   available.
+//   POST /auctions: requires header "Authorization: Bearer <token>",
+//                   JSON { "title": "...", "starting_price": <amount>,
+//                          "reserve": <amount>, "min_increment": <amount>,
+//                          "starts_at": <epoch ms>, "ends_at": <epoch ms> or
+//                          "duration_seconds": <n> } (reserve, min_increment
+//                   and starts_at are optional). Returns the auction.
+//   GET  /auctions: lists all auctions.
+//   GET  /auctions/<id>: one auction.
+//   POST /auctions/<id>/bids: requires header "Authorization: Bearer <token>",
+//                   JSON { "amount": <amount> }. Bids are decided in memory by
+//                   the shard owning the auction and written to the database
+//                   in the background. The bid amount is held from the
+//                   bidder's balance until they are outbid. Once the auction
+//                   ends, a leader who met the reserve pays the seller out
+//                   of that hold; otherwise the hold is released.
+//   GET  /metrics:  server statistics (pools, caches, background writers).
+//   GET  /ws:       WebSocket upgrade for server push; authenticate with
+//                   "Authorization: Bearer <token>" or /ws?token=<token>.
+//                   Send {"action": "subscribe" | "unsubscribe", "topic": t}
+//                   with t = "balance" (your balance, held and available
+//                   funds) or "auction:<id>" (the auction after each bid).
+//                   Only the newest unsent update per topic is kept. Quiet
+//                   clients are pinged, and the connection is closed when the
+//                   token expires.
+// Passwords are stored as salted scrypt hashes, computed on a dedicated
+// worker pool; legacy plaintext rows are upgraded on the next login.
+//
+// Configuration (environment):
+//   AUCTION_THREADS:      number of I/O worker threads (default: hardware cores).
+//   AUCTION_IDLE_TIMEOUT: seconds a keep-alive connection may sit idle (default 30).
+//   AUCTION_MAX_REQUESTS: requests served per connection before closing (default 100).
+//   AUCTION_DB_POOL_MIN:  database connections opened at startup (default 2).
+//   AUCTION_DB_POOL_MAX:  maximum open database connections (default 16).
+//   AUCTION_DB_CHECKOUT_MS: wait for a free connection before answering 503 (default 2000).
+//   AUCTION_JWT_CACHE_SIZE: verified tokens remembered across requests (default 65536).
+//   AUCTION_HASH_THREADS: password hashing worker threads (default: half the cores).
+//   AUCTION_HASH_QUEUE:   hashing jobs allowed to wait before answering 503 (default 256).
+//   AUCTION_BID_SHARDS:   auction engine shards, one thread each (default: half the cores).
+//   AUCTION_JWT_KEYS:     signing keys as "kid:secret,kid:secret"; the first signs,
+//                         all verify (default: built-in secret).
+//   AUCTION_JWT_KEYS_FILE: file with one kid:secret per line; takes precedence
+//                         over AUCTION_JWT_KEYS and is re-read on SIGHUP.
+//   AUCTION_PUSH_MAX_BUFFERED: outbound bytes a WebSocket client may fall behind
+//                         before it is disconnected (default 1048576).
+//   AUCTION_PUSH_WRITE_BATCH_BYTES: most bytes of queued pushes sent in one socket
+//                         write; 0 for no limit (default 262144).
+//   AUCTION_PUSH_WRITE_BATCH_MESSAGES: most queued pushes sent in one socket write;
+//                         0 for no limit (default 32).
+//   AUCTION_PUSH_CORK:    0 sends every push as soon as it is queued instead of
+//                         gathering a burst into one write (default 1).
+//   AUCTION_ACCESS_LOG:   file to append one JSON line per request to (default:
+//                         no access log).
+//   AUCTION_ACCESS_LOG_MAX_MB: size in MiB at which the access log is rotated,
+//                         1 to 1048576 (default 64).
+//   AUCTION_ACCESS_LOG_FILES: rotated access logs kept as path.1 ... path.N,
+//                         0 to 1000 (default 5).
 
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/version.hpp>
+#include <boost/beast/websocket/rfc6455.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio.hpp>
+#include <charconv>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <thread>
@@ -28,9 +96,30 @@
 #include <random>
 #include <sstream>
 #include <chrono>
+#include <csignal>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <vector>
 #include <pqxx/pqxx>
 #include <nlohmann/json.hpp>
 #include <jwt-cpp/jwt.h> // jwt-cpp header
+#include "access_log.hpp"
+#include "db_pool.hpp"
+#include "auction_engine.hpp"
+#include "auction_store.hpp"
+#include "balance_ledger.hpp"
+#include "cpu_pool.hpp"
+#include "db_statements.hpp"
+#include "jwt_keys.hpp"
+#include "money.hpp"
+#include "password_hash.hpp"
+#include "push_hub.hpp"
+#include "push_session.hpp"
+#include "token_cache.hpp"
+#include "write_behind.hpp"
 
 using json = nlohmann::json;
 namespace beast = boost::beast; // from <boost/beast.hpp>
@@ -44,29 +133,65 @@ std::string db_connection_str =
     "ca-central-1.0043d35e-0abb-460d-8940-1948fd1bba9e.aws.yugabyte.cloud:5433/"
     "yugabyte?ssl=true&sslmode=verify-full&sslrootcert=certs/root.crt";
 
-// Define a secret key for JWT signing (store securely in production)
+// Connection pool shared by all handlers; created in main().
+std::unique_ptr<db_pool> db;
+
+// Workers for password hashing, kept off the network threads; created in main().
+std::unique_ptr<cpu_pool> password_hashers;
+
+// Background writer shared by the in-memory subsystems; created in main().
+std::unique_ptr<write_behind> background_writes;
+
+// Live auction state and its background persistence; created in main().
+std::unique_ptr<auction_engine> auctions;
+std::unique_ptr<auction_store> auction_writer;
+
+// Available/held funds of users who have bid or placed holds; created in main().
+std::unique_ptr<balance_ledger> ledger;
+
+// Server push: topic subscriptions and the WebSocket endpoint; created in main().
+std::unique_ptr<push_hub> pushes;
+std::unique_ptr<push_endpoint> push_server;
+
+// One line per HTTP request; created in main() when AUCTION_ACCESS_LOG is set.
+std::unique_ptr<access_log> access_logger;
+
+// Default secret key for JWT signing, used when no key ring is configured
+// (store securely in production).
 const std::string jwt_secret = "my_super_secret_key";
 
 // Helper: generate a JWT token with a 1-hour expiration.
 std::string generate_jwt_token(const std::string &username)
 {
-    auto token = jwt::create()
-                     .set_issuer("auction_server")
-                     .set_payload_claim("username", jwt::claim(username))
-                     .set_expires_at(std::chrono::system_clock::now() + std::chrono::hours(1))
-                     .sign(jwt::algorithm::hs256{jwt_secret});
-    return token;
+    return current_jwt_keyring().sign(username, std::chrono::system_clock::now() + std::chrono::hours(1));
 }
 
-// Helper: verify JWT token; return username if valid, or empty string if invalid.
-std::string verify_jwt_token(const std::string &token)
+// Tokens that already passed verification; created in main().
+std::unique_ptr<token_cache> verified_tokens;
+
+// Username of the last token verify_jwt_token accepted on this thread.
+// Sessions clear it before routing a request and take it afterwards, so
+// the access log can name the user without verifying the token again.
+thread_local std::string verified_user;
+
+// Helper: verify JWT token; return username if valid, or empty string if invalid,
+// and set expires to when the token stops being valid.
+// Repeat requests with the same token are answered from verified_tokens.
+std::string verify_jwt_token(const std::string &token, std::chrono::system_clock::time_point &expires)
 {
+    std::string username;
+    if (verified_tokens->lookup(token, username, expires))
+    {
+        verified_user = username;
+        return username;
+    }
     try
     {
-        auto decoded = jwt::decode(token);
-        jwt::verifier<jwt::default_clock> verifier(jwt::algorithm::hs256{jwt_secret});
-        verifier.verify(decoded);
-        return decoded.get_payload_claim("username").as_string();
+        std::uint64_t generation = verified_tokens->generation();
+        username = current_jwt_keyring().verify(token, expires);
+        verified_tokens->insert(token, username, expires, generation);
+        verified_user = username;
+        return username;
     }
     catch (...)
     {
@@ -74,6 +199,12 @@ std::string verify_jwt_token(const std::string &token)
     }
 }
 
+std::string verify_jwt_token(const std::string &token)
+{
+    std::chrono::system_clock::time_point expires;
+    return verify_jwt_token(token, expires);
+}
+
 // Helper: Create a JSON error response with CORS header.
 http::response<http::string_body> make_response(
     http::request<http::string_body> const &req,
@@ -91,6 +222,29 @@ http::response<http::string_body> make_response(
     return res;
 }
 
+// Helper: Create a JSON success response with CORS header.
+http::response<http::string_body> make_json_response(
+    http::request<http::string_body> const &req,
+    json const &body)
+{
+    http::response<http::string_body> res{http::status::ok, req.version()};
+    res.set(http::field::content_type, "application/json");
+    res.set(http::field::access_control_allow_origin, "*");
+    res.keep_alive(req.keep_alive());
+    res.body() = body.dump();
+    res.prepare_payload();
+    return res;
+}
+
+// Helper: Read a NUMERIC column as money without a string round-trip.
+money column_money(pqxx::field const &field)
+{
+    money value;
+    if (!money::parse(field.view(), value))
+        throw std::runtime_error("Malformed amount in database");
+    return value;
+}
+
 // Helper: Extract token from "Authorization: Bearer <token>" header.
 std::string extract_token(http::request<http::string_body> const &req)
 {
@@ -104,84 +258,163 @@ std::string extract_token(http::request<http::string_body> const &req)
     return "";
 }
 
-// Handle /register endpoint.
-http::response<http::string_body> handle_register(http::request<http::string_body> const &req)
+// Completion callback for handlers that finish asynchronously. It may be
+// called from any thread; the session resumes on its own strand. The
+// request passed to the handler stays valid until respond is called.
+using responder = std::function<void(http::response<http::string_body>)>;
+
+// Handle /register endpoint. The password is hashed on the CPU pool; the
+// insert then runs back on the connection's executor.
+void handle_register(http::request<http::string_body> const &req, net::any_io_executor ex, responder respond)
 {
+    std::string username, password;
     try
     {
         auto j = json::parse(req.body());
-        std::string username = j.at("username").get<std::string>();
-        std::string password = j.at("password").get<std::string>();
+        username = j.at("username").get<std::string>();
+        password = j.at("password").get<std::string>();
 
-        pqxx::connection C(db_connection_str);
-        if (!C.is_open())
-            return make_response(req, 500, "Database connection failed");
-
-        pqxx::work W(C);
-        auto result = W.exec("SELECT user_id FROM users WHERE username = $1", pqxx::params(username));
+        // Reject taken names before paying for a hash.
+        auto C = db->acquire();
+        pqxx::nontransaction N(*C);
+        auto result = N.exec_prepared(stmt::find_user_id, username);
         if (!result.empty())
-            return make_response(req, 400, "Username already exists");
-
-        W.exec("INSERT INTO users (username, password) VALUES ($1, $2)", pqxx::params(username, password));
-        W.commit();
-
-        json res_json;
-        res_json["message"] = "User registered successfully";
-        http::response<http::string_body> res{http::status::ok, req.version()};
-        res.set(http::field::content_type, "application/json");
-        res.set(http::field::access_control_allow_origin, "*");
-        res.keep_alive(req.keep_alive());
-        res.body() = res_json.dump();
-        res.prepare_payload();
-        return res;
+            return respond(make_response(req, 400, "Username already exists"));
+    }
+    catch (const db_pool_timeout &)
+    {
+        return respond(make_response(req, 503, "Database busy, try again later"));
     }
     catch (const std::exception &e)
     {
-        return make_response(req, 500, e.what());
+        return respond(make_response(req, 500, e.what()));
     }
+
+    bool queued = password_hashers->try_submit(
+        [&req, ex, respond, username, password]
+        {
+            std::string hashed;
+            try
+            {
+                hashed = hash_password(password);
+            }
+            catch (const std::exception &e)
+            {
+                return respond(make_response(req, 500, e.what()));
+            }
+            net::post(ex, [&req, respond, username, hashed]
+                      {
+                          try
+                          {
+                              auto C = db->acquire();
+                              pqxx::nontransaction N(*C);
+                              N.exec_prepared(stmt::insert_user, username, hashed);
+                          }
+                          catch (const pqxx::unique_violation &)
+                          {
+                              return respond(make_response(req, 400, "Username already exists"));
+                          }
+                          catch (const db_pool_timeout &)
+                          {
+                              return respond(make_response(req, 503, "Database busy, try again later"));
+                          }
+                          catch (const std::exception &e)
+                          {
+                              return respond(make_response(req, 500, e.what()));
+                          }
+
+                          json res_json;
+                          res_json["message"] = "User registered successfully";
+                          respond(make_json_response(req, res_json));
+                      });
+        });
+    if (!queued)
+        respond(make_response(req, 503, "Server busy, try again later"));
 }
 
-// Handle /login endpoint.
-http::response<http::string_body> handle_login(http::request<http::string_body> const &req)
+// Handle /login endpoint. The stored hash is fetched here; verification
+// runs on the CPU pool. Legacy plaintext passwords are upgraded to a hash
+// on their first successful login.
+void handle_login(http::request<http::string_body> const &req, net::any_io_executor ex, responder respond)
 {
+    std::string username, password, stored_password;
+    money balance;
+    bool known = false;
     try
     {
         auto j = json::parse(req.body());
-        std::string username = j.at("username").get<std::string>();
-        std::string password = j.at("password").get<std::string>();
-
-        pqxx::connection C(db_connection_str);
-        if (!C.is_open())
-            return make_response(req, 500, "Database connection failed");
+        username = j.at("username").get<std::string>();
+        password = j.at("password").get<std::string>();
 
-        pqxx::work W(C);
-        auto result = W.exec("SELECT password, balance FROM users WHERE username = $1", pqxx::params(username));
+        auto C = db->acquire();
+        pqxx::nontransaction N(*C);
+        auto result = N.exec_prepared(stmt::user_login, username);
         if (result.empty())
-            return make_response(req, 400, "Invalid username or password");
-
-        std::string stored_password = result[0]["password"].as<std::string>();
-        if (stored_password != password)
-            return make_response(req, 400, "Invalid username or password");
-
-        std::string token = generate_jwt_token(username);
-
-        json res_json;
-        res_json["message"] = "Login successful";
-        res_json["token"] = token;
-        res_json["username"] = username;
-        res_json["balance"] = result[0]["balance"].as<std::string>();
-        http::response<http::string_body> res{http::status::ok, req.version()};
-        res.set(http::field::content_type, "application/json");
-        res.set(http::field::access_control_allow_origin, "*");
-        res.keep_alive(req.keep_alive());
-        res.body() = res_json.dump();
-        res.prepare_payload();
-        return res;
+        {
+            // Unknown users still pay for a hash check, so timing does not
+            // reveal whether the account exists.
+            stored_password = dummy_password_hash();
+        }
+        else
+        {
+            known = true;
+            stored_password = result[0]["password"].as<std::string>();
+            balance = column_money(result[0]["balance"]);
+        }
+    }
+    catch (const db_pool_timeout &)
+    {
+        return respond(make_response(req, 503, "Database busy, try again later"));
     }
     catch (const std::exception &e)
     {
-        return make_response(req, 500, e.what());
+        return respond(make_response(req, 500, e.what()));
     }
+
+    bool queued = password_hashers->try_submit(
+        [&req, ex, respond, username, password, stored_password, balance, known]
+        {
+            // Everything here can throw, and the session waits without a
+            // deadline for its response, so every path must answer.
+            try
+            {
+                if (!verify_password(password, stored_password) || !known)
+                    return respond(make_response(req, 400, "Invalid username or password"));
+                std::string rehashed;
+                if (password_needs_rehash(stored_password))
+                    rehashed = hash_password(password);
+
+                json res_json;
+                res_json["message"] = "Login successful";
+                res_json["token"] = generate_jwt_token(username);
+                res_json["username"] = username;
+                res_json["balance"] = balance.to_string();
+                if (rehashed.empty())
+                    return respond(make_json_response(req, res_json));
+
+                net::post(ex, [&req, respond, username, rehashed, res_json]
+                          {
+                              try
+                              {
+                                  auto C = db->acquire();
+                                  pqxx::nontransaction N(*C);
+                                  N.exec_prepared(stmt::update_password, rehashed, username);
+                              }
+                              catch (const std::exception &e)
+                              {
+                                  // The login itself succeeded; retry the upgrade next time.
+                                  std::cerr << "password upgrade: " << e.what() << "\n";
+                              }
+                              respond(make_json_response(req, res_json));
+                          });
+            }
+            catch (const std::exception &e)
+            {
+                respond(make_response(req, 500, e.what()));
+            }
+        });
+    if (!queued)
+        respond(make_response(req, 503, "Server busy, try again later"));
 }
 
 // Handle /profile endpoint (GET): returns username and balance.
@@ -197,17 +430,22 @@ http::response<http::string_body> handle_profile(http::request<http::string_body
 
     try
     {
-        pqxx::connection C(db_connection_str);
-        if (!C.is_open())
-            return make_response(req, 500, "Database connection failed");
-        pqxx::work W(C);
-        auto result = W.exec("SELECT balance FROM users WHERE username = $1", pqxx::params(username));
+        auto C = db->acquire();
+        pqxx::work W(*C);
+        auto result = W.exec_prepared(stmt::user_balance, username);
         if (result.empty())
             return make_response(req, 404, "User not found");
 
+        // Accounts in the ledger report what holds and withdrawals are
+        // checked against; anyone else has nothing held.
+        balance_ledger::account funds{column_money(result[0]["balance"]), money(), money()};
+        ledger->lookup(username, funds);
+
         json res_json;
         res_json["username"] = username;
-        res_json["balance"] = result[0]["balance"].as<std::string>();
+        res_json["balance"] = funds.balance.to_string();
+        res_json["held"] = funds.held.to_string();
+        res_json["available"] = funds.available().to_string();
         http::response<http::string_body> res{http::status::ok, req.version()};
         res.set(http::field::content_type, "application/json");
         res.set(http::field::access_control_allow_origin, "*");
@@ -216,6 +454,10 @@ http::response<http::string_body> handle_profile(http::request<http::string_body
         res.prepare_payload();
         return res;
     }
+    catch (const db_pool_timeout &)
+    {
+        return make_response(req, 503, "Database busy, try again later");
+    }
     catch (const std::exception &e)
     {
         return make_response(req, 500, e.what());
@@ -236,19 +478,29 @@ http::response<http::string_body> handle_deposit(http::request<http::string_body
     try
     {
         auto j = json::parse(req.body());
-        double amount = j.at("amount").template get<double>();
-        if (amount <= 0)
+        money amount;
+        if (!money::parse(j.at("amount"), amount))
+            return make_response(req, 400, "Invalid amount");
+        if (!amount.positive())
             return make_response(req, 400, "Deposit amount must be positive");
 
-        pqxx::connection C(db_connection_str);
-        if (!C.is_open())
-            return make_response(req, 500, "Database connection failed");
-        pqxx::work W(C);
-        W.exec("UPDATE users SET balance = balance + $1 WHERE username = $2", pqxx::params(amount, username));
-        W.commit();
+        // Single-statement autocommit: one round-trip, and RETURNING saves
+        // the client a follow-up /profile request. The ledger account is
+        // loaded first so the credit below always lands on it.
+        if (!ledger->ensure_loaded(username))
+            return make_response(req, 404, "User not found");
+        auto C = db->acquire();
+        pqxx::nontransaction N(*C);
+        auto result = N.exec_prepared(stmt::deposit, money_text(amount).view(), username);
+        if (result.empty())
+            return make_response(req, 404, "User not found");
+
+        money balance = column_money(result[0]["balance"]);
+        ledger->credit(username, amount);
 
         json res_json;
         res_json["message"] = "Deposit successful";
+        res_json["balance"] = balance.to_string();
         http::response<http::string_body> res{http::status::ok, req.version()};
         res.set(http::field::content_type, "application/json");
         res.set(http::field::access_control_allow_origin, "*");
@@ -257,6 +509,10 @@ http::response<http::string_body> handle_deposit(http::request<http::string_body
         res.prepare_payload();
         return res;
     }
+    catch (const db_pool_timeout &)
+    {
+        return make_response(req, 503, "Database busy, try again later");
+    }
     catch (const std::exception &e)
     {
         return make_response(req, 500, e.what());
@@ -277,27 +533,50 @@ http::response<http::string_body> handle_withdraw(http::request<http::string_bod
     try
     {
         auto j = json::parse(req.body());
-        double amount = j.at("amount").template get<double>();
-        if (amount <= 0)
+        money amount;
+        if (!money::parse(j.at("amount"), amount))
+            return make_response(req, 400, "Invalid amount");
+        if (!amount.positive())
             return make_response(req, 400, "Withdrawal amount must be positive");
 
-        pqxx::connection C(db_connection_str);
-        if (!C.is_open())
-            return make_response(req, 500, "Database connection failed");
-        pqxx::work W(C);
-        auto result = W.exec("SELECT balance FROM users WHERE username = $1", pqxx::params(username));
-        if (result.empty())
+        // Held funds stay out of reach: the amount is reserved in the ledger
+        // first, then debited from the database.
+        if (!ledger->ensure_loaded(username))
             return make_response(req, 404, "User not found");
+        // Connect before reserving, so a pool timeout leaves nothing to refund.
+        auto C = db->acquire();
+        pqxx::nontransaction N(*C);
+        if (ledger->reserve_withdrawal(username, amount) == balance_ledger::withdrawal::insufficient)
+            return make_response(req, 400, "Insufficient funds");
 
-        double balance = std::stod(result[0]["balance"].as<std::string>());
-        if (balance < amount)
+        // A single conditional UPDATE both checks and debits the balance, so
+        // concurrent withdrawals cannot overdraw and the happy path costs one
+        // round-trip. It is atomic on its own, so no BEGIN/COMMIT is needed.
+        pqxx::result result;
+        try
+        {
+            result = N.exec_prepared(stmt::withdraw, money_text(amount).view(), username);
+        }
+        catch (...)
+        {
+            ledger->refund(username, amount);
+            throw;
+        }
+        if (result.empty())
+        {
+            ledger->refund(username, amount);
+            // Nothing was debited: find out why.
+            if (N.exec_prepared(stmt::user_balance, username).empty())
+                return make_response(req, 404, "User not found");
             return make_response(req, 400, "Insufficient funds");
+        }
 
-        W.exec("UPDATE users SET balance = balance - $1 WHERE username = $2", pqxx::params(amount, username));
-        W.commit();
+        money balance = column_money(result[0]["balance"]);
+        ledger->settle_withdrawal(username, amount);
 
         json res_json;
         res_json["message"] = "Withdrawal successful";
+        res_json["balance"] = balance.to_string();
         http::response<http::string_body> res{http::status::ok, req.version()};
         res.set(http::field::content_type, "application/json");
         res.set(http::field::access_control_allow_origin, "*");
@@ -306,80 +585,968 @@ http::response<http::string_body> handle_withdraw(http::request<http::string_bod
         res.prepare_payload();
         return res;
     }
+    catch (const db_pool_timeout &)
+    {
+        return make_response(req, 503, "Database busy, try again later");
+    }
     catch (const std::exception &e)
     {
         return make_response(req, 500, e.what());
     }
 }
 
-// Session handler: Reads a request, routes it, and writes a response.
-void do_session(beast::tcp_stream &stream)
+// Helper: JSON representation of an auction. The reserve price itself is
+// never published, only whether it has been met.
+json auction_json(auction_view const &a, std::int64_t at_ms)
+{
+    json j;
+    j["id"] = a.id;
+    j["title"] = a.title;
+    j["seller"] = a.seller;
+    j["starting_price"] = a.starting_price.to_string();
+    j["min_increment"] = a.min_increment.to_string();
+    j["starts_at"] = a.starts_at_ms;
+    j["ends_at"] = a.ends_at_ms;
+    j["status"] = a.status(at_ms);
+    j["bid_count"] = a.bid_count;
+    j["high_bid"] = a.bid_count ? json(a.high_bid.to_string()) : json(nullptr);
+    j["leader"] = a.bid_count ? json(a.leader) : json(nullptr);
+    j["reserve_met"] = a.reserve_met();
+    return j;
+}
+
+// Helper: Parse "/auctions/<id>" or "/auctions/<id>/bids". Returns false
+// for anything else.
+bool parse_auction_target(beast::string_view target, auction_id &id, bool &bids)
+{
+    const beast::string_view prefix = "/auctions/";
+    if (target.substr(0, prefix.size()) != prefix)
+        return false;
+    target.remove_prefix(prefix.size());
+
+    id = 0;
+    std::size_t digits = 0;
+    while (digits < target.size() && target[digits] >= '0' && target[digits] <= '9' && digits < 18)
+        id = id * 10 + static_cast<auction_id>(target[digits++] - '0');
+    if (digits == 0)
+        return false;
+    target.remove_prefix(digits);
+
+    bids = (target == "/bids");
+    return bids || target.empty();
+}
+
+// Helper: funds summary returned by /hold and /release.
+json funds_json(balance_ledger::account const &funds)
+{
+    return {{"balance", funds.balance.to_string()},
+            {"held", funds.held.to_string()},
+            {"available", funds.available().to_string()}};
+}
+
+// Helper: push a user's funds to their "balance" subscribers. Installed
+// as the ledger's change handler.
+void push_balance(const std::string &username, balance_ledger::account const &funds)
 {
-    beast::error_code ec;
-    beast::flat_buffer buffer;
-    http::request<http::string_body> req;
-    http::read(stream, buffer, req, ec);
-    if (ec == http::error::end_of_stream)
+    std::string topic = "balance:" + username;
+    if (!pushes->has_subscribers(topic))
         return;
-    if (ec)
-    {
-        std::cerr << "read: " << ec.message() << "\n";
+    json message = funds_json(funds);
+    message["type"] = "balance";
+    message["topic"] = "balance";
+    push_server->publish(topic, message.dump());
+}
+
+// Helper: push an auction's state to its subscribers.
+void push_auction(auction_view const &a, std::int64_t at_ms)
+{
+    std::string topic = "auction:" + std::to_string(a.id);
+    if (!pushes->has_subscribers(topic))
         return;
+    json message;
+    message["type"] = "auction";
+    message["topic"] = topic;
+    message["auction"] = auction_json(a, at_ms);
+    push_server->publish(topic, message.dump());
+}
+
+// Helper: map a topic requested over /ws to the hub topic, or empty if the
+// user may not subscribe to it. "balance" is always the caller's own.
+std::string resolve_push_topic(const std::string &username, const std::string &requested)
+{
+    if (requested == "balance")
+        return "balance:" + username;
+    auction_id id = 0;
+    bool bids = false;
+    if (requested.rfind("auction:", 0) == 0 &&
+        parse_auction_target("/auctions/" + requested.substr(8), id, bids) && !bids)
+        return "auction:" + std::to_string(id);
+    return {};
+}
+
+// Helper: Read an optional amount field; missing means fallback.
+bool optional_money(json const &j, const char *field, money fallback, money &out)
+{
+    if (!j.contains(field))
+    {
+        out = fallback;
+        return true;
+    }
+    return money::parse(j.at(field), out);
+}
+
+// Longest duration_seconds POST /auctions accepts (ten years).
+constexpr std::int64_t max_auction_seconds = 10ll * 366 * 24 * 3600;
+
+// Handle POST /auctions: create an auction owned by the caller. Completes
+// once the owning shard has stored it.
+//
+// The auction handlers below keep shard callbacks to a copy of the result
+// and a post to the connection's executor ex: persisting, ledger updates,
+// pushes and JSON all run there, so shard threads never wait on another
+// subsystem's locks. Each posted continuation answers 500 on failure: an
+// exception escaping it would end the process.
+void handle_create_auction(http::request<http::string_body> const &req, net::any_io_executor ex, responder respond)
+{
+    std::string token = extract_token(req);
+    if (token.empty())
+        return respond(make_response(req, 401, "Missing token"));
+
+    std::string username = verify_jwt_token(token);
+    if (username.empty())
+        return respond(make_response(req, 401, "Invalid or expired token"));
+
+    try
+    {
+        auto j = json::parse(req.body());
+        auction_spec spec;
+        spec.seller = username;
+        spec.title = j.at("title").get<std::string>();
+        if (spec.title.empty())
+            return respond(make_response(req, 400, "Title must not be empty"));
+
+        if (!money::parse(j.at("starting_price"), spec.starting_price) ||
+            !optional_money(j, "reserve", money(), spec.reserve) ||
+            !optional_money(j, "min_increment", money::from_minor(money::scale), spec.min_increment))
+            return respond(make_response(req, 400, "Invalid amount"));
+        if (spec.starting_price < money() || spec.reserve < money() || !spec.min_increment.positive())
+            return respond(make_response(req, 400, "Prices must not be negative and the increment must be positive"));
+
+        std::int64_t now = now_ms();
+        spec.starts_at_ms = j.value("starts_at", now);
+        if (j.contains("ends_at"))
+            spec.ends_at_ms = j.at("ends_at").get<std::int64_t>();
+        else
+        {
+            std::int64_t duration = j.at("duration_seconds").get<std::int64_t>();
+            if (duration <= 0 || duration > max_auction_seconds ||
+                __builtin_add_overflow(spec.starts_at_ms, 1000 * duration, &spec.ends_at_ms))
+                return respond(make_response(req, 400, "duration_seconds is out of range"));
+        }
+        if (spec.ends_at_ms <= spec.starts_at_ms || spec.ends_at_ms <= now)
+            return respond(make_response(req, 400, "Auction must end after it starts and in the future"));
+
+        auctions->create(spec,
+                         [&req, ex, respond, now](bool, auction_view created)
+                         {
+                             net::post(ex, [&req, respond, now, created = std::move(created)]
+                                       {
+                                           try
+                                           {
+                                               auction_writer->record_auction(created);
+                                               json res_json;
+                                               res_json["message"] = "Auction created";
+                                               res_json["auction"] = auction_json(created, now);
+                                               respond(make_json_response(req, res_json));
+                                           }
+                                           catch (const std::exception &e)
+                                           {
+                                               respond(make_response(req, 500, e.what()));
+                                           }
+                                       });
+                         });
+    }
+    catch (const std::exception &e)
+    {
+        respond(make_response(req, 400, e.what()));
+    }
+}
+
+// Handle GET /auctions: list all auctions.
+void handle_list_auctions(http::request<http::string_body> const &req, net::any_io_executor ex, responder respond)
+{
+    auctions->list(
+        [&req, ex, respond](std::vector<auction_view> all)
+        {
+            net::post(ex, [&req, respond, all = std::move(all)]
+                      {
+                          try
+                          {
+                              std::int64_t now = now_ms();
+                              json list = json::array();
+                              for (auto const &a : all)
+                                  list.push_back(auction_json(a, now));
+
+                              json res_json;
+                              res_json["auctions"] = std::move(list);
+                              respond(make_json_response(req, res_json));
+                          }
+                          catch (const std::exception &e)
+                          {
+                              respond(make_response(req, 500, e.what()));
+                          }
+                      });
+        });
+}
+
+// Handle GET /auctions/<id>.
+void handle_get_auction(http::request<http::string_body> const &req, auction_id id, net::any_io_executor ex,
+                        responder respond)
+{
+    auctions->get(id,
+                  [&req, ex, respond](bool found, auction_view a)
+                  {
+                      net::post(ex, [&req, respond, found, a = std::move(a)]
+                                {
+                                    if (!found)
+                                        return respond(make_response(req, 404, "Auction not found"));
+                                    try
+                                    {
+                                        json res_json;
+                                        res_json["auction"] = auction_json(a, now_ms());
+                                        respond(make_json_response(req, res_json));
+                                    }
+                                    catch (const std::exception &e)
+                                    {
+                                        respond(make_response(req, 500, e.what()));
+                                    }
+                                });
+                  });
+}
+
+// Handle POST /auctions/<id>/bids: JSON { "amount": <number or decimal string> }.
+// The bid is decided by the shard that owns the auction; the holds are
+// settled, the bid persisted and pushed and the response built back on
+// the connection's executor.
+void handle_place_bid(http::request<http::string_body> const &req, auction_id id, net::any_io_executor ex,
+                      responder respond)
+{
+    std::string token = extract_token(req);
+    if (token.empty())
+        return respond(make_response(req, 401, "Missing token"));
+
+    std::string username = verify_jwt_token(token);
+    if (username.empty())
+        return respond(make_response(req, 401, "Invalid or expired token"));
+
+    money amount;
+    try
+    {
+        auto j = json::parse(req.body());
+        if (!money::parse(j.at("amount"), amount))
+            return respond(make_response(req, 400, "Invalid amount"));
+    }
+    catch (const std::exception &e)
+    {
+        return respond(make_response(req, 400, e.what()));
+    }
+    if (!amount.positive())
+        return respond(make_response(req, 400, "Bid amount must be positive"));
+
+    // Hold the bid amount before the shard sees it, so a bidder can never
+    // lead more auctions than their balance covers.
+    hold_id hold = 0;
+    try
+    {
+        if (!ledger->ensure_loaded(username))
+            return respond(make_response(req, 404, "User not found"));
+        balance_ledger::account funds;
+        hold = ledger->hold(username, amount, hold_kind::bid, funds);
+    }
+    catch (const db_pool_timeout &)
+    {
+        return respond(make_response(req, 503, "Database busy, try again later"));
+    }
+    catch (const std::exception &e)
+    {
+        return respond(make_response(req, 500, e.what()));
+    }
+    if (hold == 0)
+        return respond(make_response(req, 400, "Insufficient funds"));
+
+    std::int64_t now = now_ms();
+    auctions->place_bid(
+        id, username, amount, hold, now,
+        [&req, ex, respond, id, username, amount, hold, now](bid_outcome const &result, auction_view view)
+        {
+            net::post(ex, [&req, respond, id, username, amount, hold, now, outcome = result, a = std::move(view)]
+                      {
+                          try
+                          {
+                              if (outcome.status != bid_status::accepted)
+                                  ledger->release(hold);
+                              else if (outcome.outbid_hold != 0)
+                                  ledger->release(outcome.outbid_hold);
+
+                              switch (outcome.status)
+                              {
+                              case bid_status::not_found:
+                                  return respond(make_response(req, 404, "Auction not found"));
+                              case bid_status::not_open:
+                                  return respond(make_response(req, 409, "Auction is not open for bidding"));
+                              case bid_status::own_auction:
+                                  return respond(make_response(req, 403, "Cannot bid on your own auction"));
+                              case bid_status::too_low:
+                                  return respond(make_response(req, 400, "Bid must be at least " + outcome.minimum_bid.to_string()));
+                              case bid_status::accepted:
+                                  break;
+                              }
+                              auction_writer->record_bid(id, username, amount, outcome.bid_count, hold, now);
+                              push_auction(a, now);
+
+                              json res_json;
+                              res_json["message"] = "Bid accepted";
+                              res_json["auction"] = auction_json(a, now);
+                              respond(make_json_response(req, res_json));
+                          }
+                          catch (const std::exception &e)
+                          {
+                              respond(make_response(req, 500, e.what()));
+                          }
+                      });
+        });
+}
+
+// Helper: settle one closed auction. When the reserve is met the leader
+// pays the seller out of the bid's hold; otherwise, or if the seller no
+// longer exists, the hold is released. Returns false if it should be
+// retried, e.g. the database was busy. Settling twice is harmless: a
+// captured or released hold is gone.
+bool settle_auction(auction_view const &a, std::int64_t now)
+{
+    try
+    {
+        if (a.leader_hold != 0)
+        {
+            if (a.reserve_met() && ledger->ensure_loaded(a.seller))
+                ledger->capture(a.leader_hold, a.seller);
+            else
+                ledger->release(a.leader_hold);
+        }
+        auction_writer->record_settled(a.id);
+        push_auction(a, now);
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Settling auction " << a.id << " failed: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// How often ended auctions are closed and settled.
+constexpr std::chrono::milliseconds settle_interval{1000};
+
+// Helper: every settle_interval, close the auctions that have ended and
+// settle them, together with the ones a previous round had to retry.
+void settle_ended_auctions(net::steady_timer &timer, std::vector<auction_view> retry)
+{
+    timer.expires_after(settle_interval);
+    timer.async_wait(
+        [&timer, retry = std::move(retry)](beast::error_code ec) mutable
+        {
+            if (ec)
+                return;
+            auctions->close_ended(
+                now_ms(),
+                [&timer, retry = std::move(retry)](std::vector<auction_view> closed) mutable
+                {
+                    retry.insert(retry.end(), std::make_move_iterator(closed.begin()),
+                                 std::make_move_iterator(closed.end()));
+                    net::post(timer.get_executor(), [&timer, pending = std::move(retry)]
+                              {
+                                  std::int64_t now = now_ms();
+                                  std::vector<auction_view> failed;
+                                  for (auto const &a : pending)
+                                      if (!settle_auction(a, now))
+                                          failed.push_back(a);
+                                  settle_ended_auctions(timer, std::move(failed));
+                              });
+                });
+        });
+}
+
+// Handle /hold endpoint (POST): reserve funds from the available balance.
+// Decided in memory; only the first operation for a user reads the
+// database, and the hold itself is persisted in the background.
+http::response<http::string_body> handle_hold(http::request<http::string_body> const &req)
+{
+    std::string token = extract_token(req);
+    if (token.empty())
+        return make_response(req, 401, "Missing token");
+
+    std::string username = verify_jwt_token(token);
+    if (username.empty())
+        return make_response(req, 401, "Invalid or expired token");
+
+    try
+    {
+        auto j = json::parse(req.body());
+        money amount;
+        if (!money::parse(j.at("amount"), amount))
+            return make_response(req, 400, "Invalid amount");
+        if (!amount.positive())
+            return make_response(req, 400, "Hold amount must be positive");
+
+        if (!ledger->ensure_loaded(username))
+            return make_response(req, 404, "User not found");
+        balance_ledger::account funds;
+        hold_id id = ledger->hold(username, amount, hold_kind::request, funds);
+        if (id == 0)
+            return make_response(req, 400, "Insufficient funds");
+
+        json res_json = funds_json(funds);
+        res_json["message"] = "Funds held";
+        res_json["hold_id"] = id;
+        return make_json_response(req, res_json);
+    }
+    catch (const db_pool_timeout &)
+    {
+        return make_response(req, 503, "Database busy, try again later");
+    }
+    catch (const std::exception &e)
+    {
+        return make_response(req, 500, e.what());
     }
+}
+
+// Handle /release endpoint (POST): return one of the caller's holds to
+// their available balance.
+http::response<http::string_body> handle_release(http::request<http::string_body> const &req)
+{
+    std::string token = extract_token(req);
+    if (token.empty())
+        return make_response(req, 401, "Missing token");
+
+    std::string username = verify_jwt_token(token);
+    if (username.empty())
+        return make_response(req, 401, "Invalid or expired token");
 
-    http::response<http::string_body> res;
+    hold_id id = 0;
+    try
+    {
+        id = json::parse(req.body()).at("hold_id").get<hold_id>();
+    }
+    catch (const std::exception &e)
+    {
+        return make_response(req, 400, e.what());
+    }
+
+    balance_ledger::account funds;
+    switch (ledger->release(id, username, funds))
+    {
+    case balance_ledger::release_result::not_found:
+        return make_response(req, 404, "Hold not found");
+    case balance_ledger::release_result::bid_backed:
+        return make_response(req, 409, "Hold backs a bid; it is released when the bid is outbid");
+    case balance_ledger::release_result::released:
+        break;
+    }
+
+    json res_json = funds_json(funds);
+    res_json["message"] = "Hold released";
+    return make_json_response(req, res_json);
+}
+
+// Handle /metrics endpoint (GET): reports connection pool, token cache,
+// password hashing, background write, ledger and auction shard statistics.
+http::response<http::string_body> handle_metrics(http::request<http::string_body> const &req)
+{
+    auto pool = db->snapshot();
+    auto tokens = verified_tokens->snapshot();
+    auto hashing = password_hashers->snapshot();
+    auto persistence = background_writes->snapshot();
+    auto funds = ledger->snapshot();
+    auto topics = pushes->snapshot();
+    auto sockets = push_server->snapshot();
+    auto shard_commands = auctions->processed();
+    json res_json;
+    res_json["db_pool"] = {
+        {"open", pool.open},
+        {"idle", pool.idle},
+        {"in_use", pool.in_use},
+        {"max_size", pool.max_size},
+        {"utilization", pool.max_size ? static_cast<double>(pool.in_use) / pool.max_size : 0.0},
+        {"checkouts", pool.checkouts},
+        {"timeouts", pool.timeouts},
+        {"evictions", pool.evictions},
+        {"avg_wait_ms", pool.avg_wait_ms},
+        {"max_wait_ms", pool.max_wait_ms}};
+    res_json["jwt_cache"] = {
+        {"size", tokens.size},
+        {"capacity", tokens.capacity},
+        {"hits", tokens.hits},
+        {"misses", tokens.misses},
+        {"evictions", tokens.evictions}};
+    res_json["password_hashing"] = {
+        {"threads", hashing.threads},
+        {"queued", hashing.queued},
+        {"max_queue", hashing.max_queue},
+        {"completed", hashing.completed},
+        {"rejected", hashing.rejected},
+        {"avg_queue_ms", hashing.avg_queue_ms},
+        {"max_queue_ms", hashing.max_queue_ms},
+        {"avg_run_ms", hashing.avg_run_ms},
+        {"max_run_ms", hashing.max_run_ms}};
+    res_json["write_behind"] = {
+        {"pending", persistence.pending},
+        {"written", persistence.written},
+        {"failed_batches", persistence.failed_batches},
+        {"dead_letters", persistence.dead_letters}};
+    res_json["ledger"] = {
+        {"accounts", funds.accounts},
+        {"holds", funds.holds},
+        {"held", funds.held.to_string()},
+        {"loads", funds.loads},
+        {"rejected_holds", funds.rejected_holds},
+        {"overcommitted", funds.overcommitted}};
+    res_json["push"] = {
+        {"open", sockets.open},
+        {"accepted", sockets.accepted},
+        {"rejected", sockets.rejected},
+        {"conflated", sockets.conflated},
+        {"overflowed", sockets.overflowed},
+        {"timed_out", sockets.timed_out},
+        {"expired", sockets.expired},
+        {"writes", sockets.writes},
+        {"messages_written", sockets.messages_written},
+        {"writes_per_message", sockets.messages_written
+                                   ? static_cast<double>(sockets.writes) / sockets.messages_written
+                                   : 0.0},
+        {"topics", topics.topics},
+        {"subscriptions", topics.subscriptions},
+        {"published", topics.published},
+        {"delivered", topics.delivered}};
+    if (access_logger)
+    {
+        auto logged = access_logger->snapshot();
+        res_json["access_log"] = {
+            {"written", logged.written},
+            {"dropped", logged.dropped},
+            {"rotations", logged.rotations},
+            {"write_errors", logged.write_errors}};
+    }
+    res_json["auction_shards"] = {
+        {"count", shard_commands.size()},
+        {"processed", shard_commands}};
+    return make_json_response(req, res_json);
+}
+
+// Route a parsed request to its endpoint handler. ex is the connection's
+// executor, for handlers that hand work to another thread and resume.
+void handle_request(http::request<http::string_body> const &req, net::any_io_executor ex, responder respond)
+{
+    auction_id id = 0;
+    bool bids = false;
     if (req.method() == http::verb::post)
     {
         if (req.target() == "/register")
-            res = handle_register(req);
-        else if (req.target() == "/login")
-            res = handle_login(req);
-        else if (req.target() == "/deposit")
-            res = handle_deposit(req);
-        else if (req.target() == "/withdraw")
-            res = handle_withdraw(req);
-        else
-            res = make_response(req, 404, "Not Found");
+            return handle_register(req, std::move(ex), std::move(respond));
+        if (req.target() == "/login")
+            return handle_login(req, std::move(ex), std::move(respond));
+        if (req.target() == "/deposit")
+            return respond(handle_deposit(req));
+        if (req.target() == "/withdraw")
+            return respond(handle_withdraw(req));
+        if (req.target() == "/hold")
+            return respond(handle_hold(req));
+        if (req.target() == "/release")
+            return respond(handle_release(req));
+        if (req.target() == "/auctions")
+            return handle_create_auction(req, std::move(ex), std::move(respond));
+        if (parse_auction_target(req.target(), id, bids) && bids)
+            return handle_place_bid(req, id, std::move(ex), std::move(respond));
+        return respond(make_response(req, 404, "Not Found"));
     }
-    else if (req.method() == http::verb::get)
+    if (req.method() == http::verb::get)
     {
         if (req.target() == "/profile")
-            res = handle_profile(req);
+            return respond(handle_profile(req));
+        if (req.target() == "/metrics")
+            return respond(handle_metrics(req));
+        if (req.target() == "/auctions")
+            return handle_list_auctions(req, std::move(ex), std::move(respond));
+        if (parse_auction_target(req.target(), id, bids) && !bids)
+            return handle_get_auction(req, id, std::move(ex), std::move(respond));
+        return respond(make_response(req, 404, "Not Found"));
+    }
+    respond(make_response(req, 405, "Method Not Allowed"));
+}
+
+// Per-connection limits for persistent (keep-alive) connections.
+struct session_limits
+{
+    std::chrono::seconds idle_timeout{30}; // close if no request arrives within this time
+    unsigned max_requests = 100;           // close after serving this many requests
+};
+
+// Session: owns one connection. All I/O is asynchronous and runs on the
+// connection's strand, so an idle socket costs only this object and its
+// buffers rather than a dedicated thread. Requests are served in order on
+// a persistent connection until the client or a limit ends it.
+class session : public std::enable_shared_from_this<session>
+{
+    beast::tcp_stream stream_;
+    beast::flat_buffer buffer_;
+    http::request<http::string_body> req_;
+    http::response<http::string_body> res_;
+    session_limits limits_;
+    unsigned served_ = 0;
+
+    // For the access log entry of the request being served.
+    std::chrono::steady_clock::time_point read_at_;
+    std::chrono::nanoseconds db_time_{0};
+    std::string user_;
+
+public:
+    session(tcp::socket &&socket, session_limits limits)
+        : stream_(std::move(socket)), limits_(limits)
+    {
+    }
+
+    // Start the session on the connection's strand.
+    void run()
+    {
+        net::dispatch(stream_.get_executor(),
+                      beast::bind_front_handler(&session::do_read, shared_from_this()));
+    }
+
+private:
+    void do_read()
+    {
+        // buffer_ is kept across requests: bytes of pipelined requests that
+        // arrived with the previous one are parsed from it before the
+        // socket is read again.
+        req_ = {};
+        stream_.expires_after(limits_.idle_timeout);
+        http::async_read(stream_, buffer_, req_,
+                         beast::bind_front_handler(&session::on_read, shared_from_this()));
+    }
+
+    void on_read(beast::error_code ec, std::size_t)
+    {
+        if (ec == http::error::end_of_stream || ec == beast::error::timeout)
+            return do_close();
+        if (ec)
+        {
+            std::cerr << "read: " << ec.message() << "\n";
+            return;
+        }
+
+        // WebSocket upgrades to /ws leave HTTP: the push endpoint takes the
+        // socket and any bytes already buffered after the request.
+        if (beast::websocket::is_upgrade(req_) &&
+            req_.target().substr(0, req_.target().find('?')) == "/ws")
+        {
+            stream_.expires_never();
+            return push_server->accept(stream_.release_socket(), req_, buffer_);
+        }
+
+        // Nothing else is read until the response is written, so req_ stays
+        // valid for handlers that complete on another thread.
+        stream_.expires_never();
+
+        // Database time is collected on each thread that runs part of the
+        // request: here for the synchronous part, and in the responder
+        // for continuations that finish elsewhere.
+        read_at_ = std::chrono::steady_clock::now();
+        db_pool::take_thread_time(); // not this request's
+        db_time_ = {};
+        verified_user.clear();
+        handle_request(req_, stream_.get_executor(),
+                       [self = shared_from_this()](http::response<http::string_body> res)
+                       {
+                           auto db_time = db_pool::take_thread_time();
+                           net::dispatch(self->stream_.get_executor(),
+                                         [self, res = std::move(res), db_time]() mutable
+                                         {
+                                             self->db_time_ += db_time;
+                                             self->send(std::move(res));
+                                         });
+                       });
+        db_time_ += db_pool::take_thread_time();
+        user_ = std::move(verified_user);
+    }
+
+    void send(http::response<http::string_body> res)
+    {
+        res_ = std::move(res);
+        if (++served_ >= limits_.max_requests)
+            res_.keep_alive(false);
+
+        stream_.expires_after(limits_.idle_timeout);
+        http::async_write(stream_, res_,
+                          beast::bind_front_handler(&session::on_write, shared_from_this()));
+    }
+
+    void on_write(beast::error_code ec, std::size_t bytes)
+    {
+        if (access_logger)
+            log_request(bytes);
+        if (ec)
+        {
+            std::cerr << "write: " << ec.message() << "\n";
+            return;
+        }
+        if (res_.need_eof())
+            return do_close();
+        do_read();
+    }
+
+    void log_request(std::size_t bytes)
+    {
+        using namespace std::chrono;
+        auto latency = duration_cast<microseconds>(steady_clock::now() - read_at_);
+        auto read_at = system_clock::now() - latency;
+
+        access_entry entry;
+        entry.time_us = duration_cast<microseconds>(read_at.time_since_epoch()).count();
+        entry.latency_us = static_cast<std::uint32_t>(latency.count());
+        entry.db_us = static_cast<std::uint32_t>(duration_cast<microseconds>(db_time_).count());
+        entry.bytes = bytes;
+        entry.status = static_cast<std::uint16_t>(res_.result_int());
+        auto method = req_.method_string();
+        entry.set_method(method.data(), method.size());
+        auto target = req_.target();
+        entry.set_target(target.data(), target.size());
+        entry.set_user(user_.data(), user_.size());
+        access_logger->record(entry);
+    }
+
+    void do_close()
+    {
+        beast::error_code ec;
+        stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+        stream_.socket().close(ec);
+    }
+};
+
+// Listener: accepts incoming connections and launches a session for each.
+class listener : public std::enable_shared_from_this<listener>
+{
+    net::io_context &ioc_;
+    tcp::acceptor acceptor_;
+    session_limits limits_;
+
+public:
+    listener(net::io_context &ioc, tcp::endpoint endpoint, session_limits limits)
+        : ioc_(ioc), acceptor_(net::make_strand(ioc)), limits_(limits)
+    {
+        acceptor_.open(endpoint.protocol());
+        acceptor_.set_option(net::socket_base::reuse_address(true));
+        acceptor_.bind(endpoint);
+        acceptor_.listen(net::socket_base::max_listen_connections);
+    }
+
+    void run()
+    {
+        do_accept();
+    }
+
+private:
+    void do_accept()
+    {
+        // Each connection gets its own strand so its handlers never run
+        // concurrently, while different connections spread over all threads.
+        acceptor_.async_accept(net::make_strand(ioc_),
+                               beast::bind_front_handler(&listener::on_accept, shared_from_this()));
+    }
+
+    void on_accept(beast::error_code ec, tcp::socket socket)
+    {
+        if (ec)
+            std::cerr << "accept: " << ec.message() << "\n";
         else
-            res = make_response(req, 404, "Not Found");
+            std::make_shared<session>(std::move(socket), limits_)->run();
+        do_accept();
     }
-    else
+};
+
+// Helper: read a positive integer setting from the environment, or return the default.
+int env_int(const char *name, int fallback)
+{
+    const char *value = std::getenv(name);
+    if (!value || !*value)
+        return fallback;
+    int parsed = std::atoi(value);
+    return parsed > 0 ? parsed : fallback;
+}
+
+// Helper: read a size setting from the environment, or return the default.
+// Anything that is not a whole number in [min, max] is rejected at startup
+// rather than cast or silently replaced.
+std::uint64_t env_size(const char *name, std::uint64_t fallback, std::uint64_t min,
+                       std::uint64_t max = std::numeric_limits<std::uint64_t>::max())
+{
+    const char *value = std::getenv(name);
+    if (!value || !*value)
+        return fallback;
+    std::uint64_t parsed = 0;
+    const char *end = value + std::strlen(value);
+    auto res = std::from_chars(value, end, parsed);
+    if (res.ec != std::errc() || res.ptr != end || parsed < min || parsed > max)
+        throw std::invalid_argument(std::string(name) + " must be a whole number from " +
+                                    std::to_string(min) + " to " + std::to_string(max));
+    return parsed;
+}
+
+// Helper: build the JWT key ring from AUCTION_JWT_KEYS_FILE, else
+// AUCTION_JWT_KEYS, else the built-in secret under kid "default".
+std::shared_ptr<const jwt_keyring> load_jwt_keyring()
+{
+    std::string spec;
+    if (const char *path = std::getenv("AUCTION_JWT_KEYS_FILE"))
     {
-        res = make_response(req, 405, "Method Not Allowed");
+        std::ifstream file(path);
+        if (!file)
+            throw std::runtime_error(std::string("Cannot read JWT key file ") + path);
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        spec = contents.str();
     }
+    else if (const char *keys = std::getenv("AUCTION_JWT_KEYS"))
+        spec = keys;
 
-    http::write(stream, res, ec);
-    if (ec)
-        std::cerr << "write: " << ec.message() << "\n";
+    auto keys = jwt_keyring::parse(spec);
+    if (keys.empty())
+        keys.push_back({"default", jwt_secret});
+    return std::make_shared<const jwt_keyring>(keys);
+}
 
-    auto &sock = boost::beast::get_lowest_layer(stream);
-    sock.close();
+// Helper: reload the JWT key ring whenever the process receives SIGHUP.
+void watch_key_rotation(net::signal_set &signals)
+{
+    signals.async_wait(
+        [&signals](beast::error_code ec, int)
+        {
+            if (ec)
+                return;
+            try
+            {
+                install_jwt_keyring(load_jwt_keyring());
+                // Tokens signed by a retired key must not outlive it in the cache.
+                verified_tokens->clear();
+                std::cout << "JWT keys reloaded" << std::endl;
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "JWT key reload failed: " << e.what() << std::endl;
+            }
+            watch_key_rotation(signals);
+        });
 }
 
-// Main server: Listens on port 9002 and spawns a session per connection.
+// Main server: Listens on port 9002 and serves all connections from one
+// io_context run by AUCTION_THREADS worker threads (default: one per core).
 int main()
 {
     try
     {
         auto const address = net::ip::make_address("0.0.0.0");
         unsigned short port = 9002;
-        net::io_context ioc{1};
-        tcp::acceptor acceptor{ioc, {address, port}};
-        std::cout << "HTTP server started on port " << port << std::endl;
-        for (;;)
+        int cores = static_cast<int>(std::thread::hardware_concurrency());
+        int threads = env_int("AUCTION_THREADS", cores > 0 ? cores : 1);
+
+        session_limits limits;
+        limits.idle_timeout = std::chrono::seconds(env_int("AUCTION_IDLE_TIMEOUT", 30));
+        limits.max_requests = static_cast<unsigned>(env_int("AUCTION_MAX_REQUESTS", 100));
+
+        {
+            // Schema changes run once here; pooled connections only prepare.
+            pqxx::connection schema(db_connection_str);
+            create_tables(schema);
+        }
+
+        db_pool_options pool_options;
+        pool_options.conninfo = db_connection_str;
+        pool_options.on_connect = prepare_statements;
+        pool_options.min_size = static_cast<std::size_t>(env_int("AUCTION_DB_POOL_MIN", 2));
+        pool_options.max_size = static_cast<std::size_t>(env_int("AUCTION_DB_POOL_MAX", 16));
+        pool_options.checkout_timeout = std::chrono::milliseconds(env_int("AUCTION_DB_CHECKOUT_MS", 2000));
+        db = std::make_unique<db_pool>(pool_options);
+        int hash_threads = env_int("AUCTION_HASH_THREADS", cores > 1 ? cores / 2 : 1);
+        password_hashers = std::make_unique<cpu_pool>(
+            static_cast<std::size_t>(hash_threads),
+            static_cast<std::size_t>(env_int("AUCTION_HASH_QUEUE", 256)));
+        dummy_password_hash(); // computed now rather than on the first unknown login
+        verified_tokens = std::make_unique<token_cache>(
+            static_cast<std::size_t>(env_int("AUCTION_JWT_CACHE_SIZE", 65536)));
+        try
+        {
+            db->warm_up();
+        }
+        catch (const std::exception &e)
+        {
+            // Not fatal: the pool opens connections on demand once the database is reachable.
+            std::cerr << "Database warm-up failed: " << e.what() << std::endl;
+        }
+
+        // Auction ids and hold ids continue from the stored ones, so these
+        // must succeed.
+        background_writes = std::make_unique<write_behind>(*db);
+        auctions = std::make_unique<auction_engine>(
+            static_cast<std::size_t>(env_int("AUCTION_BID_SHARDS", cores > 1 ? cores / 2 : 1)));
+        auction_writer = std::make_unique<auction_store>(*db, *background_writes);
+        auction_writer->load(*auctions);
+        ledger = std::make_unique<balance_ledger>(*db, *background_writes);
+        ledger->reconcile();
+
+        pushes = std::make_unique<push_hub>();
+        push_options push_settings;
+        push_settings.authenticate = [](const std::string &token, std::chrono::system_clock::time_point &expires)
+        { return verify_jwt_token(token, expires); };
+        push_settings.resolve_topic = resolve_push_topic;
+        push_settings.max_buffered_bytes =
+            static_cast<std::size_t>(env_size("AUCTION_PUSH_MAX_BUFFERED", 1024 * 1024, 0));
+        push_settings.write_batch_bytes = static_cast<std::size_t>(
+            env_size("AUCTION_PUSH_WRITE_BATCH_BYTES", 256 * 1024, 0, std::numeric_limits<std::size_t>::max()));
+        push_settings.write_batch_messages = static_cast<std::size_t>(
+            env_size("AUCTION_PUSH_WRITE_BATCH_MESSAGES", 32, 0, std::numeric_limits<std::size_t>::max()));
+        const char *cork = std::getenv("AUCTION_PUSH_CORK");
+        push_settings.cork_bursts = !cork || std::strcmp(cork, "0") != 0;
+        push_server = std::make_unique<push_endpoint>(*pushes, push_settings);
+
+        const char *access_log_path = std::getenv("AUCTION_ACCESS_LOG");
+        if (access_log_path && *access_log_path)
         {
-            tcp::socket socket{ioc};
-            acceptor.accept(socket);
-            beast::tcp_stream stream(std::move(socket));
-            std::thread([s = std::move(stream)]() mutable
-                        { do_session(s); })
-                .detach();
+            access_log_options log_options;
+            log_options.path = access_log_path;
+            log_options.max_file_bytes = env_size("AUCTION_ACCESS_LOG_MAX_MB", 64, 1, 1024 * 1024) * 1024 * 1024;
+            log_options.max_files = static_cast<std::size_t>(env_size("AUCTION_ACCESS_LOG_FILES", 5, 0, 1000));
+            access_logger = std::make_unique<access_log>(log_options);
         }
+        ledger->on_change(push_balance);
+
+        install_jwt_keyring(load_jwt_keyring());
+
+        net::io_context ioc{threads};
+        net::signal_set key_rotation{ioc, SIGHUP};
+        watch_key_rotation(key_rotation);
+        net::steady_timer settlement{ioc};
+        settle_ended_auctions(settlement, {});
+        std::make_shared<listener>(ioc, tcp::endpoint{address, port}, limits)->run();
+        std::cout << "HTTP server started on port " << port
+                  << " with " << threads << " threads" << std::endl;
+
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        for (int i = 1; i < threads; ++i)
+            workers.emplace_back([&ioc]
+                                 { ioc.run(); });
+        ioc.run();
+
+        for (auto &t : workers)
+            t.join();
     }
     catch (const std::exception &e)
     {
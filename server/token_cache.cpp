@@ -0,0 +1,114 @@
+// File: token_cache.cpp
+// Implementation of the verified-token cache.
+
+#include "token_cache.hpp"
+
+#include <functional>
+
+token_cache::token_cache(std::size_t capacity, std::size_t shard_count)
+    : shards_(new shard[shard_count ? shard_count : 1]),
+      shard_count_(shard_count ? shard_count : 1),
+      shard_capacity_(capacity / (shard_count ? shard_count : 1))
+{
+    if (shard_capacity_ == 0)
+        shard_capacity_ = 1;
+    for (std::size_t i = 0; i < shard_count_; ++i)
+        shards_[i].entries.reserve(shard_capacity_);
+}
+
+token_cache::shard &token_cache::shard_for(const std::string &token)
+{
+    // Mix the high bits in so shard selection does not reuse exactly the
+    // low bits the bucket index is taken from.
+    std::size_t h = std::hash<std::string>{}(token);
+    return shards_[(h ^ (h >> 17)) % shard_count_];
+}
+
+bool token_cache::lookup(const std::string &token, std::string &username, clock::time_point &expires)
+{
+    shard &s = shard_for(token);
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.entries.find(token);
+        if (it != s.entries.end())
+        {
+            if (it->second.expires > clock::now())
+            {
+                username = it->second.username;
+                expires = it->second.expires;
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            s.entries.erase(it);
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void token_cache::insert(const std::string &token, const std::string &username, clock::time_point expires,
+                         std::uint64_t generation)
+{
+    auto const now = clock::now();
+    if (expires <= now)
+        return;
+
+    shard &s = shard_for(token);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    // clear() bumps the generation before taking any shard lock, so either
+    // this sees the bump or clear() erases the entry afterwards.
+    if (generation != generation_.load(std::memory_order_acquire) || s.entries.count(token))
+        return;
+    if (s.entries.size() >= shard_capacity_)
+        make_room_locked(s, now);
+    s.entries.emplace(token, entry{username, expires});
+}
+
+// Drop expired entries; if the shard is still full, drop an arbitrary one.
+// Both are rare: a full shard means more live sessions than capacity.
+void token_cache::make_room_locked(shard &s, clock::time_point now)
+{
+    std::uint64_t dropped = 0;
+    for (auto it = s.entries.begin(); it != s.entries.end();)
+    {
+        if (it->second.expires <= now)
+        {
+            it = s.entries.erase(it);
+            ++dropped;
+        }
+        else
+            ++it;
+    }
+    if (s.entries.size() >= shard_capacity_)
+    {
+        s.entries.erase(s.entries.begin());
+        ++dropped;
+    }
+    evictions_.fetch_add(dropped, std::memory_order_relaxed);
+}
+
+void token_cache::clear()
+{
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+    for (std::size_t i = 0; i < shard_count_; ++i)
+    {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        shards_[i].entries.clear();
+    }
+}
+
+token_cache::stats token_cache::snapshot() const
+{
+    stats st;
+    st.capacity = shard_capacity_ * shard_count_;
+    for (std::size_t i = 0; i < shard_count_; ++i)
+    {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        st.size += shards_[i].entries.size();
+    }
+    st.hits = hits_.load(std::memory_order_relaxed);
+    st.misses = misses_.load(std::memory_order_relaxed);
+    st.evictions = evictions_.load(std::memory_order_relaxed);
+    return st;
+}
@@ -0,0 +1,85 @@
+// File: token_cache.hpp
+// Bounded, sharded cache of JWTs that have already been verified, mapping
+// the token to its username and expiry. A hit skips base64/JSON decoding
+// and the HMAC check entirely. Entries are keyed by the full token text
+// (its hash only selects the shard and bucket), so a hash collision can
+// never authenticate a different token.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class token_cache
+{
+public:
+    using clock = std::chrono::system_clock;
+
+    struct stats
+    {
+        std::size_t size = 0;
+        std::size_t capacity = 0;
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t evictions = 0;
+    };
+
+    explicit token_cache(std::size_t capacity, std::size_t shard_count = 16);
+
+    // Return true and set username and expires if the token is cached and
+    // not expired. Expired entries are removed on lookup.
+    bool lookup(const std::string &token, std::string &username, clock::time_point &expires);
+    bool lookup(const std::string &token, std::string &username)
+    {
+        clock::time_point expires;
+        return lookup(token, username, expires);
+    }
+
+    // Read before verifying a token and pass to insert, so a verification
+    // that raced with clear() is not cached.
+    std::uint64_t generation() const { return generation_.load(std::memory_order_acquire); }
+
+    // Remember a token that passed verification, until it expires. Does
+    // nothing if the token is already cached or clear() ran since
+    // generation was read.
+    void insert(const std::string &token, const std::string &username, clock::time_point expires,
+                std::uint64_t generation);
+
+    // Forget every cached token, e.g. after a signing key is retired.
+    void clear();
+
+    stats snapshot() const;
+
+private:
+    struct entry
+    {
+        std::string username;
+        clock::time_point expires;
+    };
+
+    // Each shard sits on its own cache line(s) so threads working on
+    // different shards do not false-share the mutex.
+    struct alignas(64) shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, entry> entries;
+    };
+
+    shard &shard_for(const std::string &token);
+    void make_room_locked(shard &s, clock::time_point now);
+
+    std::unique_ptr<shard[]> shards_;
+    std::size_t shard_count_;
+    std::size_t shard_capacity_;
+
+    std::atomic<std::uint64_t> generation_{0};
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> misses_{0};
+    std::atomic<std::uint64_t> evictions_{0};
+};
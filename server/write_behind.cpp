@@ -0,0 +1,157 @@
+// File: write_behind.cpp
+// Implementation of the batched background database writer.
+
+#include "write_behind.hpp"
+
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+// Largest number of writes committed in one transaction.
+constexpr std::size_t max_batch = 512;
+
+// Failed attempts at a whole batch before its writes are tried one per
+// transaction to find the one that keeps failing.
+constexpr unsigned batch_attempts = 3;
+}
+
+write_behind::write_behind(db_pool &pool)
+    : pool_(pool), writer_([this]
+                           { run(); })
+{
+}
+
+write_behind::~write_behind()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+}
+
+void write_behind::enqueue(write w)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(w));
+    }
+    wake_.notify_one();
+}
+
+void write_behind::run()
+{
+    std::deque<write> batch;
+    unsigned failures = 0; // consecutive failed attempts at the current batch
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this, &batch]
+                       { return stopping_ || !queue_.empty() || !batch.empty(); });
+            if (queue_.empty() && batch.empty())
+                return;
+            while (!queue_.empty() && batch.size() < max_batch)
+            {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+        }
+
+        // Keep what is left of the batch and retry; the in-memory state
+        // stays authoritative meanwhile. Only failures that are not about
+        // reaching the database count towards splitting the batch.
+        bool transient = false;
+        try
+        {
+            if (failures < batch_attempts)
+            {
+                commit(batch, batch.size());
+                batch.clear();
+            }
+            else
+                apply_one_by_one(batch);
+            failures = 0;
+            continue;
+        }
+        catch (const pqxx::broken_connection &e)
+        {
+            std::cerr << "write_behind: " << e.what() << "\n";
+            transient = true;
+        }
+        catch (const db_pool_timeout &e)
+        {
+            std::cerr << "write_behind: " << e.what() << "\n";
+            transient = true;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "write_behind: " << e.what() << "\n";
+        }
+        if (!transient)
+            ++failures;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++failed_batches_;
+            if (stopping_)
+                return;
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+}
+
+// Apply the first count writes in one transaction.
+void write_behind::commit(const std::deque<write> &writes, std::size_t count)
+{
+    auto C = pool_.acquire();
+    pqxx::work W(*C);
+    for (std::size_t i = 0; i < count; ++i)
+        writes[i](W);
+    W.commit();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    written_ += count;
+}
+
+// Commit each write on its own, removing it from the batch once it has
+// been written or dead-lettered. Connection failures propagate and leave
+// the rest of the batch for the next attempt.
+void write_behind::apply_one_by_one(std::deque<write> &batch)
+{
+    while (!batch.empty())
+    {
+        try
+        {
+            commit(batch, 1);
+        }
+        catch (const pqxx::broken_connection &)
+        {
+            throw;
+        }
+        catch (const db_pool_timeout &)
+        {
+            throw;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "write_behind: dead letter, dropping a write that failed on its own: "
+                      << e.what() << "\n";
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++dead_letters_;
+        }
+        batch.pop_front();
+    }
+}
+
+write_behind::stats write_behind::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats s;
+    s.pending = queue_.size();
+    s.written = written_;
+    s.failed_batches = failed_batches_;
+    s.dead_letters = dead_letters_;
+    return s;
+}
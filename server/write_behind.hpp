@@ -0,0 +1,63 @@
+// File: write_behind.hpp
+// Background database writer shared by the in-memory subsystems (auction
+// engine, balance ledger). Callers enqueue a write and return
+// immediately; one thread applies queued writes in order, in batches of
+// up to max_batch per transaction. A failed batch is retried as a whole,
+// so writes must be idempotent (INSERT ... ON CONFLICT DO NOTHING,
+// guarded UPDATEs, DELETE by key). A batch that keeps failing for any
+// reason other than a lost connection is then applied one write per
+// transaction, and a write that fails on its own is logged and dropped
+// (dead-lettered) so one bad write cannot stall everything queued behind
+// it.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "db_pool.hpp"
+
+class write_behind
+{
+public:
+    using write = std::function<void(pqxx::work &)>;
+
+    struct stats
+    {
+        std::size_t pending = 0;
+        std::uint64_t written = 0;
+        std::uint64_t failed_batches = 0;
+        std::uint64_t dead_letters = 0; // writes dropped after failing on their own
+    };
+
+    explicit write_behind(db_pool &pool);
+    ~write_behind();
+
+    write_behind(const write_behind &) = delete;
+    write_behind &operator=(const write_behind &) = delete;
+
+    void enqueue(write w);
+
+    stats snapshot() const;
+
+private:
+    void run();
+    void commit(const std::deque<write> &writes, std::size_t count);
+    void apply_one_by_one(std::deque<write> &batch);
+
+    db_pool &pool_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<write> queue_;
+    bool stopping_ = false;
+    std::uint64_t written_ = 0;
+    std::uint64_t failed_batches_ = 0;
+    std::uint64_t dead_letters_ = 0;
+
+    std::thread writer_;
+};